@@ -3,21 +3,35 @@
 #include "ScreenIO.hpp"
 #include "VideoFrame.hpp"
 
-#include <sstream>
-
 using namespace std;
 
 namespace {
 
 auto highestRect = [](const Rectangle& l, const Rectangle& r) { return l.bottom < r.bottom; };
 auto leftMostRect = [](const Rectangle& l, const Rectangle& r) { return l.left < r.left; };
-auto filterSmall = [](const Rectangle& r) { return r.getArea() < 20; };
+const int minObstacleArea = 20; ///< Obstacles smaller than this (in pixels) are noise
 
 } // end anonymous namespace
 
-void BirdAI::iterate(StatusPacket& pack, VideoFrame& frame)
+const char* BirdAI::describe(Error e)
+{
+	switch (e) {
+		case AE_NONE: return "none";
+		case AE_NO_VELOCITY: return "no velocity yet";
+		case AE_NO_OBSTACLES: return "no obstacles";
+		case AE_FLOOR_TOO_NARROW: return "floor too narrow";
+		case AE_UNPAIRED_PIPES: return "unpaired pipes";
+		case AE_MISMATCHED_PIPES: return "mismatched pipes";
+		case AE_COUNT: break;
+	}
+	return "unknown";
+}
+
+BirdAI::Error BirdAI::iterate(StatusPacket& pack, VideoFrame& frame)
 {
-	updateState(pack, frame);
+	const Error err = updateState(pack, frame);
+	if (err != AE_NONE)
+		return err;
 
 	switch (currentState) {
 		case AS_LAUNCH:
@@ -37,13 +51,17 @@ void BirdAI::iterate(StatusPacket& pack, VideoFrame& frame)
 			break;
 	}
 
+	return AE_NONE;
 }
 
-void BirdAI::updateState(StatusPacket& pack, VideoFrame& frame)
+BirdAI::Error BirdAI::updateState(StatusPacket& pack, VideoFrame& frame)
 {
 	const int close = 5;
 	const std::array<uint8_t, 3> obstacleOverlayColor = { 0, 0, 0 };
 
+	if (!physics.hasVelocity())
+		return AE_NO_VELOCITY;
+
 	lastVelocity = currentVelocity;
 	currentVelocity = physics.getAverageVelocity();
 
@@ -57,43 +75,29 @@ void BirdAI::updateState(StatusPacket& pack, VideoFrame& frame)
 
 	bird = pack.bird;
 	const int birdY = bird.getCenter().y;
+	flapFitter.logPosition(birdY);
 	birdLowestRadius = std::max(birdLowestRadius, pack.bird.bottom - birdY);
 	birdHighestRadius = std::max(birdHighestRadius, birdY - pack.bird.top);
 	birdFarthestLeadingEdge = std::max(birdFarthestLeadingEdge, pack.bird.right);
 
 	auto& obstacles = pack.obstacles;
 
-	obstacles.erase(remove_if(begin(obstacles), end(obstacles), filterSmall), end(obstacles));
+	// Stitch together anything the detectors split up, then drop specks
+	obstacleSet.clear();
+	obstacleSet.add(obstacles);
+	obstacles = obstacleSet.merge(minObstacleArea);
+	if (obstacles.empty())
+		return AE_NO_OBSTACLES;
 
 	sort(begin(obstacles), end(obstacles), highestRect);
 
 	auto& floor = obstacles.back();
 
-	frame.rectangleAt(floor, obstacleOverlayColor);
-
-	if (std::abs(floor.left - pack.gameRect.left) > close || std::abs(floor.right - pack.gameRect.right) > close) {
-		stringstream err;
-		err << "Floor doesn't seem to span the screen. Is it really the floor?\n";
-		err << "Floor: (";
-		err << floor.left;
-		err << ",";
-		err << floor.top;
-		err << "; ";
-		err << floor.right;
-		err << ",";
-		err << floor.bottom;
-		err << ")\n";
-		err << "game rect: (";
-		err << pack.gameRect.left;
-		err << ",";
-		err << pack.gameRect.top;
-		err << "; ";
-		err << pack.gameRect.right;
-		err << ",";
-		err << pack.gameRect.bottom;
-		err << ")";
-		throw Exceptions::AIException(err.str(), __FUNCTION__);
-	}
+	if (drawOverlay)
+		frame.rectangleAt(floor, obstacleOverlayColor);
+
+	if (std::abs(floor.left - pack.gameRect.left) > close || std::abs(floor.right - pack.gameRect.right) > close)
+		return AE_FLOOR_TOO_NARROW;
 
 	floorY = floor.top;
 
@@ -104,26 +108,32 @@ void BirdAI::updateState(StatusPacket& pack, VideoFrame& frame)
 	                          [&](const Rectangle& o) { return o.right < pack.bird.left; }),
 	                end(obstacles));
 
+	gaps.clear();
 	if (obstacles.empty()) {
 		closestObstaclesLeft = closestObstaclesRight = gapTop = gapBottom = -1;
-		return;
+		return AE_NONE;
 	}
 	else if (closestObstaclesLeft == -1) {
-		pipeTimerStart = Clock::now();
+		pipeTimerStart = clock.now();
 	}
-	else if (jumpWidth == -1 && jumpDuration.count() > 0 && Clock::now() - pipeTimerStart >= jumpDuration) {
-		jumpWidth = pack.gameRect.right - closestObstaclesLeft;
-		printf("Jump width is %d pixels\n", jumpWidth);
+	else if (!jumpWidthMeasured && jumpDuration.count() > 0 && clock.now() - pipeTimerStart >= jumpDuration) {
+		const int measured = pack.gameRect.right - closestObstaclesLeft;
+		if (jumpWidth > 0 && jumpWidth != measured)
+			printf("Jump width is %d pixels (the saved calibration had %d)\n", measured, jumpWidth);
+		else
+			printf("Jump width is %d pixels\n", measured);
+		jumpWidth = measured;
+		jumpWidthMeasured = true;
 	}
 
 	if (obstacles.size() % 2 != 0)
-		throw Exceptions::AIException("Pipes should come in pairs", __FUNCTION__);
+		return AE_UNPAIRED_PIPES;
 
 	sort(begin(obstacles), end(obstacles), leftMostRect);
 
 	if (std::abs(obstacles[0].left - obstacles[1].left) > close ||
 	    std::abs(obstacles[0].right - obstacles[1].right) > close)
-		throw Exceptions::AIException("Two closest pipes don't match up", __FUNCTION__);
+		return AE_MISMATCHED_PIPES;
 
 	Rectangle* top;
 	Rectangle* bottom;
@@ -137,20 +147,64 @@ void BirdAI::updateState(StatusPacket& pack, VideoFrame& frame)
 		top = &obstacles[1];
 	}
 
-	frame.rectangleAt(*top, obstacleOverlayColor);
-	frame.rectangleAt(*bottom, obstacleOverlayColor);
+	if (drawOverlay) {
+		frame.rectangleAt(*top, obstacleOverlayColor);
+		frame.rectangleAt(*bottom, obstacleOverlayColor);
+	}
 
 	gapTop = top->bottom;
 	gapBottom = bottom->top;
 	closestObstaclesLeft = std::min(top->left, bottom->left);
 	closestObstaclesRight = std::max(top->right, bottom->right);
+
+	// The planner looks past the closest pair too. Any farther ones that don't line up are left out.
+	for (size_t i = 0; i + 1 < obstacles.size(); i += 2) {
+		const Rectangle& a = obstacles[i];
+		const Rectangle& b = obstacles[i + 1];
+		if (std::abs(a.left - b.left) > close || std::abs(a.right - b.right) > close)
+			continue;
+		const Rectangle& upper = a.bottom < b.top ? a : b;
+		const Rectangle& lower = a.bottom < b.top ? b : a;
+		gaps.push_back({ std::min(a.left, b.left), std::max(a.right, b.right), upper.bottom, lower.top });
+	}
+	return AE_NONE;
+}
+
+void BirdAI::setCalibration(const Calibration& c)
+{
+	jumpHeight = c.jumpHeight;
+	jumpDuration = FloatingSeconds(c.jumpDuration);
+	jumpWidth = c.jumpWidth;
+	birdLowestRadius = c.birdLowestRadius;
+	birdHighestRadius = c.birdHighestRadius;
+	birdFarthestLeadingEdge = c.birdFarthestLeadingEdge;
+	calibrated = true;
+	checkingCalibration = true;
+}
+
+bool BirdAI::getCalibration(Calibration& c) const
+{
+	if (!calibrated)
+		return false;
+
+	c.jumpHeight = jumpHeight;
+	c.jumpDuration = jumpDuration.count();
+	c.jumpWidth = jumpWidth;
+	c.birdLowestRadius = birdLowestRadius;
+	c.birdHighestRadius = birdHighestRadius;
+	c.birdFarthestLeadingEdge = birdFarthestLeadingEdge;
+	return true;
 }
 
 void BirdAI::launch()
 {
-	currentState = AS_FALLING;
+	// With a saved calibration there's nothing to test, so go straight to the run
+	currentState = calibrated ? AS_GAUNTLET : AS_FALLING;
 	fireRockets();
-	printf("AI: Launch sequence initiated\n");
+	if (calibrated)
+		printf("AI: Launch sequence initiated, using a saved jump height of %d. Beginning run\n", jumpHeight);
+	else
+		printf("AI: Launch sequence initiated\n");
 }
 
 void BirdAI::fall()
@@ -167,31 +221,120 @@ void BirdAI::howHigh()
 	if (currentVelocity >= 0 && birdY >= cruisingAltitude) {
 		printf("AI: Starting jump %d\n", (int)jumpHeights.size() + 1);
 		jumpHeight = birdY;
-		jumpTimerStart = Clock::now();
+		jumpTimerStart = clock.now();
 		fireRockets();
 	}
 	else if (currentVelocity >= 0 && lastVelocity < 0) {
 		jumpHeights.emplace_back(jumpHeight - birdY);
-		jumpDurations.emplace_back(Clock::now() - jumpTimerStart);
+		jumpDurations.emplace_back(clock.now() - jumpTimerStart);
 		printf("AI: Jump test %d: %d pixels\n", (int)jumpHeights.size(), jumpHeights.back());
-		if (jumpHeights.size() == 5) {
-			jumpHeight = 0;
-			jumpDuration = FloatingSeconds::zero();
-			// Throw out the first
-			for (size_t i = 1; i < jumpHeights.size(); ++i) {
-				jumpHeight += jumpHeights[i];
-				jumpDuration += jumpDurations[i];
-			}
-			jumpHeight /= (jumpHeights.size() - 1);
-			jumpDuration /= (jumpHeights.size() - 1);
+		if (jumpHeights.size() == jumpTestCount) {
+			averageJumps(jumpHeight, jumpDuration);
+			calibrated = true;
 			printf("AI: Averaged jump height is %d. Beginning run\n", jumpHeight);
 			currentState = AS_GAUNTLET;
 		}
 	}
 }
 
+void BirdAI::averageJumps(int& height, FloatingSeconds& duration) const
+{
+	height = 0;
+	duration = FloatingSeconds::zero();
+	// Throw out the first
+	for (size_t i = 1; i < jumpHeights.size(); ++i) {
+		height += jumpHeights[i];
+		duration += jumpDurations[i];
+	}
+	height /= (int)(jumpHeights.size() - 1);
+	duration /= (float)(jumpHeights.size() - 1);
+}
+
+void BirdAI::checkCalibration()
+{
+	// Like the jump tests, each jump is timed from the click until the bird stops rising
+	if (!timingJump || currentVelocity < 0 || lastVelocity >= 0)
+		return;
+
+	timingJump = false;
+	jumpHeights.emplace_back(jumpStartY - bird.getCenter().y);
+	jumpDurations.emplace_back(clock.now() - jumpTimerStart);
+	if (jumpHeights.size() < jumpTestCount)
+		return;
+
+	checkingCalibration = false;
+	int height;
+	FloatingSeconds duration;
+	averageJumps(height, duration);
+
+	// Jumps in the run don't all start from a standstill like the tests, so allow for some difference
+	const float tolerance = 0.15f;
+	if (std::abs(height - jumpHeight) > tolerance * (float)jumpHeight ||
+	    std::abs(duration.count() - jumpDuration.count()) > tolerance * jumpDuration.count()) {
+		printf("AI: Saved calibration is off (jump height %d, measured %d). Using the measured values\n",
+		       jumpHeight, height);
+		jumpHeight = height;
+		jumpDuration = duration;
+	}
+	else {
+		printf("AI: Saved calibration checks out\n");
+	}
+}
+
+bool BirdAI::planFlap(bool& fire)
+{
+	// The planner needs to know how far the pipes move during a jump, which takes a pipe going by to measure,
+	// and how the bird moves, which takes a couple of jumps to fit
+	FlapFitter::Fit fit;
+	if (!planning || jumpWidth <= 0 || jumpDuration.count() <= 0 || !flapFitter.getFit(fit))
+		return false;
+
+	// Going by when the averaged velocity changes sign, the jump tests run long and come up short, which is
+	// fine for the heuristic but throws the planner way off. So the bird's motion comes from the fitted jumps.
+	// jumpWidth was measured over jumpDuration, so the pipes' speed still comes out right.
+	FlapPlanner::Model model;
+	model.gravity = fit.gravity;
+	model.flapVelocity = fit.flapVelocity;
+	model.scrollSpeed = (float)jumpWidth / jumpDuration.count();
+	model.clickDelay = fit.clickDelay;
+
+	FlapPlanner::Bird state;
+	state.y = (float)bird.getCenter().y;
+	state.velocity = currentVelocity;
+	state.left = bird.left;
+	state.right = bird.right;
+	state.above = birdHighestRadius;
+	state.below = birdLowestRadius;
+
+	const FlapPlanner::Plan plan = planner.plan(model, state, gaps, floorY, cruisingAltitude);
+	if (plan.outcome != lastPlanOutcome) {
+		if (plan.outcome == FlapPlanner::PO_TIMED_OUT)
+			printf("AI: Planner ran out of time after %zu states, using the heuristic\n", plan.states);
+		else if (plan.outcome == FlapPlanner::PO_DOOMED)
+			printf("AI: Planner sees no way through, using the heuristic\n");
+		else
+			printf("AI: Planner is back\n");
+		lastPlanOutcome = plan.outcome;
+	}
+	if (plan.outcome != FlapPlanner::PO_PLANNED)
+		return false;
+
+	fire = plan.clickIn >= 0 && plan.clickIn < planner.getStepSeconds() / 2;
+	return true;
+}
+
 void BirdAI::gauntlet()
 {
+	if (checkingCalibration)
+		checkCalibration();
+
+	bool fire;
+	if (planFlap(fire)) {
+		if (fire)
+			fireRockets();
+		return;
+	}
+
 	// Compensate for the delay in actually sending the click
 	const int fireDelayCompensation = 40;
 
@@ -243,7 +386,17 @@ void BirdAI::waitForLiftoff()
 
 void BirdAI::fireRockets()
 {
-	io->click();
+	if (checkingCalibration && currentState == AS_GAUNTLET && !timingJump) {
+		timingJump = true;
+		jumpStartY = bird.getCenter().y;
+		jumpTimerStart = clock.now();
+	}
+
+	const auto requested = clock.now();
+	flapFitter.clicked();
+	const auto sent = io->click();
+	if (clickTracker != nullptr)
+		clickTracker->onFrame(sent - requested);
 	returnToState = currentState;
 	currentState = AS_WAIT_FOR_LIFTOFF;
 	printf("[Upwardness Intensifies]\n");
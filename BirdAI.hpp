@@ -2,57 +2,102 @@
 #define __BIRD_AI_HPP__
 
 #include <chrono>
+#include <utility>
 #include <vector>
 
+#include "FlapFitter.hpp"
+#include "FlapPlanner.hpp"
+#include "FPSTracker.hpp"
+#include "FrameArena.hpp"
 #include "PhysicsAnalysis.hpp"
-#include "Exceptions.hpp"
 #include "Rectangle.hpp"
+#include "RectangleSet.hpp"
+#include "TimeSource.hpp"
 
 class PhysicsAnalysis;
 class ScreenIO;
 class VideoFrame;
 
-namespace Exceptions {
-
-class AIException : public Exception
-{
-public:
-	AIException(const std::string& exceptionMessage,
-	            const std::string& callingFunctionName)
-		: Exception(exceptionMessage, callingFunctionName, "AI")
-	{ }
-
-	virtual ~AIException() noexcept { }
-};
-
-}
-
-
 class BirdAI {
 
 public:
 
 	struct StatusPacket {
-		StatusPacket(const Rectangle& gr, const Rectangle& b, const std::vector<Rectangle>& obs) :
-			gameRect(gr), bird(b), obstacles(obs)
+		StatusPacket(const Rectangle& gr, const Rectangle& b, RectangleList obs) :
+			gameRect(gr), bird(b), obstacles(std::move(obs))
 		{ }
 
 		Rectangle gameRect;
 		Rectangle bird;
-		std::vector<Rectangle> obstacles;
+		RectangleList obstacles; ///< Often in the arena of the frame they were found in
 	};
 
-	BirdAI(PhysicsAnalysis& phys, ScreenIO* sio) :
-		currentState(AS_LAUNCH), physics(phys), io(sio)
-	{ }
+	/// Why iterate couldn't make sense of a frame, in which case it does nothing else with it
+	enum Error {
+		AE_NONE,
+		AE_NO_VELOCITY, ///< Too few positions have been logged to know how fast the bird is going
+		AE_NO_OBSTACLES, ///< Not even the floor
+		AE_FLOOR_TOO_NARROW, ///< The lowest obstacle doesn't span the game, so it probably isn't the floor
+		AE_UNPAIRED_PIPES, ///< An odd number of pipes, so one of a pair is missing
+		AE_MISMATCHED_PIPES, ///< The two closest pipes aren't one above the other
+		AE_COUNT
+	};
 
-	void iterate(StatusPacket& pack, VideoFrame& frame);
+	/// A short description of the error, for messages
+	static const char* describe(Error e);
+
+	/// What the jump tests and watching the bird measure, which only depend on the size of the game
+	struct Calibration {
+		int jumpHeight; ///< How high one flap takes the bird, in pixels
+		float jumpDuration; ///< How long it takes to get there, in seconds
+		int jumpWidth; ///< How far the pipes move meanwhile, in pixels, or -1 if not yet measured
+		int birdLowestRadius;
+		int birdHighestRadius;
+		int birdFarthestLeadingEdge;
+	};
+
+	/**
+	 * \param phys Where the bird's velocity comes from
+	 * \param sio Where clicks go
+	 * \param clk What jumps and pipes are timed with, which should be the same clock phys uses
+	 */
+	BirdAI(PhysicsAnalysis& phys, ScreenIO* sio, const TimeSource& clk = TimeSource::steady()) :
+		currentState(AS_LAUNCH), physics(phys), io(sio), clock(clk), flapFitter(clk)
+	{
+		jumpHeights.reserve(jumpTestCount);
+		jumpDurations.reserve(jumpTestCount);
+		gaps.reserve(8);
+	}
+
+	/// Looks at the latest frame and decides whether to click
+	Error iterate(StatusPacket& pack, VideoFrame& frame);
+
+	/**
+	 * \brief Starts from a calibration saved by an earlier run, skipping the jump tests
+	 *
+	 * Call before the first iterate. The first few jumps of the run are still timed, and if they don't agree
+	 * with the saved values, the measured ones take over.
+	 */
+	void setCalibration(const Calibration& c);
+
+	/// Gets the calibration to save for next time, returning false if the jump tests haven't finished yet
+	bool getCalibration(Calibration& c) const;
+
+	/// Times each click from when the AI decides to fire to when the click is handed to the display server
+	void setClickTracker(FPSTracker* tracker) { clickTracker = tracker; }
+
+	/// Turns drawing the obstacles it's looking at onto each frame on or off (it's on by default)
+	void setOverlay(bool draw) { drawOverlay = draw; }
+
+	/// Turns the flap planner on or off (it's on by default). Without it, gauntlet only uses its heuristic.
+	void setPlanning(bool plan) { planning = plan; }
 
 private:
 
-	typedef std::chrono::high_resolution_clock Clock;
 	typedef std::chrono::duration<float, std::chrono::seconds::period> FloatingSeconds;
 
+	static const size_t jumpTestCount = 5; ///< How many jumps to measure before starting the run
+
 	enum State {
 		AS_LAUNCH,
 		AS_FALLING, ///< Drop to our starting point (cruising altitude)
@@ -61,7 +106,7 @@ private:
 		AS_WAIT_FOR_LIFTOFF ///< Special state: waiting to go up
 	};
 
-	void updateState(StatusPacket& pack, VideoFrame& frame);
+	Error updateState(StatusPacket& pack, VideoFrame& frame);
 
 	void launch();
 
@@ -76,15 +121,39 @@ private:
 	/// Send a click and wait for liftoff
 	void fireRockets();
 
+	/// Averages the jumps timed so far, throwing out the first
+	void averageJumps(int& height, FloatingSeconds& duration) const;
+
+	/// Times jumps during the run to check a saved calibration against
+	void checkCalibration();
+
+	/// Asks the planner whether to click now, returning false if it has no plan (see gauntlet)
+	bool planFlap(bool& fire);
+
 	State currentState;
 	PhysicsAnalysis& physics;
 	ScreenIO* io;
+	const TimeSource& clock;
+	FPSTracker* clickTracker = nullptr;
+	bool drawOverlay = true;
+	RectangleSet obstacleSet; ///< Pieces the detectors found of the same obstacle get merged here
+	FlapPlanner planner;
+	FlapFitter flapFitter; ///< Measures how the bird moves, for the planner
+	bool planning = true;
+	std::vector<FlapPlanner::Gap> gaps; ///< Every pair of pipes in view
+	FlapPlanner::Outcome lastPlanOutcome = FlapPlanner::PO_PLANNED;
 
 	State returnToState;
 
-	int jumpHeight; ///< How high we can jump
-	FloatingSeconds jumpDuration; ///< How long it takes us to jump that high
+	int jumpHeight = 0; ///< How high we can jump
+	FloatingSeconds jumpDuration = FloatingSeconds::zero(); ///< How long it takes us to jump that high
 	int jumpWidth = -1; ///< The width of a the upward arc of a jump
+	bool jumpWidthMeasured = false; ///< Whether jumpWidth was measured this run, rather than loaded
+
+	bool calibrated = false; ///< Whether the jump values are known, from the jump tests or a saved calibration
+	bool checkingCalibration = false; ///< Whether jumps are being timed to check a saved calibration
+	bool timingJump = false; ///< Whether a jump being checked is on its way up
+	int jumpStartY = 0; ///< Where the jump being checked started
 
 	int cruisingAltitude; ///< Where to start for jump runs
 
@@ -108,8 +177,8 @@ private:
 	int gapTop; ///< The top of the gap through which we must pass
 	int gapBottom; ///< The bottom of the gap through which we must pass
 
-	Clock::time_point jumpTimerStart; ///< Used for determining speeds, distances, etc.
-	Clock::time_point pipeTimerStart; ///< Used for determining jumpWidth
+	TimeSource::TimePoint jumpTimerStart; ///< Used for determining speeds, distances, etc.
+	TimeSource::TimePoint pipeTimerStart; ///< Used for determining jumpWidth
 };
 
 #endif
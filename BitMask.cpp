@@ -0,0 +1,311 @@
+#include "BitMask.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+const uint64_t allSet = ~(uint64_t)0;
+
+inline int popcount(uint64_t w) { return __builtin_popcountll(w); }
+
+/// A horizontal run of set pixels in one row, and the group it belongs to
+struct Run {
+	int left, right;
+	int label;
+};
+
+/// Keeps track of which runs are connected, and the bounds of each group
+class Groups {
+
+public:
+
+	int add(int left, int right, int y)
+	{
+		parent.push_back((int)parent.size());
+		boxes.emplace_back(left, y, right, y);
+		pixels.push_back((size_t)(right - left + 1));
+		return (int)parent.size() - 1;
+	}
+
+	int find(int label)
+	{
+		while (parent[label] != label) {
+			parent[label] = parent[parent[label]];
+			label = parent[label];
+		}
+		return label;
+	}
+
+	void unite(int a, int b)
+	{
+		a = find(a);
+		b = find(b);
+		if (a == b)
+			return;
+		// Keep the older label as the root, so groups come out in the order they started
+		if (b < a)
+			swap(a, b);
+		parent[b] = a;
+		boxes[a].expandTo(boxes[b]);
+		pixels[a] += pixels[b];
+	}
+
+	vector<int> parent;
+	vector<Rectangle> boxes;
+	vector<size_t> pixels;
+};
+
+/// Appends the runs of set bits in a row to runs
+void findRuns(const uint64_t* row, size_t words, vector<Run>& runs)
+{
+	int runStart = -1;
+	for (size_t i = 0; i < words; ++i) {
+		const uint64_t w = row[i];
+		const int base = (int)i * 64;
+		int pos = 0;
+		while (pos < 64) {
+			if (runStart < 0) {
+				const uint64_t rest = w >> pos;
+				if (rest == 0)
+					break;
+				pos += __builtin_ctzll(rest);
+				runStart = base + pos;
+			}
+			const uint64_t zerosAfter = ~w >> pos;
+			if (zerosAfter == 0)
+				break; // The run carries on into the next word
+			pos += __builtin_ctzll(zerosAfter);
+			runs.push_back({ runStart, base + pos - 1, -1 });
+			runStart = -1;
+		}
+	}
+	// Only when the width is a multiple of 64 and the row ends in a set pixel
+	if (runStart >= 0)
+		runs.push_back({ runStart, (int)words * 64 - 1, -1 });
+}
+
+} // end anonymous namespace
+
+void BitMask::resize(size_t w, size_t h)
+{
+	width = w;
+	height = h;
+	wordsPerRow = (w + 63) / 64;
+	tailMask = (w % 64 == 0) ? allSet : (((uint64_t)1 << (w % 64)) - 1);
+	bits.assign(wordsPerRow * h, 0);
+}
+
+void BitMask::erode(int radius)
+{
+	for (int i = 0; i < radius; ++i)
+		step(true);
+}
+
+void BitMask::dilate(int radius)
+{
+	for (int i = 0; i < radius; ++i)
+		step(false);
+}
+
+void BitMask::step(bool eroding)
+{
+	if (width == 0 || height == 0)
+		return;
+
+	// Past the edges is set when eroding and clear when dilating, so the edges themselves never change anything
+	const uint64_t outside = eroding ? allSet : 0;
+	scratch.resize(bits.size());
+
+	// Across: each pixel with its left and right neighbors, shifted in from the neighboring words as needed
+	for (size_t y = 0; y < height; ++y) {
+		const uint64_t* row = getRow(y);
+		uint64_t* out = &scratch[y * wordsPerRow];
+
+		auto word = [&](size_t i) {
+			if (i >= wordsPerRow)
+				return outside;
+			return i == wordsPerRow - 1 ? (row[i] | (outside & ~tailMask)) : row[i];
+		};
+
+		uint64_t previous = outside;
+		uint64_t current = word(0);
+		for (size_t i = 0; i < wordsPerRow; ++i) {
+			const uint64_t next = word(i + 1);
+			const uint64_t left = (current << 1) | (previous >> 63);
+			const uint64_t right = (current >> 1) | (next << 63);
+			out[i] = eroding ? (current & left & right) : (current | left | right);
+			previous = current;
+			current = next;
+		}
+	}
+
+	// Down: each row with the rows above and below it
+	for (size_t y = 0; y < height; ++y) {
+		const uint64_t* above = y > 0 ? &scratch[(y - 1) * wordsPerRow] : nullptr;
+		const uint64_t* middle = &scratch[y * wordsPerRow];
+		const uint64_t* below = y + 1 < height ? &scratch[(y + 1) * wordsPerRow] : nullptr;
+		uint64_t* out = getRow(y);
+
+		for (size_t i = 0; i < wordsPerRow; ++i) {
+			const uint64_t a = above != nullptr ? above[i] : outside;
+			const uint64_t b = below != nullptr ? below[i] : outside;
+			out[i] = eroding ? (middle[i] & a & b) : (middle[i] | a | b);
+		}
+	}
+
+	clearTails();
+}
+
+void BitMask::clearTails()
+{
+	if (tailMask == allSet)
+		return;
+	for (size_t y = 0; y < height; ++y)
+		getRow(y)[wordsPerRow - 1] &= tailMask;
+}
+
+size_t BitMask::count() const
+{
+	size_t ret = 0;
+	for (uint64_t w : bits)
+		ret += (size_t)popcount(w);
+	return ret;
+}
+
+void BitMask::rowCounts(std::vector<int>& counts) const
+{
+	counts.resize(height);
+	for (size_t y = 0; y < height; ++y) {
+		const uint64_t* row = getRow(y);
+		int n = 0;
+		for (size_t i = 0; i < wordsPerRow; ++i)
+			n += popcount(row[i]);
+		counts[y] = n;
+	}
+}
+
+void BitMask::columnCounts(std::vector<int>& counts, int top, int bottom) const
+{
+	counts.assign(width, 0);
+	top = max(top, 0);
+	bottom = min(bottom, (int)height - 1);
+	if (top > bottom)
+		return;
+
+	// Bit-sliced counters: plane p holds bit p of the count for each of a word's 64 columns.
+	// Adding a row ripples its bits up through the planes like a carry, usually stopping after one or two.
+	int planeCount = 1;
+	while ((1 << planeCount) <= bottom - top + 1)
+		++planeCount;
+	vector<uint64_t> planes(wordsPerRow * (size_t)planeCount, 0);
+
+	for (int y = top; y <= bottom; ++y) {
+		const uint64_t* row = getRow((size_t)y);
+		for (size_t i = 0; i < wordsPerRow; ++i) {
+			uint64_t* plane = &planes[i * (size_t)planeCount];
+			uint64_t carry = row[i];
+			for (int p = 0; carry != 0; ++p) {
+				const uint64_t overflow = plane[p] & carry;
+				plane[p] ^= carry;
+				carry = overflow;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < wordsPerRow; ++i) {
+		const uint64_t* plane = &planes[i * (size_t)planeCount];
+		const size_t columns = min<size_t>(64, width - i * 64);
+		for (size_t b = 0; b < columns; ++b) {
+			int n = 0;
+			for (int p = 0; p < planeCount; ++p)
+				n |= (int)((plane[p] >> b) & 1) << p;
+			counts[i * 64 + b] = n;
+		}
+	}
+}
+
+void BitMask::components(std::vector<Rectangle>& boxes, size_t minPixels) const
+{
+	boxes.clear();
+
+	Groups groups;
+	vector<Run> previous;
+	vector<Run> current;
+
+	for (size_t y = 0; y < height; ++y) {
+		current.clear();
+		findRuns(getRow(y), wordsPerRow, current);
+
+		// Runs are in order along both rows, so walk them together.
+		// Runs touch (8-connected) if they overlap once one is widened by a pixel on each side.
+		size_t first = 0;
+		for (Run& run : current) {
+			run.label = groups.add(run.left, run.right, (int)y);
+			while (first < previous.size() && previous[first].right < run.left - 1)
+				++first;
+			for (size_t j = first; j < previous.size() && previous[j].left <= run.right + 1; ++j)
+				groups.unite(run.label, previous[j].label);
+		}
+		swap(previous, current);
+	}
+
+	for (size_t label = 0; label < groups.parent.size(); ++label) {
+		if (groups.parent[label] == (int)label && groups.pixels[label] >= minPixels)
+			boxes.push_back(groups.boxes[label]);
+	}
+}
+
+Rectangle BitMask::boundsWithin(const Rectangle& r) const
+{
+	Rectangle area = r;
+	area.constrainBy(Rectangle(0, 0, (int)width - 1, (int)height - 1));
+
+	Rectangle ret(area.right + 1, area.bottom + 1, area.left - 1, area.top - 1);
+	if (area.left > area.right || area.top > area.bottom)
+		return Rectangle(0, 0, -1, -1);
+
+	const size_t firstWord = (size_t)area.left / 64;
+	const size_t lastWord = (size_t)area.right / 64;
+	const uint64_t firstMask = allSet << (area.left % 64);
+	const uint64_t lastMask = allSet >> (63 - area.right % 64);
+
+	for (int y = area.top; y <= area.bottom; ++y) {
+		const uint64_t* row = getRow((size_t)y);
+		for (size_t i = firstWord; i <= lastWord; ++i) {
+			uint64_t w = row[i];
+			if (i == firstWord)
+				w &= firstMask;
+			if (i == lastWord)
+				w &= lastMask;
+			if (w == 0)
+				continue;
+
+			const int x = (int)i * 64 + __builtin_ctzll(w);
+			ret.left = min(ret.left, x);
+			ret.top = min(ret.top, y);
+			ret.bottom = y;
+			break;
+		}
+		if (ret.bottom != y)
+			continue;
+
+		// There's something in this row, so find its last pixel from the other end
+		for (size_t i = lastWord + 1; i-- > firstWord; ) {
+			uint64_t w = row[i];
+			if (i == firstWord)
+				w &= firstMask;
+			if (i == lastWord)
+				w &= lastMask;
+			if (w != 0) {
+				ret.right = max(ret.right, (int)i * 64 + 63 - __builtin_clzll(w));
+				break;
+			}
+		}
+	}
+
+	if (ret.left > ret.right)
+		return Rectangle(0, 0, -1, -1);
+	return ret;
+}
@@ -0,0 +1,129 @@
+#ifndef __BIT_MASK_HPP__
+#define __BIT_MASK_HPP__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Rectangle.hpp"
+#include "VideoFrame.hpp"
+
+/**
+ * \brief A one bit per pixel frame, marking which pixels belong to some class (pipe, beak, etc.)
+ *
+ * Pixel x of a row is bit x % 64 of word x / 64, and each row starts on a new word, so one word covers
+ * 64 pixels that took 192 bytes as RGB. Morphology works on whole words with shifts, ANDs and ORs,
+ * and projections count pixels with popcounts (and bit-sliced adders, for columns),
+ * so cleaning up and measuring a class costs a small fraction of a pass over the frame it came from.
+ * Bits past the width of each row are always zero.
+ */
+class BitMask {
+
+public:
+
+	BitMask() = default;
+
+	BitMask(size_t w, size_t h) { resize(w, h); }
+
+	/// Changes the size of the mask and clears it, reusing its memory where possible
+	void resize(size_t w, size_t h);
+
+	/**
+	 * \brief Sets each bit according to whether a pixel of a frame belongs to the class
+	 * \param frame The frame to classify, which the mask takes the size of
+	 * \param isMember A classifier taking a pixel, like FlappyColors::isPipeColor
+	 */
+	template <typename Classifier>
+	void classify(const VideoFrame& frame, Classifier isMember)
+	{
+		resize(frame.getWidth(), frame.getHeight());
+		const size_t step = frame.getBytesPerPixel();
+
+		for (size_t y = 0; y < height; ++y) {
+			const uint8_t* pix = frame.getPixel(0, y);
+			uint64_t* row = getRow(y);
+			for (size_t x = 0; x < width; x += 64) {
+				const size_t n = width - x < 64 ? width - x : 64;
+				uint64_t word = 0;
+				for (size_t b = 0; b < n; ++b, pix += step)
+					word |= (uint64_t)isMember(pix) << b;
+				row[x / 64] = word;
+			}
+		}
+	}
+
+	bool get(size_t x, size_t y) const { return (getRow(y)[x / 64] >> (x % 64)) & 1; }
+
+	void set(size_t x, size_t y) { getRow(y)[x / 64] |= (uint64_t)1 << (x % 64); }
+
+	void clear() { std::fill(bits.begin(), bits.end(), 0); }
+
+	uint64_t* getRow(size_t y) { return &bits[y * wordsPerRow]; }
+
+	const uint64_t* getRow(size_t y) const { return &bits[y * wordsPerRow]; }
+
+	size_t getWidth() const { return width; }
+
+	size_t getHeight() const { return height; }
+
+	size_t getWordsPerRow() const { return wordsPerRow; }
+
+	/**
+	 * \brief Clears every pixel that isn't surrounded by set pixels, (2 * radius + 1) pixels square
+	 *
+	 * Pixels past the edges count as set, so shapes touching an edge aren't eaten away from it.
+	 */
+	void erode(int radius = 1);
+
+	/**
+	 * \brief Sets every pixel within a (2 * radius + 1) pixel square of a set pixel
+	 *
+	 * Pixels past the edges count as clear.
+	 */
+	void dilate(int radius = 1);
+
+	/// Erodes then dilates, removing specks and slivers narrower than the square without shrinking anything else
+	void open(int radius = 1) { erode(radius); dilate(radius); }
+
+	/// Dilates then erodes, filling holes and gaps narrower than the square without growing anything else
+	void close(int radius = 1) { dilate(radius); erode(radius); }
+
+	/// The number of set pixels in the whole mask
+	size_t count() const;
+
+	/// Writes the number of set pixels in each row to counts (resizing it to the height)
+	void rowCounts(std::vector<int>& counts) const;
+
+	/// Writes the number of set pixels in each column, over rows [top, bottom], to counts (resizing it to the width)
+	void columnCounts(std::vector<int>& counts, int top, int bottom) const;
+
+	void columnCounts(std::vector<int>& counts) const { columnCounts(counts, 0, (int)height - 1); }
+
+	/**
+	 * \brief Finds the bounding box of each 8-connected group of set pixels
+	 * \param boxes Cleared, then given one box per group, in order of each group's first row
+	 * \param minPixels Groups with fewer pixels than this are left out
+	 */
+	void components(std::vector<Rectangle>& boxes, size_t minPixels = 1) const;
+
+	/// Returns the bounding box of the set pixels within r, or a box with right < left if there are none
+	Rectangle boundsWithin(const Rectangle& r) const;
+
+private:
+
+	/// Clears the bits past the width in the last word of each row
+	void clearTails();
+
+	/// Does a 3x3 erode (if eroding) or dilate (if not) in place
+	void step(bool eroding);
+
+	size_t width = 0;
+	size_t height = 0;
+	size_t wordsPerRow = 0;
+	uint64_t tailMask = ~(uint64_t)0; ///< The bits of the last word of each row that are within the width
+	std::vector<uint64_t> bits;
+	std::vector<uint64_t> scratch; ///< Rows being worked on by morphology
+};
+
+#endif
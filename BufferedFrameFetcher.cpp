@@ -1,10 +1,11 @@
 #include "BufferedFrameFetcher.hpp"
 
 #include "ScreenIO.hpp"
+#include "Trace.hpp"
 
 using namespace std;
 
-BufferedFrameFetcher::BufferedFrameFetcher(ScreenIO* sio) : io(sio)
+BufferedFrameFetcher::BufferedFrameFetcher(ScreenIO* sio, CaptureMode mode) : io(sio), captureMode(mode)
 
 {
 	threadRunning = true;
@@ -28,17 +29,46 @@ std::shared_ptr<VideoFrame> BufferedFrameFetcher::getFrame()
 
 void BufferedFrameFetcher::workerProc()
 {
+	Trace::setThreadName("capture");
+	uint64_t frameID = 0;
+	uint64_t lastHash = 0;
+
 	while (threadRunning) {
 
+		// Capture anyway once the timeout passes, so that a missed damage event can't stall us
+		// and so that the consumer keeps getting (duplicate-tagged) frames to check its own exit flag on.
+		if (captureMode == CM_ON_DAMAGE)
+			io->waitForChange(chrono::milliseconds(100));
+
+		Trace::FrameScope traceFrame(++frameID);
+		Trace::Span captureSpan("capture");
+
+		const auto captureStart = tracker.now();
 		auto newFrame = io->getFrame();
+		newFrame->setFrameID(frameID);
+
+		uint64_t hash;
+		{
+			Trace::Span span("contentHash");
+			hash = newFrame->contentHash();
+		}
+		const bool duplicate = frameID > 1 && hash == lastHash;
+		newFrame->setDuplicate(duplicate);
+		lastHash = hash;
 
 		// Only lock on the assignment so we don't hold the lock while we actually get the frame
 		{
 			lock_guard<mutex> ml(frameLock);
-			frame = newFrame;
-			frameReady = true;
-			frameCV.notify_one();
+			// If the consumer hasn't picked up the previous frame yet, leave it in place.
+			// It has the same pixels, and isn't tagged as a duplicate of something the consumer never saw.
+			if (!(duplicate && frameReady)) {
+				frame = newFrame;
+				frameReady = true;
+				frameCV.notify_one();
+			}
 		}
-		tracker.onFrame();
+		tracker.onFrame(captureStart);
+		if (duplicate)
+			duplicateTracker.onFrame();
 	}
 }
@@ -18,14 +18,28 @@ class BufferedFrameFetcher final {
 
 public:
 
-	BufferedFrameFetcher(ScreenIO* sio);
+	/// How the capture thread decides when to grab a frame
+	enum CaptureMode {
+		CM_CONTINUOUS, ///< Capture back to back, as fast as possible
+		CM_ON_DAMAGE ///< Wait for ScreenIO::waitForChange first (which may not actually wait, depending on the ScreenIO)
+	};
+
+	/**
+	 * In either mode, each frame is hashed and tagged as a duplicate (see VideoFrame::isDuplicate)
+	 * if it matches the previous capture.
+	 */
+	BufferedFrameFetcher(ScreenIO* sio, CaptureMode mode = CM_ON_DAMAGE);
 
 	~BufferedFrameFetcher();
 
 	std::shared_ptr<VideoFrame> getFrame();
 
+	/// Tracks the capture rate and how long each capture takes
 	FPSTracker& getFPSTracker() { return tracker; }
 
+	/// Counts captures that were identical to the one before them
+	FPSTracker& getDuplicateTracker() { return duplicateTracker; }
+
 	BufferedFrameFetcher(const BufferedFrameFetcher&) = delete;
 	BufferedFrameFetcher& operator=(const BufferedFrameFetcher&) = delete;
 
@@ -45,7 +59,9 @@ private:
 	std::atomic<bool> threadRunning; ///< Set to true when the video updating thread should exit
 
 	ScreenIO* io;
+	const CaptureMode captureMode;
 	FPSTracker tracker;
+	FPSTracker duplicateTracker;
 };
 
 #endif
@@ -0,0 +1,126 @@
+#include "ConfigFile.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace {
+
+string trim(const string& s)
+{
+	const size_t first = s.find_first_not_of(" \t\r");
+	if (first == string::npos)
+		return string();
+	const size_t last = s.find_last_not_of(" \t\r");
+	return s.substr(first, last - first + 1);
+}
+
+string configDirectory()
+{
+	const char* xdg = getenv("XDG_CONFIG_HOME");
+	if (xdg != nullptr && *xdg != '\0')
+		return string(xdg) + "/flapper";
+
+	const char* home = getenv("HOME");
+	return string(home != nullptr ? home : ".") + "/.config/flapper";
+}
+
+/// Like mkdir -p, for the few levels we might need
+bool makeDirectories(const string& dir)
+{
+	for (size_t slash = dir.find('/', 1); ; slash = dir.find('/', slash + 1)) {
+		const string part = dir.substr(0, slash);
+		if (mkdir(part.c_str(), 0755) != 0 && errno != EEXIST)
+			return false;
+		if (slash == string::npos)
+			return true;
+	}
+}
+
+} // end anonymous namespace
+
+ConfigFile::ConfigFile(const std::string& fileName) :
+	directory(configDirectory()),
+	path(directory + "/" + fileName)
+{ }
+
+bool ConfigFile::load()
+{
+	ifstream in(path);
+	if (!in)
+		return false;
+
+	values.clear();
+	string line;
+	while (getline(in, line)) {
+		const size_t equals = line.find('=');
+		if (equals == string::npos || trim(line).compare(0, 1, "#") == 0)
+			continue;
+		values[trim(line.substr(0, equals))] = trim(line.substr(equals + 1));
+	}
+	return true;
+}
+
+bool ConfigFile::save() const
+{
+	if (!makeDirectories(directory))
+		return false;
+
+	// Write to the side and rename, so a crash mid-write can't leave a half-written file behind
+	const string temporary = path + ".tmp";
+	{
+		ofstream out(temporary);
+		if (!out)
+			return false;
+
+		for (const auto& kv : values)
+			out << kv.first << " = " << kv.second << '\n';
+
+		// Some write errors (e.g. a full disk) only show up when what's buffered is flushed on close
+		out.close();
+		if (!out) {
+			remove(temporary.c_str());
+			return false;
+		}
+	}
+	return rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+int ConfigFile::getInt(const std::string& key, int fallback) const
+{
+	auto it = values.find(key);
+	if (it == values.end())
+		return fallback;
+
+	char* end;
+	const long ret = strtol(it->second.c_str(), &end, 10);
+	return (end == it->second.c_str() || *end != '\0') ? fallback : (int)ret;
+}
+
+double ConfigFile::getDouble(const std::string& key, double fallback) const
+{
+	auto it = values.find(key);
+	if (it == values.end())
+		return fallback;
+
+	char* end;
+	const double ret = strtod(it->second.c_str(), &end);
+	return (end == it->second.c_str() || *end != '\0') ? fallback : ret;
+}
+
+void ConfigFile::set(const std::string& key, int value)
+{
+	values[key] = to_string(value);
+}
+
+void ConfigFile::set(const std::string& key, double value)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%.17g", value);
+	values[key] = buf;
+}
@@ -0,0 +1,57 @@
+#ifndef __CONFIG_FILE_HPP__
+#define __CONFIG_FILE_HPP__
+
+#include <map>
+#include <string>
+
+/**
+ * \brief A flat file of "key = value" lines that lives in the user's config directory
+ *
+ * Files go in $XDG_CONFIG_HOME/flapper, or ~/.config/flapper if that isn't set.
+ * Meant for things worth remembering between runs, like where the game window was.
+ * Nothing in here is essential, so failures are reported with return values rather than exceptions.
+ */
+class ConfigFile {
+
+public:
+
+	/// \param fileName The name of the file within the config directory
+	explicit ConfigFile(const std::string& fileName);
+
+	/**
+	 * \brief Reads the file, replacing any values already set
+	 * \returns false if the file doesn't exist or can't be read
+	 */
+	bool load();
+
+	/**
+	 * \brief Writes every value to the file, creating the config directory if needed
+	 * \returns false if the file couldn't be written
+	 */
+	bool save() const;
+
+	bool has(const std::string& key) const { return values.find(key) != values.end(); }
+
+	/// Returns the value of a key, or fallback if it is missing or not a number
+	int getInt(const std::string& key, int fallback) const;
+
+	/// Returns the value of a key, or fallback if it is missing or not a number
+	double getDouble(const std::string& key, double fallback) const;
+
+	void set(const std::string& key, int value);
+
+	void set(const std::string& key, double value);
+
+	/// Removes every value (but doesn't touch the file until the next save)
+	void clear() { values.clear(); }
+
+	const std::string& getPath() const { return path; }
+
+private:
+
+	std::string directory;
+	std::string path;
+	std::map<std::string, std::string> values;
+};
+
+#endif
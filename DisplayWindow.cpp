@@ -4,27 +4,93 @@
 #include <QVBoxLayout>
 #include <QPushButton>
 
+#include <cstdlib>
+#include <ctime>
 #include <mutex>
 #include <cstdio> // TEMP
+#include <string>
 
 #include "QGLCanvas.hpp"
-#include "X11ScreenIO.hpp"
+#include "ScreenIOBackends.hpp"
 #include "FlappySearches.hpp"
+#include "TileClassifier.hpp"
+#include "FrameArena.hpp"
 #include "BufferedFrameFetcher.hpp"
+#include "ConfigFile.hpp"
 #include "FPSTracker.hpp"
 #include "PeriodicRunner.hpp"
+#include "StatsReporter.hpp"
+#include "Trace.hpp"
 #include "PhysicsAnalysis.hpp"
+#include "QualityController.hpp"
 #include "BirdAI.hpp"
+#include "FrameRecording.hpp"
 
 using namespace std;
 
+namespace {
+
+/// Where the game window was last found, and on what size of screen
+const char* const gameWindowCacheName = "gamewindow";
+
+/// What the AI measured about the game, for each size of game window it has played at
+const char* const calibrationCacheName = "calibration";
+
+/// Calibrations are kept per game size, as "<width>x<height>.<name>"
+string calibrationKey(const Rectangle& gameRect, const char* name)
+{
+	return to_string(gameRect.getWidth()) + "x" + to_string(gameRect.getHeight()) + "." + name;
+}
+
+bool loadCalibration(const Rectangle& gameRect, BirdAI::Calibration& c)
+{
+	ConfigFile cache(calibrationCacheName);
+	if (!cache.load())
+		return false;
+
+	c.jumpHeight = cache.getInt(calibrationKey(gameRect, "jumpHeight"), -1);
+	c.jumpDuration = (float)cache.getDouble(calibrationKey(gameRect, "jumpDuration"), -1.0);
+	c.jumpWidth = cache.getInt(calibrationKey(gameRect, "jumpWidth"), -1);
+	c.birdLowestRadius = cache.getInt(calibrationKey(gameRect, "birdLowestRadius"), 0);
+	c.birdHighestRadius = cache.getInt(calibrationKey(gameRect, "birdHighestRadius"), 0);
+	c.birdFarthestLeadingEdge = cache.getInt(calibrationKey(gameRect, "birdFarthestLeadingEdge"), 0);
+	return c.jumpHeight > 0 && c.jumpDuration > 0;
+}
+
+void saveCalibration(const Rectangle& gameRect, const BirdAI::Calibration& c)
+{
+	ConfigFile cache(calibrationCacheName);
+	cache.load(); // Keep what's there for other sizes
+	cache.set(calibrationKey(gameRect, "jumpHeight"), c.jumpHeight);
+	cache.set(calibrationKey(gameRect, "jumpDuration"), (double)c.jumpDuration);
+	cache.set(calibrationKey(gameRect, "jumpWidth"), c.jumpWidth);
+	cache.set(calibrationKey(gameRect, "birdLowestRadius"), c.birdLowestRadius);
+	cache.set(calibrationKey(gameRect, "birdHighestRadius"), c.birdHighestRadius);
+	cache.set(calibrationKey(gameRect, "birdFarthestLeadingEdge"), c.birdFarthestLeadingEdge);
+	if (!cache.save())
+		fprintf(stderr, "Could not save the AI's calibration to %s\n", cache.getPath().c_str());
+}
+
+/// How old a frame can be by the time we've acted on it, unless FLAPPER_LATENCY_BUDGET_MS says otherwise
+const double defaultLatencyBudgetMs = 40.0;
+
+QualityController::Clock::duration latencyBudget()
+{
+	const char* env = getenv("FLAPPER_LATENCY_BUDGET_MS");
+	const double ms = env != nullptr ? atof(env) : 0.0;
+	return chrono::duration_cast<QualityController::Clock::duration>(
+		chrono::duration<double, milli>(ms > 0.0 ? ms : defaultLatencyBudgetMs));
+}
+
+} // end anonymous namespace
+
 DisplayWindow::DisplayWindow(QWidget *parent) :
 	QMainWindow(parent),
 	ui(new Ui::DisplayWindow),
 	canvas(new QGLCanvas),
 	btnStart(new QPushButton("Start")),
 	threadRunning(false),
-	screenIO(new X11ScreenIO)
+	screenIO(createScreenIO(getDefaultScreenIOBackend()))
 {
 	ui->setupUi(this);
 
@@ -36,6 +102,9 @@ DisplayWindow::DisplayWindow(QWidget *parent) :
 
 	connect(btnStart, &QPushButton::clicked, this, &DisplayWindow::startClicked);
 
+	// SIGUSR2 toggles tracing, SIGUSR1 dumps it
+	Trace::installSignalHandlers();
+
 	canvas->setFrame(unique_ptr<QImage>(new QImage("StartImage.jpg")));
 }
 
@@ -48,29 +117,94 @@ DisplayWindow::~DisplayWindow()
 	delete ui;
 }
 
+bool DisplayWindow::findCachedGameWindow(const Rectangle& screenBounds, Rectangle& gameRect)
+{
+	ConfigFile cache(gameWindowCacheName);
+	if (!cache.load())
+		return false;
+
+	if (cache.getInt("screenWidth", -1) != screenBounds.getWidth() ||
+	    cache.getInt("screenHeight", -1) != screenBounds.getHeight())
+		return false;
+
+	const Rectangle cached(cache.getInt("left", -1), cache.getInt("top", -1),
+	                       cache.getInt("right", -1), cache.getInt("bottom", -1));
+
+	// Grab the cached rectangle with a pixel to spare on each side, so we can tell if the window has moved
+	Rectangle probe = cached;
+	probe.expandBy(1);
+	probe.constrainBy(screenBounds);
+	if (probe.left >= probe.right || probe.top >= probe.bottom)
+		return false;
+
+	shared_ptr<VideoFrame> frame;
+	try {
+		screenIO->focusOn(probe);
+		frame = screenIO->getFrame();
+	}
+	catch (const Exceptions::Exception&) {
+		return false;
+	}
+
+	const Rectangle inProbe(cached.left - probe.left, cached.top - probe.top,
+	                        cached.right - probe.left, cached.bottom - probe.top);
+	if (!isGameWindowAt(*frame, inProbe))
+		return false;
+
+	gameRect = cached;
+	return true;
+}
+
+void DisplayWindow::saveGameWindow(const Rectangle& screenBounds, const Rectangle& gameRect)
+{
+	ConfigFile cache(gameWindowCacheName);
+	cache.set("screenWidth", screenBounds.getWidth());
+	cache.set("screenHeight", screenBounds.getHeight());
+	cache.set("left", gameRect.left);
+	cache.set("top", gameRect.top);
+	cache.set("right", gameRect.right);
+	cache.set("bottom", gameRect.bottom);
+	if (!cache.save())
+		fprintf(stderr, "Could not save the game window's location to %s\n", cache.getPath().c_str());
+}
+
 void DisplayWindow::play()
 {
 	namespace sc = std::chrono;
 
-	// First let's find the window. It's going to have a bunch of blue up top and some tan down below
-	screenIO->resetFocus();
-	auto fullscreenFrame = screenIO->getFrame();
+	Trace::setThreadName("play");
 
+	const auto startupStart = FPSTracker::Clock::now();
+
+	// First let's find the window. Try where it was last time, if the screen hasn't changed since.
+	const Rectangle screenBounds = screenIO->getScreenBounds();
 	Rectangle gameRect;
-	try {
-		gameRect = findGameWindow(*fullscreenFrame);
-	}
-	catch(const Exceptions::Exception& e) {
-		fprintf(stderr, "Could not find game window with error:\n");
-		fprintf(stderr, "%s\nin function %s\n", e.message.c_str(), e.callingFunction.c_str());
-		fflush(stderr);
-		canvas->setFrame(fullscreenFrame);
-		this_thread::sleep_for(sc::seconds(5));
-		canvas->setFrame(unique_ptr<QImage>(new QImage("ErrorImage.jpg")));
-		return;
+	const bool fromCache = findCachedGameWindow(screenBounds, gameRect);
+
+	if (!fromCache) {
+		// Otherwise search the whole screen. It's going to have a bunch of blue up top and some tan down below
+		screenIO->resetFocus();
+		auto fullscreenFrame = screenIO->getFrame();
+
+		SearchResult<Rectangle> found = findGameWindowCoarse(*fullscreenFrame);
+		// The coarse grid can miss a very small game window, so look at every pixel before giving up
+		if (!found.found())
+			found = findGameWindow(*fullscreenFrame);
+		if (!found.found()) {
+			fprintf(stderr, "Could not find game window: %s\n", describe(found.error));
+			fflush(stderr);
+			canvas->setFrame(fullscreenFrame);
+			this_thread::sleep_for(sc::seconds(5));
+			canvas->setFrame(unique_ptr<QImage>(new QImage("ErrorImage.jpg")));
+			return;
+		}
+		gameRect = found.value;
+
+		saveGameWindow(screenBounds, gameRect);
 	}
 
-	printf("Game window found! left: %d, top: %d, right: %d, bottom: %d\n",
+	printf("Game window %s! left: %d, top: %d, right: %d, bottom: %d\n",
+	       fromCache ? "found where it was last time" : "found",
 	       gameRect.left, gameRect.top, gameRect.right, gameRect.bottom);
 	fflush(stdout);
 
@@ -86,41 +220,208 @@ void DisplayWindow::play()
 
 	FPSTracker processingTracker;
 	FPSTracker failureTracker;
+	// Failures again, by why. Detection and the AI report them with codes, since a bad stretch fails every frame.
+	FPSTracker searchFailures[SE_COUNT];
+	FPSTracker aiFailures[BirdAI::AE_COUNT];
+	FPSTracker unexpectedFailures; // Exceptions out of detection or the AI, which are bugs
+	FPSTracker duplicateTracker; // Frames skipped because they matched the last one we processed
+	uint64_t duplicatesSkipped = 0;
+	FPSTracker staleTracker; // Frames dropped by the quality controller for being too old
+	// Per-stage timing. Capture is timed by the fetcher.
+	FPSTracker detectTracker;
+	FPSTracker aiTracker;
+	FPSTracker displayTracker;
+	FPSTracker clickTracker;
+	bool processedAny = false;
+
+	StatsReporter reporter;
+	reporter.add("Recording FPS: ", fetcher.getFPSTracker());
+	reporter.add("Processing FPS: ", processingTracker);
+	reporter.add("Failures/second: ", failureTracker);
+	for (int e = SE_NONE + 1; e < SE_COUNT; ++e)
+		reporter.add(string("  ") + describe((SearchError)e) + ": ", searchFailures[e], true);
+	for (int e = BirdAI::AE_NONE + 1; e < BirdAI::AE_COUNT; ++e)
+		reporter.add(string("  AI, ") + BirdAI::describe((BirdAI::Error)e) + ": ", aiFailures[e], true);
+	reporter.add("  Unexpected errors: ", unexpectedFailures, true);
+	reporter.add("Duplicates skipped/second: ", duplicateTracker);
+	reporter.add("Stale frames dropped/second: ", staleTracker);
+	reporter.add("  Detect: ", detectTracker);
+	reporter.add("  AI: ", aiTracker);
+	reporter.add("  Display: ", displayTracker);
+	reporter.add("  Click: ", clickTracker);
+	reporter.start();
 
 	PhysicsAnalysis physics(10);
 	PeriodicRunner<std::chrono::milliseconds> physicsPrinter(50);
 
 	BirdAI ai(physics, screenIO.get());
+	ai.setClickTracker(&clickTracker);
+
+	// If we've played at this size before, skip the jump tests. FLAPPER_RECALIBRATE=1 runs them anyway.
+	BirdAI::Calibration calibration;
+	const char* recalibrate = getenv("FLAPPER_RECALIBRATE");
+	if ((recalibrate == nullptr || atoi(recalibrate) == 0) && loadCalibration(gameRect, calibration)) {
+		ai.setCalibration(calibration);
+		printf("Using the saved calibration for a %dx%d game\n", gameRect.getWidth(), gameRect.getHeight());
+	}
+
+	// Only the parts of each frame that changed since the last one get rescanned
+	TileClassifier tiles;
+
+	// Holds the detectors' temporaries for the frame being processed, so they don't go through the heap
+	FrameArena arena;
+
+	// FLAPPER_RECORD=<file> saves every new frame, as captured, for going over offline (see flapperbatch)
+	unique_ptr<FrameRecorder> recorder;
+	const char* recordPath = getenv("FLAPPER_RECORD");
+	if (recordPath != nullptr && *recordPath != '\0') {
+		try {
+			recorder.reset(new FrameRecorder(recordPath, gameRect.getWidth(), gameRect.getHeight()));
+			printf("Recording frames to %s\n", recordPath);
+		}
+		catch (const Exceptions::IOException& e) {
+			fprintf(stderr, "Not recording: %s\n", e.message.c_str());
+		}
+	}
+
+	// Sheds work when we fall behind, so we act on fresh frames rather than on time
+	QualityController quality(latencyBudget());
+	Rectangle lastBird;
+	bool haveLastBird = false;
 
 	screenIO->mouseTo(gameRect.getCenter());
 	for (int i = 0; i < 10; ++i) screenIO->click();
 
 	// While we're not told to exit and there are more frames to display
 	while (threadRunning) {
-		auto currentFrame = fetcher.getFrame();
+		if (Trace::takeDumpRequest()) {
+			const string tracePath = "flapper-trace-" + to_string(time(nullptr)) + ".json";
+			if (Trace::dump(tracePath))
+				printf("Wrote trace to %s\n", tracePath.c_str());
+			else
+				fprintf(stderr, "Could not write trace to %s\n", tracePath.c_str());
+		}
+
+		shared_ptr<VideoFrame> currentFrame;
+		{
+			Trace::Span span("wait for frame");
+			currentFrame = fetcher.getFrame();
+		}
+		Trace::FrameScope traceFrame(currentFrame->getFrameID());
+
+		// Nothing moved, so there's nothing to detect, and logging the same position again
+		// would drag the physics velocities towards zero.
+		if (currentFrame->isDuplicate()) {
+			duplicateTracker.onFrame();
+			++duplicatesSkipped;
+			continue;
+		}
+
+		// Before the AI draws on it
+		if (recorder)
+			recorder->record(*currentFrame);
+
+		if (!quality.admit(*currentFrame)) {
+			staleTracker.onFrame();
+			continue;
+		}
+
+		const auto processingStart = processingTracker.now();
+		const bool preview = quality.showPreview();
+		arena.reset();
+		ai.setOverlay(preview);
+
+		auto show = [&] {
+			const auto displayStart = displayTracker.now();
+			canvas->setFrame(currentFrame);
+			displayTracker.onFrame(displayStart);
+		};
+
+		// Counts a frame that detection or the AI couldn't make sense of, and still shows it.
+		// It was still worked on, so the quality controller hears about its age too,
+		// or a stretch of slow failures would never shed any work.
+		auto failed = [&](FPSTracker& why) {
+			failureTracker.onFrame();
+			why.onFrame();
+			quality.finished(*currentFrame);
+			if (preview)
+				show();
+		};
 
 		try {
-			if (gameOver(*currentFrame)) {
+			bool over;
+			{
+				Trace::Span span("gameOver");
+				over = gameOver(*currentFrame);
+			}
+			if (over) {
 				printf("Game over!");
 				fflush(stdout);
 				break;
 			}
 
-			Point beakLocation = findBeakLocation(*currentFrame);
-			Rectangle bird = findBird(*currentFrame, beakLocation);
+			SearchResult<Point> beakLocation = SE_NO_BEAK;
+			if (quality.useROIDetection() && haveLastBird) {
+				// The bird only moves up and down, so look in a band around where it last was.
+				// The tiles fall behind meanwhile, and catch up on the changes once we go back to them.
+				Trace::Span span("findBeakLocation/ROI");
+				Rectangle band = lastBird;
+				band.expandBy(lastBird.getHeight() * 3);
+				beakLocation = findBeakLocation(*currentFrame, band, &arena);
+				if (!beakLocation.found())
+					beakLocation = findBeakLocation(*currentFrame, &arena);
+			}
+			else {
+				// Updating the tiles is most of what finding the beak costs this way, so it counts towards the span
+				Trace::Span span("findBeakLocation");
+				tiles.update(*currentFrame);
+				beakLocation = findBeakLocation(tiles, &arena);
+			}
+			if (!beakLocation.found()) {
+				failed(searchFailures[beakLocation.error]);
+				continue;
+			}
+			Rectangle bird;
+			{
+				Trace::Span span("findBird");
+				bird = findBird(*currentFrame, beakLocation.value);
+			}
 			bird.expandBy(5); // Give ourselves some padding
-			auto pipes = findPipes(*currentFrame);
+			lastBird = bird;
+			haveLastBird = true;
+			SearchResult<RectangleList> pipes = SE_NO_FLOOR;
+			{
+				Trace::Span span("findPipesByColumns");
+				pipes = findPipesByColumns(*currentFrame, &arena);
+			}
+			if (!pipes.found()) {
+				failed(searchFailures[pipes.error]);
+				continue;
+			}
+			detectTracker.onFrame(processingStart);
 
 			physics.logPosition(bird.getCenter().y);
 
-			BirdAI::StatusPacket statusPack(gameRect, bird, pipes);
+			BirdAI::StatusPacket statusPack(gameRect, bird, std::move(pipes.value));
 
-			std::array<uint8_t, 3> crosshairColor = { 170, 40, 252 };
-			std::array<uint8_t, 3> birdOverlayColor = { 170, 40, 252 };
-			currentFrame->rectangleAt(bird, birdOverlayColor);
-			currentFrame->crosshairsAt(beakLocation, crosshairColor, 30);
+			if (preview) {
+				std::array<uint8_t, 3> crosshairColor = { 170, 40, 252 };
+				std::array<uint8_t, 3> birdOverlayColor = { 170, 40, 252 };
+				currentFrame->rectangleAt(bird, birdOverlayColor);
+				currentFrame->crosshairsAt(beakLocation.value, crosshairColor, 30);
+			}
 
-			ai.iterate(statusPack, *currentFrame);
+			const auto aiStart = aiTracker.now();
+			BirdAI::Error aiError;
+			{
+				Trace::Span span("BirdAI::iterate");
+				aiError = ai.iterate(statusPack, *currentFrame);
+			}
+			if (aiError != BirdAI::AE_NONE) {
+				failed(aiFailures[aiError]);
+				continue;
+			}
+			aiTracker.onFrame(aiStart);
 
 			/*
 			if (physics.hasAcceleration()) {
@@ -134,32 +435,45 @@ void DisplayWindow::play()
 			}
 			*/
 
-			processingTracker.onFrame();
+			processingTracker.onFrame(processingStart);
+			quality.finished(*currentFrame);
+
+			if (!processedAny) {
+				processedAny = true;
+				printf("Time to first processed frame: %.1f ms\n",
+				       sc::duration<double, milli>(FPSTracker::Clock::now() - startupStart).count());
+				fflush(stdout);
+			}
 		}
 		catch(const Exceptions::IOException& e) {
 			fprintf(stderr, "IO problem!\n%s in %s\n", e.message.c_str(), e.callingFunction.c_str());
-			return;
+			// Still save the calibration and print the summary
+			break;
 		}
 		catch(const Exceptions::Exception& e) {
-			failureTracker.onFrame();
-			/*
-			static int num = 1;
-			QImage errorImg(currentFrame->getPixels(),
-							currentFrame->getWidth(),
-							currentFrame->getHeight(),
-							QImage::Format_RGB888);
-			QString fn = "wat";
-			fn += QString::number(num++);
-			fn += ".png";
-			errorImg.save(fn);
-			*/
+			// Detection and the AI report failures without throwing, so this is a bug.
+			// One bad frame shouldn't end the game though.
+			fprintf(stderr, "Unexpected error!\n%s in %s\n", e.message.c_str(), e.callingFunction.c_str());
+			failed(unexpectedFailures);
+			continue;
 		}
 
-		canvas->setFrame(currentFrame);
-		fetcher.getFPSTracker().printPeriodically("Recording FPS: ");
-		processingTracker.printPeriodically("Processing FPS: ");
-		failureTracker.printPeriodically("Failures/second: ");
+		if (preview)
+			show();
 	}
+
+	if (ai.getCalibration(calibration))
+		saveCalibration(gameRect, calibration);
+
+	printf("Skipped %llu duplicate frames\n", (unsigned long long)duplicatesSkipped);
+	printf("Dropped %llu stale frames\n", (unsigned long long)quality.getDroppedCount());
+	if (recorder) {
+		recorder->finish();
+		printf("Recorded %llu frames to %s (%llu dropped%s)\n", (unsigned long long)recorder->getRecordedCount(),
+		       recordPath, (unsigned long long)recorder->getDroppedCount(),
+		       recorder->hasFailed() ? ", and a write failed" : "");
+	}
+	fflush(stdout);
 }
 
 void DisplayWindow::startClicked()
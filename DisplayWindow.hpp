@@ -37,6 +37,12 @@ private:
 
 	void play(); ///< The procedure that runs inside the video update thread
 
+	/// Checks whether the game window is still where we last found it, and if so, puts that in gameRect
+	bool findCachedGameWindow(const Rectangle& screenBounds, Rectangle& gameRect);
+
+	/// Remembers where we found the game window for next time
+	void saveGameWindow(const Rectangle& screenBounds, const Rectangle& gameRect);
+
 private slots:
 
 	void startClicked();
@@ -1,49 +1,108 @@
 #ifndef __FPS_TRACKER_HPP__
 #define __FPS_TRACKER_HPP__
 
+#include <atomic>
 #include <chrono>
-#include <mutex>
-#include <queue>
+#include <cstdint>
 
-#include "PeriodicRunner.hpp"
+#include "LatencyHistogram.hpp"
+#include "TimeSource.hpp"
 
-/// A crude perforamnce measure
+/**
+ * \brief Counts events (frames, failures, etc.) and how long each took
+ *
+ * Meant to be written by one thread (the one doing the work) and sampled by another (see StatsReporter),
+ * so neither side ever takes a lock.
+ */
 class FPSTracker {
 
 public:
 
-	FPSTracker() : runner(1) { }
+	typedef std::chrono::steady_clock Clock;
 
+	/// Rate and latency since the previous sample
+	struct Sample {
+		float perSecond; ///< Events per second
+		uint64_t count; ///< Events since the last sample
+		uint64_t latencyCount; ///< How many of those events had a latency recorded
+		// Latency percentiles, in nanoseconds
+		uint64_t p50;
+		uint64_t p90;
+		uint64_t p99;
+		uint64_t max;
+	};
+
+	/// \param clk What rates and onFrame(Clock::time_point) latencies are measured with
+	explicit FPSTracker(const TimeSource& clk = TimeSource::steady()) :
+		clock(clk), count(0), lastSampleCount(0), lastSampleTime(clk.now())
+	{
+		lastLatencies = latencies.snapshot();
+	}
+
+	/// The time on this tracker's clock, e.g. for when something to be timed with onFrame starts
+	Clock::time_point now() const { return clock.now(); }
+
+	/// Counts an event. Call from the thread doing the work.
 	void onFrame()
 	{
-		std::lock_guard<std::mutex> lg(queueMutex);
-		framesInLastSecond.push(Clock::now());
+		count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_release);
 	}
 
-	int getFPS()
+	/// Counts an event which took the given amount of time. Call from the thread doing the work.
+	void onFrame(Clock::duration took)
 	{
-		auto then = Clock::now() - std::chrono::seconds(1);
-		std::lock_guard<std::mutex> lg(queueMutex);
-		while (!framesInLastSecond.empty() && framesInLastSecond.front() < then)
-			framesInLastSecond.pop();
-		return (int)framesInLastSecond.size();
+		latencies.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(took).count());
+		onFrame();
 	}
 
-	void printPeriodically(const char* message)
+	/// Counts an event which started at the given time and just finished
+	void onFrame(Clock::time_point started) { onFrame(clock.now() - started); }
+
+	/**
+	 * \brief Gets the rate and latency distribution since the last call
+	 *
+	 * Safe to call from a thread other than the one calling onFrame, but only one thread should sample
+	 * a given tracker.
+	 */
+	Sample sample()
 	{
-		runner.runPeriodically([message, this]() {
-			printf("%s%d\n", message, getFPS());
-			fflush(stdout);
-		});
+		const auto now = clock.now();
+		const uint64_t c = count.load(std::memory_order_acquire);
+		const LatencyHistogram::Snapshot lat = latencies.snapshot();
+		const LatencyHistogram::Snapshot interval = lat.since(lastLatencies);
+
+		const float seconds = std::chrono::duration<float>(now - lastSampleTime).count();
+
+		Sample ret;
+		ret.count = c - lastSampleCount;
+		ret.perSecond = seconds > 0.0f ? (float)ret.count / seconds : 0.0f;
+		ret.latencyCount = interval.total;
+		ret.p50 = interval.valueAtQuantile(0.5);
+		ret.p90 = interval.valueAtQuantile(0.9);
+		ret.p99 = interval.valueAtQuantile(0.99);
+		ret.max = interval.max();
+
+		lastSampleTime = now;
+		lastSampleCount = c;
+		lastLatencies = lat;
+		return ret;
 	}
 
+	FPSTracker(const FPSTracker&) = delete;
+	FPSTracker& operator=(const FPSTracker&) = delete;
+
 private:
 
-	typedef std::chrono::high_resolution_clock Clock;
+	const TimeSource& clock;
+
+	// Written by the working thread
+	std::atomic<uint64_t> count;
+	LatencyHistogram latencies;
 
-	std::queue<Clock::time_point> framesInLastSecond;
-	std::mutex queueMutex;
-	PeriodicRunner<> runner;
+	// Owned by the sampling thread
+	uint64_t lastSampleCount;
+	Clock::time_point lastSampleTime;
+	LatencyHistogram::Snapshot lastLatencies;
 };
 
 #endif
@@ -0,0 +1,184 @@
+#include "FlapFitter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+namespace {
+
+const size_t sampleCapacity = 256; ///< Positions kept, which is a few seconds' worth at any frame rate we'll see
+const size_t maxBefore = 8; ///< Positions before the click used for the fall leading up to the flap
+const size_t minAfter = 5; ///< Positions after the flap needed to fit the jump
+const double maxDelay = 0.25; ///< The longest a click could take to flap the bird, in seconds
+const double maxRMSError = 2.0; ///< Fits further off than this (in pixels, on average) are thrown out
+
+/// Solves a x = b for an n by n system by Gaussian elimination, returning false if it's singular
+template <size_t n>
+bool solve(double (&a)[n][n], double (&b)[n], double (&x)[n])
+{
+	for (size_t col = 0; col < n; ++col) {
+		size_t pivot = col;
+		for (size_t row = col + 1; row < n; ++row) {
+			if (fabs(a[row][col]) > fabs(a[pivot][col]))
+				pivot = row;
+		}
+		if (fabs(a[pivot][col]) < 1e-12)
+			return false;
+		if (pivot != col) {
+			for (size_t k = 0; k < n; ++k)
+				swap(a[col][k], a[pivot][k]);
+			swap(b[col], b[pivot]);
+		}
+		for (size_t row = col + 1; row < n; ++row) {
+			const double f = a[row][col] / a[col][col];
+			for (size_t k = col; k < n; ++k)
+				a[row][k] -= f * a[col][k];
+			b[row] -= f * b[col];
+		}
+	}
+	for (size_t col = n; col-- > 0;) {
+		double sum = b[col];
+		for (size_t k = col + 1; k < n; ++k)
+			sum -= a[col][k] * x[k];
+		x[col] = sum / a[col][col];
+	}
+	return true;
+}
+
+} // end anonymous namespace
+
+FlapFitter::FlapFitter(const TimeSource& clock)
+	: clock(clock),
+	  origin(clock.now()),
+	  samples(sampleCapacity)
+{ }
+
+void FlapFitter::reset()
+{
+	count = 0;
+	pending = false;
+	falling = false;
+	fits = 0;
+	gravitySum = flapVelocitySum = clickDelaySum = 0;
+}
+
+double FlapFitter::secondsOf(TimeSource::TimePoint t) const
+{
+	return chrono::duration<double>(t - origin).count();
+}
+
+void FlapFitter::logPosition(int pos)
+{
+	if (count == samples.size()) {
+		// Fit the pending jump before the positions leading up to its click start being dropped
+		if (pending && sampleAt(maxBefore).t > clickTime)
+			fitPending();
+		first = (first + 1) % samples.size();
+		--count;
+	}
+	samples[(first + count) % samples.size()] = { secondsOf(clock.now()), (float)pos };
+	++count;
+}
+
+void FlapFitter::clicked()
+{
+	if (pending)
+		fitPending();
+	pending = true;
+	clickTime = secondsOf(clock.now());
+}
+
+bool FlapFitter::getFit(Fit& f) const
+{
+	if (fits < minFits)
+		return false;
+
+	f.gravity = (float)(gravitySum / (double)fits);
+	f.flapVelocity = (float)(flapVelocitySum / (double)fits);
+	f.clickDelay = (float)(clickDelaySum / (double)fits);
+	return true;
+}
+
+void FlapFitter::fitPending()
+{
+	pending = false;
+
+	// Whatever comes of this, the bird is surely past the flap a while after the click
+	const double click = clickTime;
+	const bool wasFalling = falling;
+	const double fallingFrom = fallingSince;
+	falling = true;
+	fallingSince = click + maxDelay;
+
+	// The fall before the flap only counts from when the bird was last known to be past a flap
+	if (!wasFalling)
+		return;
+
+	size_t afterClick = 0;
+	while (afterClick < count && sampleAt(afterClick).t <= click)
+		++afterClick;
+	size_t begin = afterClick;
+	while (begin > 0 && afterClick - begin < maxBefore && sampleAt(begin - 1).t >= fallingFrom)
+		--begin;
+	const size_t end = count;
+	if (afterClick - begin < 2)
+		return;
+
+	// Try each position after the click as the first one after the flap, and keep the one that fits best.
+	// Before the flap: y = p + q t + g t^2 / 2. After: y = a + b t + g t^2 / 2. Times are from the click.
+	double bestError = numeric_limits<double>::max();
+	Fit best = { 0, 0, 0 };
+	double bestFlapTime = 0;
+	for (size_t split = afterClick; split + minAfter <= end && sampleAt(split).t - click <= maxDelay + 0.1; ++split) {
+		double ata[5][5] = { };
+		double aty[5] = { };
+		for (size_t i = begin; i < end; ++i) {
+			const Sample& s = sampleAt(i);
+			const double t = s.t - click;
+			const bool after = i >= split;
+			const double row[5] = { t * t / 2, after ? 0.0 : 1.0, after ? 0.0 : t, after ? 1.0 : 0.0, after ? t : 0.0 };
+			for (int r = 0; r < 5; ++r) {
+				for (int c = 0; c < 5; ++c)
+					ata[r][c] += row[r] * row[c];
+				aty[r] += row[r] * s.y;
+			}
+		}
+		double x[5];
+		if (!solve(ata, aty, x))
+			continue;
+		const double g = x[0], p = x[1], q = x[2], a = x[3], b = x[4];
+
+		// The parabolas meet at the flap, which has to be between the positions either side of the split
+		if (b >= q)
+			continue;
+		const double flapTime = (p - a) / (b - q);
+		const double flapVelocity = b + g * flapTime;
+		if (g <= 0 || flapVelocity >= 0 || flapTime < 0 || flapTime > maxDelay ||
+		    flapTime < sampleAt(split - 1).t - click || flapTime > sampleAt(split).t - click)
+			continue;
+
+		double error = 0;
+		for (size_t i = begin; i < end; ++i) {
+			const Sample& s = sampleAt(i);
+			const double t = s.t - click;
+			const double fitted = i >= split ? a + b * t + g * t * t / 2 : p + q * t + g * t * t / 2;
+			error += (s.y - fitted) * (s.y - fitted);
+		}
+		if (error < bestError) {
+			bestError = error;
+			best = { (float)g, (float)flapVelocity, (float)flapTime };
+			bestFlapTime = click + flapTime;
+		}
+	}
+
+	if (sqrt(bestError / (double)(end - begin)) > maxRMSError)
+		return;
+
+	++fits;
+	gravitySum += best.gravity;
+	flapVelocitySum += best.flapVelocity;
+	clickDelaySum += best.clickDelay;
+	fallingSince = bestFlapTime;
+}
@@ -0,0 +1,93 @@
+#ifndef __FLAP_FITTER_HPP__
+#define __FLAP_FITTER_HPP__
+
+#include <cstddef>
+#include <vector>
+
+#include "TimeSource.hpp"
+
+/**
+ * \brief Measures how the bird falls and flaps, and how long a click takes to flap it, from where it's been
+ *
+ * Between flaps the bird falls with constant gravity, and a flap sets its velocity to the same upward value
+ * whatever it was. So around each click, the bird's positions lie on two parabolas with the same gravity:
+ * one before the flap and one after. Fitting both at once gives the gravity, and where they meet gives
+ * when the flap happened (so the delay from the click) and the velocity it left with.
+ *
+ * Unlike the jump tests, which time jumps by when the averaged velocity changes sign, this doesn't lag behind
+ * the bird, and works on any jump, including ones that start with the bird still rising.
+ * Positions are kept in a fixed amount of memory, so logging never allocates.
+ */
+class FlapFitter {
+
+public:
+
+	/// Distances are in pixels, down is positive, and times are in seconds
+	struct Fit {
+		float gravity; ///< Downward acceleration
+		float flapVelocity; ///< Vertical velocity right after a flap (negative, as it's upward)
+		float clickDelay; ///< How long after a click is sent the bird flaps
+	};
+
+	/// \param clock Where the time of each position and click comes from
+	explicit FlapFitter(const TimeSource& clock = TimeSource::steady());
+
+	void reset();
+
+	/// Logs where the bird is now (its center)
+	void logPosition(int pos);
+
+	/// Notes that a click was sent just now, fitting the jump of the one before it
+	void clicked();
+
+	/**
+	 * \brief Averages the jumps fitted so far
+	 * \returns false if fewer than minFits jumps have been fitted
+	 */
+	bool getFit(Fit& f) const;
+
+	/// How many jumps have been fitted
+	size_t getFitCount() const { return fits; }
+
+	/// How many jumps have to be fitted before getFit trusts them
+	static const size_t minFits = 2;
+
+	FlapFitter(const FlapFitter&) = delete;
+	FlapFitter& operator=(const FlapFitter&) = delete;
+
+private:
+
+	struct Sample {
+		double t; ///< Seconds since origin
+		float y;
+	};
+
+	/// Seconds since origin, so samples can be kept as plain numbers
+	double secondsOf(TimeSource::TimePoint t) const;
+
+	/// The i-th oldest sample
+	const Sample& sampleAt(size_t i) const { return samples[(first + i) % samples.size()]; }
+
+	/// Fits the jump of the pending click to the samples logged since, and stops waiting on it
+	void fitPending();
+
+	const TimeSource& clock;
+	TimeSource::TimePoint origin;
+
+	std::vector<Sample> samples; ///< A ring of the latest positions, oldest at first
+	size_t first = 0;
+	size_t count = 0;
+
+	bool pending = false; ///< Whether a click is waiting to be fitted
+	double clickTime = 0; ///< When the pending click was sent
+	bool falling = false; ///< Whether the bird has been in free fall since fallingSince (i.e. it's past a flap)
+	double fallingSince = 0;
+
+	// Sums over the fitted jumps, for averaging
+	size_t fits = 0;
+	double gravitySum = 0;
+	double flapVelocitySum = 0;
+	double clickDelaySum = 0;
+};
+
+#endif
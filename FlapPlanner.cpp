@@ -0,0 +1,176 @@
+#include "FlapPlanner.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Exceptions.hpp"
+
+using namespace std;
+
+namespace {
+
+const float flapCost = 0.1f; ///< Taken off a sequence's score for each flap, so it doesn't flap for nothing
+const int heightBuckets = 256; ///< How finely heights are told apart, over the height of the game
+
+} // end anonymous namespace
+
+FlapPlanner::FlapPlanner(Clock::duration budget, int horizonSteps, float stepSeconds)
+	: budget(budget),
+	  horizonSteps(horizonSteps),
+	  stepSeconds(stepSeconds)
+{
+	if (horizonSteps < 1 || stepSeconds <= 0)
+		throw Exceptions::ArgumentException("The horizon must have at least one step, of some length", __FUNCTION__);
+
+	// However tall the game, heights fall into at most heightBuckets + 1 buckets, so this is all the room plan() needs
+	const size_t slots = (size_t)horizonSteps * (size_t)(horizonSteps + 1) * (size_t)(heightBuckets + 1);
+	stamps.assign(slots, 0);
+	scores.resize(slots);
+	flaps.resize(slots);
+}
+
+FlapPlanner::Plan FlapPlanner::plan(const Model& m, const Bird& b, const std::vector<Gap>& g, int floor, int cruise)
+{
+	model = m;
+	bird = b;
+	gaps = &g;
+	floorY = floor;
+	cruiseY = cruise;
+
+	// Whatever we decide, the bird falls until a click sent now would land
+	startVelocity = bird.velocity + model.gravity * model.clickDelay;
+	startY = bird.y + bird.velocity * model.clickDelay + 0.5f * model.gravity * model.clickDelay * model.clickDelay;
+
+	bucketSize = max(1, floorY / heightBuckets + 1);
+	bucketCount = max(1, floorY / bucketSize + 1);
+	if (++currentStamp == 0) {
+		fill(stamps.begin(), stamps.end(), 0);
+		currentStamp = 1;
+	}
+
+	statesScored = 0;
+	timedOut = false;
+	deadline = Clock::now() + budget;
+
+	Plan ret;
+	const float best = score(0, horizonSteps, startY);
+	ret.states = statesScored;
+	ret.clickIn = -1;
+	if (timedOut) {
+		ret.outcome = PO_TIMED_OUT;
+		return ret;
+	}
+	// Any sequence that survives scores at least this, and any that doesn't scores less (see score)
+	ret.outcome = best >= -flapCost * (float)horizonSteps ? PO_PLANNED : PO_DOOMED;
+
+	// Follow the best choices from here until the first flap
+	int sinceFlap = horizonSteps;
+	float y = startY;
+	for (int step = 0; step < horizonSteps; ++step) {
+		const size_t slot = slotOf(step, sinceFlap, y);
+		if (stamps[slot] != currentStamp)
+			break;
+		if (flaps[slot]) {
+			ret.clickIn = (float)step * stepSeconds;
+			break;
+		}
+		y += (velocityAt(step, sinceFlap) + model.gravity * stepSeconds) * stepSeconds;
+		sinceFlap = sinceFlap == horizonSteps ? horizonSteps : sinceFlap + 1;
+	}
+	return ret;
+}
+
+float FlapPlanner::score(int step, int sinceFlap, float y)
+{
+	if (step == horizonSteps)
+		return 0;
+
+	const size_t slot = slotOf(step, sinceFlap, y);
+	if (stamps[slot] == currentStamp)
+		return scores[slot];
+
+	// Checking the clock costs more than scoring a state, so only do it now and then
+	if ((++statesScored & 63) == 0 && Clock::now() > deadline)
+		timedOut = true;
+	if (timedOut)
+		return 0;
+
+	// Dying costs more per step cut off than any step can earn, so living longer always wins,
+	// and more than any surviving sequence can lose, so plan() can tell them apart
+	const float deathPenalty = (1 + flapCost) * (float)horizonSteps + 1;
+
+	// Where we'd like the bird to be: in the middle of the next gap it hasn't passed yet
+	auto reward = [&](int at, float height) {
+		const float shift = model.scrollSpeed * ((float)at * stepSeconds + model.clickDelay);
+		float target = (float)cruiseY;
+		float nearest = numeric_limits<float>::max();
+		for (const Gap& gap : *gaps) {
+			const float right = (float)gap.right - shift;
+			if (right >= (float)bird.left && right < nearest) {
+				nearest = right;
+				target = (float)(gap.top + gap.bottom) / 2;
+			}
+		}
+		return 1 - fabs(height - target) / (float)max(floorY, 1);
+	};
+
+	float best = -numeric_limits<float>::max();
+	bool bestFlap = false;
+	// Not flapping goes first, so it wins ties
+	for (bool flap : { false, true }) {
+		const float velocity = flap ? model.flapVelocity : velocityAt(step, sinceFlap) + model.gravity * stepSeconds;
+		const float nextY = y + velocity * stepSeconds;
+
+		float value;
+		if (collides(step + 1, nextY)) {
+			value = -deathPenalty * (float)(horizonSteps - step);
+		}
+		else {
+			const int nextSince = flap ? 0 : (sinceFlap == horizonSteps ? horizonSteps : sinceFlap + 1);
+			value = reward(step + 1, nextY) - (flap ? flapCost : 0) + score(step + 1, nextSince, nextY);
+		}
+		if (value > best) {
+			best = value;
+			bestFlap = flap;
+		}
+	}
+
+	if (timedOut)
+		return 0;
+
+	stamps[slot] = currentStamp;
+	scores[slot] = best;
+	flaps[slot] = bestFlap ? 1 : 0;
+	return best;
+}
+
+size_t FlapPlanner::slotOf(int step, int sinceFlap, float y) const
+{
+	const int bucket = min(max((int)y / bucketSize, 0), bucketCount - 1);
+	return ((size_t)step * (size_t)(horizonSteps + 1) + (size_t)sinceFlap) * (size_t)bucketCount + (size_t)bucket;
+}
+
+float FlapPlanner::velocityAt(int step, int sinceFlap) const
+{
+	if (sinceFlap == horizonSteps)
+		return startVelocity + model.gravity * (float)step * stepSeconds;
+	return model.flapVelocity + model.gravity * (float)sinceFlap * stepSeconds;
+}
+
+bool FlapPlanner::collides(int step, float y) const
+{
+	const float top = y - (float)bird.above;
+	const float bottom = y + (float)bird.below;
+	if (top < 0 || bottom >= (float)floorY)
+		return true;
+
+	const float shift = model.scrollSpeed * ((float)step * stepSeconds + model.clickDelay);
+	for (const Gap& gap : *gaps) {
+		const float left = (float)gap.left - shift;
+		const float right = (float)gap.right - shift;
+		if ((float)bird.right >= left && (float)bird.left <= right && (top < (float)gap.top || bottom > (float)gap.bottom))
+			return true;
+	}
+	return false;
+}
@@ -0,0 +1,135 @@
+#ifndef __FLAP_PLANNER_HPP__
+#define __FLAP_PLANNER_HPP__
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * \brief Plans when to flap by searching click/no-click sequences over the next second or so
+ *
+ * Time is cut into fixed steps, and at each step the bird either flaps (its velocity becomes the flap velocity)
+ * or keeps falling. With pipes scrolling at a constant speed, each sequence of choices is simulated against
+ * every visible gap, and the best one is the one that survives longest, then stays closest to the gap ahead,
+ * then flaps least. Sequences come back to the same state (time step, steps since the last flap, and height,
+ * to a few pixels) over and over, so each state is scored once and remembered, making the search
+ * dynamic programming over that grid instead of a search over every sequence.
+ *
+ * The search stops when it runs out of time, so plan() always returns within (about) its budget.
+ * The caller falls back to something cheaper when it does.
+ */
+class FlapPlanner {
+
+public:
+
+	typedef std::chrono::steady_clock Clock;
+
+	/// How the bird and the world move. Distances are in pixels, down is positive, and times are in seconds.
+	struct Model {
+		float gravity; ///< Downward acceleration
+		float flapVelocity; ///< Vertical velocity right after a flap (negative, as it's upward)
+		float scrollSpeed; ///< How fast the pipes move left
+		float clickDelay; ///< How long after a click is sent the bird actually flaps
+	};
+
+	/// The bird as it is now
+	struct Bird {
+		float y; ///< The center of the bird
+		float velocity;
+		int left; ///< The horizontal extent of the bird, which doesn't change
+		int right;
+		int above; ///< How far the bird reaches above its center
+		int below; ///< How far the bird reaches below its center
+	};
+
+	/// The opening between an upper and lower pipe, where they are now
+	struct Gap {
+		int left;
+		int right;
+		int top; ///< The bottom of the upper pipe
+		int bottom; ///< The top of the lower pipe
+	};
+
+	/// What came of planning
+	enum Outcome {
+		PO_PLANNED, ///< A plan survives the whole horizon
+		PO_DOOMED, ///< Every plan hits something, though clickIn still holds the one that lasts longest
+		PO_TIMED_OUT ///< The budget ran out before the search finished, so there's no plan
+	};
+
+	struct Plan {
+		Outcome outcome;
+		float clickIn; ///< How long from now to send the next click, or negative if not within the horizon
+		size_t states; ///< How many states were scored
+	};
+
+	/**
+	 * \param budget The longest plan() may take
+	 * \param horizonSteps How many steps ahead to plan
+	 * \param stepSeconds How long each step is
+	 */
+	explicit FlapPlanner(Clock::duration budget = std::chrono::milliseconds(2),
+	                     int horizonSteps = 30, float stepSeconds = 1.0f / 30.0f);
+
+	/**
+	 * \brief Finds when to click next
+	 * \param model How things move, as measured (see FlapFitter)
+	 * \param bird Where the bird is now
+	 * \param gaps Every visible gap, in any order
+	 * \param floorY The top of the ground
+	 * \param cruiseY Where to hold the bird when no gap is ahead
+	 */
+	Plan plan(const Model& model, const Bird& bird, const std::vector<Gap>& gaps, int floorY, int cruiseY);
+
+	Clock::duration getBudget() const { return budget; }
+
+	void setBudget(Clock::duration b) { budget = b; }
+
+	float getStepSeconds() const { return stepSeconds; }
+
+	FlapPlanner(const FlapPlanner&) = delete;
+	FlapPlanner& operator=(const FlapPlanner&) = delete;
+
+private:
+
+	/// Scores the best sequence from a state, remembering it and the choice that gets it
+	float score(int step, int sinceFlap, float y);
+
+	/// Where a state's score and choice are kept
+	size_t slotOf(int step, int sinceFlap, float y) const;
+
+	/// The bird's velocity at a step, given how many steps ago it last flapped (or never, as horizonSteps)
+	float velocityAt(int step, int sinceFlap) const;
+
+	/// True if the bird's box at height y hits a pipe, the ground, or the top of the screen at a step
+	bool collides(int step, float y) const;
+
+	Clock::duration budget;
+	const int horizonSteps;
+	const float stepSeconds;
+
+	// The problem being planned, for score()
+	Model model;
+	Bird bird;
+	const std::vector<Gap>* gaps = nullptr;
+	int floorY = 0;
+	int cruiseY = 0;
+	float startY = 0; ///< Where the bird is once a click sent now would take effect
+	float startVelocity = 0;
+
+	int bucketSize = 1; ///< Heights within the same bucket count as the same state
+	int bucketCount = 0;
+
+	// Remembered scores, which are only valid if their stamp is the current one, so nothing needs clearing
+	std::vector<uint32_t> stamps;
+	std::vector<float> scores;
+	std::vector<uint8_t> flaps; ///< Whether the best choice from each state is to flap
+	uint32_t currentStamp = 0;
+
+	size_t statesScored = 0;
+	Clock::time_point deadline;
+	bool timedOut = false;
+};
+
+#endif
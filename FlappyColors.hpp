@@ -0,0 +1,72 @@
+#ifndef __FLAPPY_COLORS_HPP__
+#define __FLAPPY_COLORS_HPP__
+
+/**
+ * \file FlappyColors.hpp
+ *
+ * The palette of the game, as RGB triplets.
+ * These are what FlappySearches looks for and what FrameSynthesizer paints with, so keep them in one place.
+ * The matching rules the detectors use live here too, so everything that classifies pixels agrees.
+ */
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+
+namespace FlappyColors {
+
+typedef std::array<uint8_t, 3> RGB;
+
+const RGB sky = { 112, 198, 206 };
+const RGB ground = { 221, 218, 147 };
+const RGB groundEdge = { 84, 56, 71 }; ///< The dark line between the pipes and the ground stripes
+const RGB gameOver = { 255, 255, 255 }; ///< The screen flashes white when the game ends
+
+const RGB beak = { 244, 106, 78 };
+const RGB birdYellow = { 252, 239, 40 };
+const RGB birdOrange = { 249, 187, 4 };
+const RGB birdEye = { 255, 255, 255 };
+const RGB birdPupil = { 0, 0, 0 };
+
+// Pipe shades, from the highlight on the left edge to the dark outline
+const RGB pipeHighlight = { 205, 252, 113 };
+const RGB pipeBody = { 139, 230, 68 };
+const RGB pipeShade = { 96, 182, 34 };
+const RGB pipeOutline = { 66, 121, 25 };
+
+/// How far off (per channel) a pixel can be from a sprite's color and still count as part of it
+const int spriteTolerance = 20;
+
+/// True if each channel of pix is within tolerance of the given color
+inline bool pixelIsApprox(const uint8_t* pix, const RGB& to, int tolerance = 5)
+{
+	const int r = pix[0];
+	const int g = pix[1];
+	const int b = pix[2];
+
+	const int tr = to[0];
+	const int tg = to[1];
+	const int tb = to[2];
+
+	return abs(r - tr) <= tolerance && abs(g - tg) <= tolerance && abs(b - tb) <= tolerance;
+}
+
+inline bool isBeakColor(const uint8_t* pix) { return pixelIsApprox(pix, beak, spriteTolerance); }
+
+/// The beak or either of the body colors
+inline bool isBirdColor(const uint8_t* pix)
+{
+	return isBeakColor(pix) || pixelIsApprox(pix, birdYellow, spriteTolerance) ||
+	       pixelIsApprox(pix, birdOrange, spriteTolerance);
+}
+
+/// Any of the pipe shades
+inline bool isPipeColor(const uint8_t* pix)
+{
+	return pixelIsApprox(pix, pipeHighlight, spriteTolerance) || pixelIsApprox(pix, pipeBody, spriteTolerance) ||
+	       pixelIsApprox(pix, pipeShade, spriteTolerance) || pixelIsApprox(pix, pipeOutline, spriteTolerance);
+}
+
+} // end namespace FlappyColors
+
+#endif
@@ -5,135 +5,478 @@
 #include <cstdint>
 #include <vector>
 
+#if defined(__x86_64__) || defined(__i386__)
+#define SEARCHES_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+#include "BitMask.hpp"
+#include "FlappyColors.hpp"
+#include "RectangleSet.hpp"
+#include "TileClassifier.hpp"
 #include "VideoFrame.hpp"
 
 using namespace std;
 
 namespace {
 
-const array<uint8_t, 3> flappySkyRGB = { 112, 198, 206 };
-const array<uint8_t, 3> flappyGroundRGB = { 221, 218, 147 };
-const array<uint8_t, 3> beakRGB = { 244, 106, 78 };
-const array<uint8_t, 3> gameOverRGB = { 255, 255, 255 };
+using FlappyColors::pixelIsApprox;
 
-const vector<array<uint8_t, 3>> birdRGBs = { beakRGB, {252, 239, 40}, {249, 187, 4} };
-const vector<array<uint8_t, 3>> pipeRGBs = { {205, 252, 113}, {139, 230, 68}, {96, 182, 34}, {66, 121, 25} };
+const array<uint8_t, 3> flappySkyRGB = FlappyColors::sky;
+const array<uint8_t, 3> flappyGroundRGB = FlappyColors::ground;
+const array<uint8_t, 3> gameOverRGB = FlappyColors::gameOver;
 
 const float normalizedBirdSize = 62.0f / 500.0f; // Size of the bird relative to the screen's width
 
-inline bool pixelIsApprox(const uint8_t* pix, array<uint8_t, 3> to, int tolerance = 5)
+/// Merges rectangles within tolerance of each other (see RectangleSet), largest first
+RectangleList mergeRects(const RectangleList& rects, int tolerance, FrameArena* arena = nullptr)
 {
-	const int r = pix[0];
-	const int g = pix[1];
-	const int b = pix[2];
+	RectangleSet set(tolerance, 32, arena);
+	set.add(rects);
+	return set.merge();
+}
 
-	const int tr = to[0];
-	const int tg = to[1];
-	const int tb = to[2];
+/// Adds one to counts[x] for each pixel x of the row that is a pipe color
+typedef void (*PipeCountFunction)(const uint8_t* row, size_t width, uint8_t* counts);
 
-	return abs(r - tr) <= tolerance && abs(g - tg) <= tolerance && abs(b - tb) <= tolerance;
+void countPipePixelsScalar(const uint8_t* row, size_t width, uint8_t* counts)
+{
+	for (size_t x = 0; x < width; ++x, row += 3)
+		counts[x] += FlappyColors::isPipeColor(row) ? 1 : 0;
 }
 
-void mergeAdjacentRects(vector<Rectangle>& rectList)
+#ifdef SEARCHES_HAVE_X86
+
+/// Sets each byte to 0xFF where the channel is within FlappyColors::spriteTolerance of value
+__attribute__((target("ssse3"), always_inline))
+inline __m128i channelNear(__m128i channel, uint8_t value)
 {
-	if (rectList.size() <= 1)
-		return;
+	const __m128i v = _mm_set1_epi8((char)value);
+	const __m128i diff = _mm_or_si128(_mm_subs_epu8(channel, v), _mm_subs_epu8(v, channel));
+	const __m128i over = _mm_subs_epu8(diff, _mm_set1_epi8((char)FlappyColors::spriteTolerance));
+	return _mm_cmpeq_epi8(over, _mm_setzero_si128());
+}
 
-	bool mergedOne;
-	do {
-		mergedOne = false;
+__attribute__((target("ssse3"), always_inline))
+inline __m128i colorNear(__m128i r, __m128i g, __m128i b, const FlappyColors::RGB& c)
+{
+	return _mm_and_si128(channelNear(r, c[0]), _mm_and_si128(channelNear(g, c[1]), channelNear(b, c[2])));
+}
 
-		const Rectangle& last = rectList.back();
-		for (int i = (int)rectList.size() - 2; i >= 0; --i) {
-			if (rectList[i].adjacentTo(last)) {
-				rectList[i].expandTo(last);
-				rectList.pop_back(); // erase last
-				mergedOne = true;
-				break;
-			}
+/// Sixteen pixels at a time: split the channels apart with byte shuffles, then compare all four pipe colors at once
+__attribute__((target("ssse3")))
+void countPipePixelsSSSE3(const uint8_t* row, size_t width, uint8_t* counts)
+{
+	const __m128i rMasks[3] = {
+		_mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1),
+		_mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1),
+		_mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13)
+	};
+	const __m128i gMasks[3] = {
+		_mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1),
+		_mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1),
+		_mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14)
+	};
+	const __m128i bMasks[3] = {
+		_mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1),
+		_mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1),
+		_mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15)
+	};
+	const __m128i one = _mm_set1_epi8(1);
+
+	size_t x = 0;
+	for (; x + 16 <= width; x += 16, row += 48) {
+		__m128i in[3];
+		for (int i = 0; i < 3; ++i)
+			in[i] = _mm_loadu_si128((const __m128i*)(row + 16 * i));
+
+		__m128i r = _mm_setzero_si128();
+		__m128i g = _mm_setzero_si128();
+		__m128i b = _mm_setzero_si128();
+		for (int i = 0; i < 3; ++i) {
+			r = _mm_or_si128(r, _mm_shuffle_epi8(in[i], rMasks[i]));
+			g = _mm_or_si128(g, _mm_shuffle_epi8(in[i], gMasks[i]));
+			b = _mm_or_si128(b, _mm_shuffle_epi8(in[i], bMasks[i]));
 		}
-	} while (mergedOne);
+
+		const __m128i pipe = _mm_or_si128(
+			_mm_or_si128(colorNear(r, g, b, FlappyColors::pipeHighlight), colorNear(r, g, b, FlappyColors::pipeBody)),
+			_mm_or_si128(colorNear(r, g, b, FlappyColors::pipeShade), colorNear(r, g, b, FlappyColors::pipeOutline)));
+
+		__m128i* out = (__m128i*)(counts + x);
+		_mm_storeu_si128(out, _mm_add_epi8(_mm_loadu_si128(out), _mm_and_si128(pipe, one)));
+	}
+
+	countPipePixelsScalar(row, width - x, counts + x);
 }
 
-auto biggestRect = [](const Rectangle& l, const Rectangle& r) { return l.getArea() > r.getArea(); };
+#endif // SEARCHES_HAVE_X86
 
-} // end anonymous namespace
+PipeCountFunction getPipeCounter()
+{
+#ifdef SEARCHES_HAVE_X86
+	if (__builtin_cpu_supports("ssse3"))
+		return &countPipePixelsSSSE3;
+#endif
+	return &countPipePixelsScalar;
+}
 
-Rectangle findGameWindow(const VideoFrame& frame)
+/// A vertical run of pipe-colored pixels in one column, inclusive
+struct ColumnRun {
+	int top;
+	int bottom;
+};
+
+/**
+ * \brief Finds the first and last runs of pipe color in a column, between the top of the frame and bottom
+ * \returns false unless there are two distinct runs (the halves of a pipe, one on each side of its gap)
+ */
+bool findPipeRuns(const VideoFrame& frame, int x, int bottom, ColumnRun& upper, ColumnRun& lower)
 {
-	vector<Rectangle> skyRects;
-	vector<Rectangle> groundRects;
+	auto isPipe = [&](int y) { return FlappyColors::isPipeColor(frame.getPixel((size_t)x, (size_t)y)); };
+
+	int y = 0;
+	while (y <= bottom && !isPipe(y))
+		++y;
+	if (y > bottom)
+		return false;
+	upper.top = y;
+	while (y <= bottom && isPipe(y))
+		++y;
+	upper.bottom = y - 1;
+
+	y = bottom;
+	while (y > upper.bottom && !isPipe(y))
+		--y;
+	if (y <= upper.bottom)
+		return false;
+	lower.bottom = y;
+	while (y > upper.bottom && isPipe(y))
+		--y;
+	lower.top = y + 1;
+	return true;
+}
 
-	frame.foreachPixel([&](const uint8_t* pix, int x, int y) {
+/**
+ * \brief Makes a rectangle out of a run, as wide as the pipe colors reach sideways from x near either end of it
+ *
+ * Several rows are checked at each end so that the bird covering the corner of a lip doesn't narrow the pipe.
+ */
+Rectangle widenRun(const VideoFrame& frame, int x, const ColumnRun& run)
+{
+	const int width = (int)frame.getWidth();
+	const int rowsPerEnd = max(4, (int)frame.getHeight() / 25);
+	Rectangle ret(x, run.top, x, run.bottom);
+
+	for (int i = 0; i < 2 * rowsPerEnd; ++i) {
+		const int y = i < rowsPerEnd ? min(run.top + i, run.bottom) : max(run.bottom - (i - rowsPerEnd), run.top);
+		int left = x;
+		while (left > 0 && FlappyColors::isPipeColor(frame.getPixel((size_t)left - 1, (size_t)y)))
+			--left;
+		int right = x;
+		while (right < width - 1 && FlappyColors::isPipeColor(frame.getPixel((size_t)right + 1, (size_t)y)))
+			++right;
+		ret.left = min(ret.left, left);
+		ret.right = max(ret.right, right);
+	}
+	return ret;
+}
 
-		auto adjacent = [=](const Rectangle& r) { return r.adjacentTo(x, y); };
+/**
+ * \brief Pushes the edges of a rectangle found on a coarse grid out to where the color actually ends
+ *
+ * Each edge is walked outward along a few rows or columns (its ends and middle),
+ * from wherever the coarse rectangle's edge has the color, and the farthest reach is kept.
+ */
+Rectangle refineEdges(const VideoFrame& frame, const Rectangle& coarse, const array<uint8_t, 3>& color)
+{
+	const int width = (int)frame.getWidth();
+	const int height = (int)frame.getHeight();
+	auto is = [&](int x, int y) { return pixelIsApprox(frame.getPixel((size_t)x, (size_t)y), color); };
+
+	Rectangle ret = coarse;
+
+	for (int y : { coarse.top, coarse.getCenterY(), coarse.bottom }) {
+		if (is(coarse.left, y)) {
+			int x = coarse.left;
+			while (x > 0 && is(x - 1, y))
+				--x;
+			ret.left = min(ret.left, x);
+		}
+		if (is(coarse.right, y)) {
+			int x = coarse.right;
+			while (x < width - 1 && is(x + 1, y))
+				++x;
+			ret.right = max(ret.right, x);
+		}
+	}
 
-		if (pixelIsApprox(pix, flappySkyRGB)) {
-			auto inside = find_if(begin(skyRects), end(skyRects), adjacent);
-			if (inside != end(skyRects))
-				inside->expandTo(x, y);
-			else
-				skyRects.emplace_back(x, y, x, y);
+	for (int x : { coarse.left, coarse.getCenterX(), coarse.right }) {
+		if (is(x, coarse.top)) {
+			int y = coarse.top;
+			while (y > 0 && is(x, y - 1))
+				--y;
+			ret.top = min(ret.top, y);
+		}
+		if (is(x, coarse.bottom)) {
+			int y = coarse.bottom;
+			while (y < height - 1 && is(x, y + 1))
+				++y;
+			ret.bottom = max(ret.bottom, y);
 		}
-		else if (pixelIsApprox(pix, flappyGroundRGB)) {
-			auto inside = find_if(begin(groundRects), end(groundRects), adjacent);
-			if (inside != end(groundRects))
-				inside->expandTo(x, y);
+	}
+
+	return ret;
+}
+
+/**
+ * \brief The blob search the pixel-based finders share: grows rectangles around the pixels of each class,
+ *        adding each pixel to the first rectangle (of its class) it's within tolerance of
+ * \param classOf Gives the class of a pixel, from 1 up, or 0 if it's in none of them
+ * \param rectsByClass Where to put the rectangles of each class, starting with class 1
+ */
+template <size_t Step, typename Classifier>
+void growRects(const VideoFrame& frame, Classifier classOf, int tolerance, RectangleList* rectsByClass)
+{
+	frame.foreachRow<Step>([&](const uint8_t* row, size_t length, size_t y) {
+		for (size_t x = 0; x < length; ++x) {
+			const int pixelClass = classOf(row + x * Step);
+			if (pixelClass == 0)
+				continue;
+
+			RectangleList& rects = rectsByClass[pixelClass - 1];
+			auto adjacent = [&](const Rectangle& r) { return r.adjacentTo((int)x, (int)y, tolerance); };
+
+			auto inside = find_if(begin(rects), end(rects), adjacent);
+			if (inside != end(rects))
+				inside->expandTo((int)x, (int)y);
 			else
-				groundRects.emplace_back(x, y, x, y);
+				rects.emplace_back((int)x, (int)y, (int)x, (int)y);
 		}
+		return true;
+	});
+}
 
+/// Runs growRects specialized for the frame's pixel step
+template <typename Classifier>
+void growRects(const VideoFrame& frame, Classifier classOf, int tolerance, RectangleList* rectsByClass)
+{
+	if (frame.getBytesPerPixel() == 4)
+		growRects<4>(frame, classOf, tolerance, rectsByClass);
+	else
+		growRects<3>(frame, classOf, tolerance, rectsByClass);
+}
+
+/// Expands bounds to take in every pixel of the frame the classifier picks out
+template <size_t Step, typename Classifier>
+void expandToMatches(const VideoFrame& frame, Classifier isMember, Rectangle& bounds)
+{
+	frame.foreachRow<Step>([&](const uint8_t* row, size_t length, size_t y) {
+		for (size_t x = 0; x < length; ++x) {
+			if (isMember(row + x * Step))
+				bounds.expandTo((int)x, (int)y);
+		}
 		return true;
 	});
+}
+
+/// True if every pixel of the frame is approximately the given color
+template <size_t Step>
+bool allApprox(const VideoFrame& frame, const array<uint8_t, 3>& color)
+{
+	bool all = true;
+	frame.foreachRow<Step>([&](const uint8_t* row, size_t length, size_t) {
+		for (size_t x = 0; x < length; ++x) {
+			if (!pixelIsApprox(row + x * Step, color)) {
+				all = false;
+				break;
+			}
+		}
+		return all;
+	});
+	return all;
+}
+
+} // end anonymous namespace
+
+const char* describe(SearchError e)
+{
+	switch (e) {
+		case SE_NONE: return "found";
+		case SE_NO_SKY: return "no sky";
+		case SE_NO_GROUND: return "no ground";
+		case SE_WINDOW_MISALIGNED: return "sky and ground don't line up";
+		case SE_NO_BEAK: return "no beak";
+		case SE_NO_FLOOR: return "no floor";
+		case SE_NO_GROUND_TOP: return "no top of the ground";
+		case SE_COUNT: break;
+	}
+	return "unknown";
+}
+
+SearchResult<Rectangle> findGameWindow(const VideoFrame& frame)
+{
+	RectangleList found[2];
+	growRects(frame, [](const uint8_t* pix) {
+		return pixelIsApprox(pix, flappySkyRGB) ? 1 : pixelIsApprox(pix, flappyGroundRGB) ? 2 : 0;
+	}, 1, found);
+	RectangleList& skyRects = found[0];
+	RectangleList& groundRects = found[1];
 
 	if (skyRects.empty())
-		throw Exceptions::Exception("Could not find a single sky rectangle", __FUNCTION__);
+		return SE_NO_SKY;
 
 	if (groundRects.empty())
-		throw Exceptions::Exception("Could not find a single ground rectangle", __FUNCTION__);
-
-	mergeAdjacentRects(skyRects);
-	mergeAdjacentRects(groundRects);
+		return SE_NO_GROUND;
 
-	sort(begin(skyRects), end(skyRects), biggestRect);
-	sort(begin(groundRects), end(groundRects), biggestRect);
+	skyRects = mergeRects(skyRects, 1);
+	groundRects = mergeRects(groundRects, 1);
 
 	const Rectangle& bigSky = skyRects[0];
 	const Rectangle& bigGround = groundRects[0];
 
 	if (bigSky.left != bigGround.left || bigSky.right != bigGround.right)
-		throw Exceptions::Exception("The sky and ground rectangles do not line up", __FUNCTION__);
+		return SE_WINDOW_MISALIGNED;
 
 	return Rectangle(bigSky.left, bigSky.top, bigGround.right, bigGround.bottom);
 }
 
-Point findBeakLocation(const VideoFrame& frame)
+SearchResult<Rectangle> findGameWindowCoarse(const VideoFrame& frame, int step)
 {
-	vector<Rectangle> beakRects;
+	if (step < 1)
+		throw Exceptions::ArgumentException("The step must be positive", __FUNCTION__);
+
+	RectangleList skyRects;
+	RectangleList groundRects;
 
-	frame.foreachPixel([&](const uint8_t* pix, int x, int y) {
+	// Same as findGameWindow, but only on every step-th pixel of every step-th row
+	for (size_t y = (size_t)step / 2; y < frame.getHeight(); y += (size_t)step) {
+		for (size_t x = (size_t)step / 2; x < frame.getWidth(); x += (size_t)step) {
+			const uint8_t* pix = frame.getPixel(x, y);
 
-		auto adjacent = [=](const Rectangle& r) { return r.adjacentTo(x, y); };
+			auto adjacent = [=](const Rectangle& r) { return r.adjacentTo((int)x, (int)y, step); };
+
+			RectangleList* rects;
+			if (pixelIsApprox(pix, flappySkyRGB))
+				rects = &skyRects;
+			else if (pixelIsApprox(pix, flappyGroundRGB))
+				rects = &groundRects;
+			else
+				continue;
 
-		if (pixelIsApprox(pix, beakRGB, 20)) {
-			auto inside = find_if(begin(beakRects), end(beakRects), adjacent);
-			if (inside != end(beakRects))
-				inside->expandTo(x, y);
+			auto inside = find_if(begin(*rects), end(*rects), adjacent);
+			if (inside != end(*rects))
+				inside->expandTo((int)x, (int)y);
 			else
-				beakRects.emplace_back(x, y, x, y);
+				rects->emplace_back((int)x, (int)y, (int)x, (int)y);
 		}
+	}
 
-		return true;
-	});
+	if (skyRects.empty())
+		return SE_NO_SKY;
+
+	if (groundRects.empty())
+		return SE_NO_GROUND;
+
+	skyRects = mergeRects(skyRects, step);
+	groundRects = mergeRects(groundRects, step);
+
+	const Rectangle bigSky = refineEdges(frame, skyRects[0], flappySkyRGB);
+	const Rectangle bigGround = refineEdges(frame, groundRects[0], flappyGroundRGB);
+
+	if (bigSky.left != bigGround.left || bigSky.right != bigGround.right)
+		return SE_WINDOW_MISALIGNED;
+
+	return Rectangle(bigSky.left, bigSky.top, bigGround.right, bigGround.bottom);
+}
+
+bool isGameWindowAt(const VideoFrame& frame, const Rectangle& r)
+{
+	const int width = (int)frame.getWidth();
+	const int height = (int)frame.getHeight();
+
+	if (r.left < 0 || r.top < 0 || r.right >= width || r.bottom >= height || r.left >= r.right || r.top >= r.bottom)
+		return false;
+
+	auto pix = [&](int x, int y) { return frame.getPixel((size_t)x, (size_t)y); };
+	auto skyOrPipe = [&](int x, int y) {
+		return pixelIsApprox(pix(x, y), flappySkyRGB) || FlappyColors::isPipeColor(pix(x, y));
+	};
+
+	const int samples = 8;
+	int skySeen = 0;
+
+	for (int i = 0; i < samples; ++i) {
+		const int x = r.left + (2 * i + 1) * r.getWidth() / (2 * samples);
+		// Sky (or a pipe) along the top, ground along the bottom...
+		if (!skyOrPipe(x, r.top) || !pixelIsApprox(pix(x, r.bottom), flappyGroundRGB))
+			return false;
+		if (pixelIsApprox(pix(x, r.top), flappySkyRGB))
+			++skySeen;
+		// ...and neither just past them, so we know the window hasn't grown or moved
+		if (r.top > 0 && pixelIsApprox(pix(x, r.top - 1), flappySkyRGB))
+			return false;
+		if (r.bottom < height - 1 && pixelIsApprox(pix(x, r.bottom + 1), flappyGroundRGB))
+			return false;
+
+		// Same for the sides, down the top half where the sky is
+		const int y = r.top + (2 * i + 1) * r.getHeight() / (4 * samples);
+		if (!skyOrPipe(r.left, y) || !skyOrPipe(r.right, y))
+			return false;
+		if (r.left > 0 && skyOrPipe(r.left - 1, y))
+			return false;
+		if (r.right < width - 1 && skyOrPipe(r.right + 1, y))
+			return false;
+	}
+
+	return skySeen > 0;
+}
+
+SearchResult<Point> findBeakLocation(const VideoFrame& frame, FrameArena* arena)
+{
+	RectangleList beakRects(arena);
+	growRects(frame, [](const uint8_t* pix) { return FlappyColors::isBeakColor(pix) ? 1 : 0; }, 1, &beakRects);
 
 	if (beakRects.empty())
-		throw Exceptions::Exception("Could not find a single beak rectangle", __FUNCTION__);
+		return SE_NO_BEAK;
 
-	mergeAdjacentRects(beakRects);
+	return mergeRects(beakRects, 1, arena)[0].getCenter();
+}
 
-	sort(begin(beakRects), end(beakRects), biggestRect);
+SearchResult<Point> findBeakLocation(const VideoFrame& frame, const Rectangle& within, FrameArena* arena)
+{
+	Rectangle area = within;
+	area.constrainBy(Rectangle(0, 0, (int)frame.getWidth() - 1, (int)frame.getHeight() - 1));
+
+	// Search a view of just that area, then bring the result back to the frame's coordinates
+	const VideoFrame roi(frame, area);
+	const SearchResult<Point> found = findBeakLocation(roi, arena);
+	if (!found.found())
+		return found;
+	return frame.fromParent(roi.toParent(found.value));
+}
 
-	return beakRects[0].getCenter();
+SearchResult<Point> findBeakLocation(const TileClassifier& tiles, FrameArena* arena)
+{
+	RectangleList pieces(arena);
+	tiles.collect(TileClassifier::TC_BEAK, pieces);
+
+	if (pieces.empty())
+		return SE_NO_BEAK;
+
+	return mergeRects(pieces, 1, arena)[0].getCenter();
+}
+
+SearchResult<Point> findBeakLocation(const BitMask& beak)
+{
+	vector<Rectangle> beakRects;
+	beak.components(beakRects);
+
+	if (beakRects.empty())
+		return SE_NO_BEAK;
+
+	return max_element(begin(beakRects), end(beakRects),
+	                   [](const Rectangle& l, const Rectangle& r) { return l.getArea() < r.getArea(); })->getCenter();
 }
 
 Rectangle findBird(const VideoFrame& frame, const Point beak)
@@ -142,60 +485,165 @@ Rectangle findBird(const VideoFrame& frame, const Point beak)
 	within.expandBy((int)(normalizedBirdSize * (float)frame.getWidth()));
 	within.constrainBy(Rectangle(0, 0, (int)frame.getWidth() - 1, (int)frame.getHeight() - 1));
 
-	Rectangle bird(beak);
+	if (within.left > within.right || within.top > within.bottom)
+		return Rectangle(beak);
 
-	for (int y = within.top; y <= within.bottom; ++y) {
-		const uint8_t* pixel = frame.getPixel((size_t)within.left, (size_t)y);
-		for (int x = within.left; x <= within.right; ++x, pixel +=3) {
-			if (any_of(begin(birdRGBs), end(birdRGBs),
-			        [=](const array<uint8_t, 3>& color) { return pixelIsApprox(pixel, color, 20); })) {
-				bird.expandTo(x, y);
-			}
-		}
-	}
+	// Work in a view of just that area, starting from the beak
+	const VideoFrame area(frame, within);
+	Rectangle bird(area.fromParent(frame.toParent(beak)));
 
-	return bird;
+	auto isBird = [](const uint8_t* pix) { return FlappyColors::isBirdColor(pix); };
+	if (area.getBytesPerPixel() == 4)
+		expandToMatches<4>(area, isBird, bird);
+	else
+		expandToMatches<3>(area, isBird, bird);
+
+	return frame.fromParent(area.toParent(bird));
 }
 
-vector<Rectangle> findPipes(const VideoFrame& frame)
+Rectangle findBird(const BitMask& bird, const Point beak)
 {
-	vector<Rectangle> pipes;
+	Rectangle within(beak);
+	within.expandBy((int)(normalizedBirdSize * (float)bird.getWidth()));
 
-	frame.foreachPixel([&](const uint8_t* pix, int x, int y) {
+	Rectangle ret(beak);
+	const Rectangle found = bird.boundsWithin(within);
+	if (found.left <= found.right)
+		ret.expandTo(found);
+	return ret;
+}
 
-		auto adjacent = [=](const Rectangle& r) { return r.adjacentTo(x, y, 5); };
+RectangleList findPipes(const VideoFrame& frame, FrameArena* arena)
+{
+	RectangleList pipes(arena);
+	growRects(frame, [](const uint8_t* pix) { return FlappyColors::isPipeColor(pix) ? 1 : 0; }, 5, &pipes);
 
-		if (any_of(begin(pipeRGBs), end(pipeRGBs),
-				[=](const array<uint8_t, 3>& color) { return pixelIsApprox(pix, color, 20); })) {
-			auto inside = find_if(begin(pipes), end(pipes), adjacent);
-			if (inside != end(pipes))
-				inside->expandTo(x, y);
-			else
-				pipes.emplace_back(x, y, x, y);
+	return mergeRects(pipes, 1, arena);
+}
+
+RectangleList findPipes(BitMask& pipes, FrameArena* arena)
+{
+	// Bridge the same gaps the pixel search's adjacency tolerance does. (Opening would also drop specks,
+	// but it costs the slivers of pipes scrolling in or out at the edges.)
+	pipes.close(2);
+
+	vector<Rectangle> found;
+	pipes.components(found);
+	return RectangleList(found.begin(), found.end(), arena);
+}
+
+RectangleList findPipes(const TileClassifier& tiles, FrameArena* arena)
+{
+	RectangleList pieces(arena);
+	tiles.collect(TileClassifier::TC_PIPE, pieces);
+	return mergeRects(pieces, 5, arena);
+}
+
+SearchResult<RectangleList> findPipesByColumns(const VideoFrame& frame, FrameArena* arena)
+{
+	if (frame.getDepth() != 3 || !frame.hasPackedPixels())
+		throw Exceptions::ArgumentException("The frame must be packed 24-bit RGB", __FUNCTION__);
+
+	const int width = (int)frame.getWidth();
+	const int height = (int)frame.getHeight();
+	auto isPipe = [&](int x, int y) { return FlappyColors::isPipeColor(frame.getPixel((size_t)x, (size_t)y)); };
+
+	// The floor is the pipe-colored band nearest the bottom. Pipes never reach the left edge down there.
+	Rectangle floor;
+	int y = height - 1;
+	while (y >= 0 && !isPipe(0, y))
+		--y;
+	if (y < 0)
+		return SE_NO_FLOOR;
+	floor = Rectangle(0, y, 0, y);
+	while (floor.top > 0 && isPipe(0, floor.top - 1))
+		--floor.top;
+	const int floorMiddle = floor.getCenterY();
+	while (floor.right < width - 1 && isPipe(floor.right + 1, floorMiddle))
+		++floor.right;
+
+	// Between the floor and the bottom of the pipes is a dark edge that is neither pipe nor sky
+	y = floor.top - 1;
+	while (y >= 0 && !isPipe(0, y) && !pixelIsApprox(frame.getPixel(0, (size_t)y), flappySkyRGB))
+		--y;
+	if (y < 0)
+		return SE_NO_GROUND_TOP;
+	const int pipesBottom = y;
+
+	// Every pipe reaches both the top of the screen and the ground, so count pipe colors in each column
+	// over a few rows at the top and a few at the bottom. Either set alone is enough to find a pipe,
+	// so the bird covering part of one doesn't hide it.
+	static const PipeCountFunction countPipePixels = getPipeCounter();
+	const int rowsPerEnd = 4;
+	const int rowStep = max(1, height / 200);
+	ArenaVector<uint8_t> counts((size_t)width, 0, arena);
+	for (int i = 0; i < rowsPerEnd; ++i) {
+		countPipePixels(frame.getPixel(0, (size_t)min(i * rowStep, pipesBottom)), (size_t)width, counts.data());
+		countPipePixels(frame.getPixel(0, (size_t)max(pipesBottom - i * rowStep, 0)), (size_t)width, counts.data());
+	}
+
+	RectangleList pipes(arena);
+	// Find the gap from columns at either edge of the pipe and in its middle, and keep the longest runs,
+	// in case the bird is in front of some of them.
+	auto addPipe = [&](int left, int right) {
+		bool any = false;
+		int x = 0;
+		ColumnRun upper, lower;
+		const int inset = min(1, (right - left) / 2);
+		for (int column : { left + inset, (left + right) / 2, right - inset }) {
+			ColumnRun u, l;
+			if (!findPipeRuns(frame, column, pipesBottom, u, l))
+				continue;
+			if (!any || u.bottom - u.top + l.bottom - l.top > upper.bottom - upper.top + lower.bottom - lower.top) {
+				x = column;
+				upper = u;
+				lower = l;
+			}
+			any = true;
+		}
+		if (any) {
+			pipes.push_back(widenRun(frame, x, upper));
+			pipes.push_back(widenRun(frame, x, lower));
+		}
+	};
+
+	const uint8_t minCount = rowsPerEnd / 2;
+	const int maxHole = 2; // Columns a span can skip over, for noise and anti-aliasing
+	int firstLeft = width;
+	int lastRight = -1;
+	for (int x = 0; x < width; ) {
+		if (counts[x] < minCount) {
+			++x;
+			continue;
 		}
 
-		return true;
-	});
+		const int left = x;
+		int right = x;
+		for (++x; x < width && x - right <= maxHole + 1; ++x) {
+			if (counts[x] >= minCount)
+				right = x;
+		}
+		x = right + 1;
+		firstLeft = min(firstLeft, left);
+		lastRight = max(lastRight, right);
+		addPipe(left, right);
+	}
 
-	mergeAdjacentRects(pipes);
+	// Near the edges of the screen, only a pipe's lips may be showing, which never reach the sampled rows.
+	// Skip an edge if a pipe we already found is close enough that its own lips could be what's there.
+	const int edgeMargin = max(maxHole + 1, width / 40);
+	if (firstLeft > edgeMargin)
+		addPipe(0, 0);
+	if (lastRight < width - 1 - edgeMargin)
+		addPipe(width - 1, width - 1);
 
-	return pipes;
+	pipes.push_back(floor);
+	return SearchResult<RectangleList>(std::move(pipes));
 }
 
 bool gameOver(const VideoFrame& frame)
 {
 	// The screen flashes white when the game ends
 
-	bool over = true;
-	frame.foreachPixel([&](const uint8_t* pix, int x, int y) {
-		(void)x; // Shut up, compiler
-		(void)y; // Shut up, compiler
-		if (!pixelIsApprox(pix, gameOverRGB)) {
-			over = false;
-			return false;
-		}
-		else return true;
-	});
-
-	return over;
+	return frame.getBytesPerPixel() == 4 ? allApprox<4>(frame, gameOverRGB) : allApprox<3>(frame, gameOverRGB);
 }
@@ -5,21 +5,111 @@
  * \file FlappySearches.hpp
  *
  * Finds things in Flappy Bird. Could be replaced with machine learning stuff if I have the time.
+ *
+ * Every search takes views (see VideoFrame) as well as whole frames, and reports what it finds in the
+ * coordinates of the frame it was given. VideoFrame::toParent converts results from a view.
+ *
+ * Searches that take a FrameArena keep their temporaries (and the lists they return) in it,
+ * so a loop that resets one arena per frame doesn't touch the heap. Without one, they use the heap.
+ *
+ * Coming up empty is routine (the game is between screens, or the bird flew off the top), and happens on
+ * frame after frame when it does, so searches that can fail say so with a SearchResult instead of throwing.
+ * Exceptions are left for misuse, like passing a frame in a format a search can't handle.
  */
 
+#include <utility>
 #include <vector>
 
+#include "FrameArena.hpp"
 #include "Rectangle.hpp"
 
+class BitMask;
+class TileClassifier;
 class VideoFrame;
 
-Rectangle findGameWindow(const VideoFrame& frame);
+/// Why a search didn't find what it was looking for
+enum SearchError {
+	SE_NONE,
+	SE_NO_SKY, ///< Nothing sky-colored (findGameWindow)
+	SE_NO_GROUND, ///< Nothing ground-colored (findGameWindow)
+	SE_WINDOW_MISALIGNED, ///< The biggest sky and ground areas don't line up (findGameWindow)
+	SE_NO_BEAK, ///< Nothing beak-colored
+	SE_NO_FLOOR, ///< Nothing pipe-colored down the left edge (findPipesByColumns)
+	SE_NO_GROUND_TOP, ///< No edge between the floor and the sky (findPipesByColumns)
+	SE_COUNT
+};
+
+/// A short description of the error, for messages
+const char* describe(SearchError e);
+
+/// What a search found, or why it didn't find anything
+template <typename T>
+struct SearchResult {
+	SearchResult(T v) : value(std::move(v)), error(SE_NONE) { }
+
+	SearchResult(SearchError e) : value(), error(e) { }
+
+	bool found() const { return error == SE_NONE; }
+
+	T value; ///< Only meaningful if found()
+	SearchError error;
+};
 
-Point findBeakLocation(const VideoFrame& frame);
+SearchResult<Rectangle> findGameWindow(const VideoFrame& frame);
+
+/**
+ * \brief Finds the game window like findGameWindow, but looks at only one pixel in step * step to start with
+ *
+ * The rough sky and ground rectangles found on that grid are then extended to their exact edges
+ * by walking outward from them at full resolution.
+ */
+SearchResult<Rectangle> findGameWindowCoarse(const VideoFrame& frame, int step = 8);
+
+/**
+ * \brief Quickly checks that the game window is (still) at r, by sampling a few points along its borders
+ * \param frame A frame containing r, ideally with a pixel to spare on each side so the edges can be checked
+ * \param r Where the game window should be, in the frame's coordinates
+ */
+bool isGameWindowAt(const VideoFrame& frame, const Rectangle& r);
 
+SearchResult<Point> findBeakLocation(const VideoFrame& frame, FrameArena* arena = nullptr);
+
+/// Finds the beak like findBeakLocation, but only looks within the given part of the frame
+SearchResult<Point> findBeakLocation(const VideoFrame& frame, const Rectangle& within, FrameArena* arena = nullptr);
+
+/// Finds the beak from the per-tile boxes of a TileClassifier that is up to date with the current frame
+SearchResult<Point> findBeakLocation(const TileClassifier& tiles, FrameArena* arena = nullptr);
+
+/// Finds the beak from a mask of beak-colored pixels (see FlappyColors::isBeakColor)
+SearchResult<Point> findBeakLocation(const BitMask& beak);
+
+/// Finds the bird around its beak. This can't fail: at worst, the bird is just the beak.
 Rectangle findBird(const VideoFrame& frame, const Point beak);
 
-std::vector<Rectangle> findPipes(const VideoFrame& frame);
+/// Finds the bird around its beak from a mask of bird-colored pixels (see FlappyColors::isBirdColor)
+Rectangle findBird(const BitMask& bird, const Point beak);
+
+RectangleList findPipes(const VideoFrame& frame, FrameArena* arena = nullptr);
+
+/// Finds the pipes from the per-tile boxes of a TileClassifier that is up to date with the current frame
+RectangleList findPipes(const TileClassifier& tiles, FrameArena* arena = nullptr);
+
+/**
+ * \brief Finds the pipes (and the floor) from a mask of pipe-colored pixels (see FlappyColors::isPipeColor)
+ *
+ * Instead of gluing nearby pixels together with a tolerance, the mask is closed to bridge small gaps
+ * (in place, so pass a copy if you need the original), then split into connected groups.
+ */
+RectangleList findPipes(BitMask& pipes, FrameArena* arena = nullptr);
+
+/**
+ * \brief Finds the pipes and the floor from a per-column profile instead of by growing blobs
+ *
+ * Returns the same rectangles findPipes does: each pipe's upper and lower halves, plus the floor.
+ * Only a handful of rows, and a few columns per pipe, are ever scanned.
+ * \throws Exceptions::ArgumentException if the frame isn't packed 24-bit RGB
+ */
+SearchResult<RectangleList> findPipesByColumns(const VideoFrame& frame, FrameArena* arena = nullptr);
 
 bool gameOver(const VideoFrame& frame);
 
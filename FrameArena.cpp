@@ -0,0 +1,35 @@
+#include "FrameArena.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+FrameArena::FrameArena(size_t initialBytes)
+	: block(new uint8_t[max<size_t>(initialBytes, 1)]),
+	  capacity(max<size_t>(initialBytes, 1)),
+	  current(block.get()),
+	  end(block.get() + capacity)
+{ }
+
+void FrameArena::reset()
+{
+	if (!overflow.empty()) {
+		// Make room for everything this frame needed in one block, with some to spare
+		const size_t needed = getBytesUsed();
+		overflow.clear();
+		capacity = needed + needed / 2;
+		block.reset(new uint8_t[capacity]);
+		end = block.get() + capacity;
+	}
+	current = block.get();
+	spilled = 0;
+}
+
+void* FrameArena::allocateSlow(size_t bytes, size_t align)
+{
+	// operator new[] only promises alignment for fundamental types, so leave room to align by hand
+	overflow.emplace_back(new uint8_t[bytes + align]);
+	spilled += bytes + align;
+	const uintptr_t start = ((uintptr_t)overflow.back().get() + align - 1) & ~(uintptr_t)(align - 1);
+	return (void*)start;
+}
@@ -0,0 +1,109 @@
+#ifndef __FRAME_ARENA_HPP__
+#define __FRAME_ARENA_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "Rectangle.hpp"
+
+/**
+ * \brief Memory for the temporaries of one frame's processing, all freed at once when the next frame starts
+ *
+ * Allocating is bumping a pointer, and freeing does nothing until reset(). The arena keeps its memory between
+ * frames: if a frame needed more than it had, reset() replaces everything with one block big enough for
+ * that frame, so once the loop has seen its busiest frame it stops touching the heap entirely.
+ * Use it through ArenaAllocator (and containers like RectangleList), one arena per thread.
+ */
+class FrameArena {
+
+public:
+
+	/// \param initialBytes How much to allocate up front
+	explicit FrameArena(size_t initialBytes = 64 * 1024);
+
+	/// Returns bytes of memory aligned to align (a power of two), good until the next reset
+	void* allocate(size_t bytes, size_t align)
+	{
+		const uintptr_t start = ((uintptr_t)current + align - 1) & ~(uintptr_t)(align - 1);
+		if (start + bytes > (uintptr_t)end)
+			return allocateSlow(bytes, align);
+		current = (uint8_t*)(start + bytes);
+		return (void*)start;
+	}
+
+	/// Frees everything allocated since the last reset. Call it at the start of each frame.
+	void reset();
+
+	/// Bytes handed out (alignment included) since the last reset
+	size_t getBytesUsed() const { return spilled + (size_t)(current - block.get()); }
+
+	/// Bytes the arena can hand out before it next needs the heap
+	size_t getCapacity() const { return capacity; }
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+private:
+
+	/// Takes memory from the heap when the block runs out, until the next reset makes the block bigger
+	void* allocateSlow(size_t bytes, size_t align);
+
+	std::unique_ptr<uint8_t[]> block;
+	size_t capacity;
+	uint8_t* current;
+	uint8_t* end;
+
+	std::vector<std::unique_ptr<uint8_t[]>> overflow; ///< Memory taken from the heap this frame
+	size_t spilled = 0; ///< Bytes handed out from overflow
+};
+
+/**
+ * \brief A standard allocator over a FrameArena, or over the heap if given none
+ *
+ * Containers using the heap behave like any other, so code can take an optional arena (nullptr for the heap)
+ * and build the same containers either way. Containers over an arena must not outlive its next reset.
+ */
+template <typename T>
+class ArenaAllocator {
+
+public:
+
+	typedef T value_type;
+
+	ArenaAllocator(FrameArena* a = nullptr) : arena(a) { }
+
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& o) : arena(o.arena) { }
+
+	T* allocate(size_t n)
+	{
+		if (arena == nullptr)
+			return static_cast<T*>(::operator new(n * sizeof(T)));
+		return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T* p, size_t)
+	{
+		if (arena == nullptr)
+			::operator delete(p);
+	}
+
+	FrameArena* arena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena == b.arena; }
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena != b.arena; }
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+/// What the searches return rectangles in
+typedef ArenaVector<Rectangle> RectangleList;
+
+#endif
@@ -0,0 +1,253 @@
+#include "FrameRecording.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "Exceptions.hpp"
+
+using namespace std;
+
+namespace {
+
+const char recordingMagic[8] = { 'F', 'L', 'A', 'P', 'R', 'E', 'C', '1' };
+const uint32_t recordingVersion = 1;
+
+string describeError(const string& what, const string& path)
+{
+	return what + " " + path + ": " + strerror(errno);
+}
+
+} // end anonymous namespace
+
+FrameRecorder::FrameRecorder(const string& path, size_t w, size_t h, size_t bufferCount)
+	: width(w),
+	  height(h),
+	  recordSize(sizeof(Recording::FrameHeader) + w * h * 3),
+	  fd(-1),
+	  recorded(0),
+	  dropped(0),
+	  failed(false)
+{
+	if (w == 0 || h == 0 || bufferCount == 0)
+		throw Exceptions::ArgumentException("A recording needs a size and somewhere to buffer frames", __FUNCTION__);
+
+	fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		throw Exceptions::IOException(describeError("Could not create", path), __FUNCTION__);
+
+	Recording::FileHeader header;
+	memcpy(header.magic, recordingMagic, sizeof(header.magic));
+	header.version = recordingVersion;
+	header.width = (uint32_t)w;
+	header.height = (uint32_t)h;
+	header.depth = 3;
+	header.headerSize = sizeof(header);
+	if (!writeAll((const uint8_t*)&header, sizeof(header))) {
+		const string error = describeError("Could not write to", path);
+		close(fd);
+		throw Exceptions::IOException(error, __FUNCTION__);
+	}
+
+	buffers.resize(bufferCount);
+	for (auto& b : buffers)
+		b.resize(recordSize);
+
+	writer = thread(&FrameRecorder::writerProc, this);
+}
+
+FrameRecorder::~FrameRecorder()
+{
+	finish();
+	close(fd);
+}
+
+void FrameRecorder::finish()
+{
+	{
+		lock_guard<mutex> lock(queueMutex);
+		stopping = true;
+	}
+	queueCV.notify_all();
+	if (writer.joinable())
+		writer.join();
+}
+
+bool FrameRecorder::record(const VideoFrame& frame, bool wait)
+{
+	if (frame.getWidth() != width || frame.getHeight() != height || frame.getDepth() != 3 ||
+	    failed.load(memory_order_relaxed)) {
+		dropped.fetch_add(1, memory_order_relaxed);
+		return false;
+	}
+
+	uint8_t* slot;
+	{
+		unique_lock<mutex> lock(queueMutex);
+		if (wait && !stopping)
+			spaceCV.wait(lock, [this] { return queued < buffers.size(); });
+		if (queued == buffers.size() || stopping) {
+			dropped.fetch_add(1, memory_order_relaxed);
+			return false;
+		}
+		// Only this thread fills buffers, and the writer won't touch this one until it's queued
+		slot = buffers[head].data();
+	}
+
+	Recording::FrameHeader header;
+	header.frameID = frame.getFrameID();
+	header.captureTime = chrono::duration_cast<chrono::nanoseconds>(frame.getCaptureTime().time_since_epoch()).count();
+	memcpy(slot, &header, sizeof(header));
+
+	uint8_t* out = slot + sizeof(header);
+	const size_t rowBytes = width * 3;
+	if (frame.hasPackedPixels()) {
+		for (size_t y = 0; y < height; ++y, out += rowBytes)
+			memcpy(out, frame.getPixel(0, y), rowBytes);
+	}
+	else {
+		frame.foreachRow<4>([&](const uint8_t* row, size_t count, size_t) {
+			for (size_t x = 0; x < count; ++x, out += 3) {
+				out[0] = row[x * 4];
+				out[1] = row[x * 4 + 1];
+				out[2] = row[x * 4 + 2];
+			}
+			return true;
+		});
+	}
+
+	{
+		lock_guard<mutex> lock(queueMutex);
+		head = (head + 1) % buffers.size();
+		++queued;
+	}
+	queueCV.notify_one();
+	return true;
+}
+
+void FrameRecorder::writerProc()
+{
+	for (;;) {
+		const uint8_t* slot;
+		{
+			unique_lock<mutex> lock(queueMutex);
+			queueCV.wait(lock, [this] { return queued > 0 || stopping; });
+			if (queued == 0)
+				return;
+			slot = buffers[tail].data();
+		}
+
+		if (!failed.load(memory_order_relaxed)) {
+			if (writeAll(slot, recordSize))
+				recorded.fetch_add(1, memory_order_relaxed);
+			else
+				failed.store(true, memory_order_relaxed);
+		}
+
+		{
+			lock_guard<mutex> lock(queueMutex);
+			tail = (tail + 1) % buffers.size();
+			--queued;
+		}
+		spaceCV.notify_one();
+	}
+}
+
+bool FrameRecorder::writeAll(const uint8_t* data, size_t size)
+{
+	while (size > 0) {
+		const ssize_t written = write(fd, data, size);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		data += written;
+		size -= (size_t)written;
+	}
+	return true;
+}
+
+FrameRecording::FrameRecording(const string& p)
+	: path(p)
+{
+	fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw Exceptions::IOException(describeError("Could not open", path), __FUNCTION__);
+
+	Recording::FileHeader header;
+	struct stat info;
+	if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) || fstat(fd, &info) != 0 ||
+	    memcmp(header.magic, recordingMagic, sizeof(header.magic)) != 0 || header.version != recordingVersion ||
+	    header.depth != 3 || header.width == 0 || header.height == 0 || header.headerSize < sizeof(header)) {
+		close(fd);
+		throw Exceptions::IOException(path + " is not a recording this version can read", __FUNCTION__);
+	}
+
+	width = header.width;
+	height = header.height;
+	headerSize = (size_t)header.headerSize;
+	recordSize = sizeof(Recording::FrameHeader) + width * height * 3;
+	frameCount = (size_t)info.st_size > headerSize ? ((size_t)info.st_size - headerSize) / recordSize : 0;
+
+	// Each reader goes through the file in order, so have the kernel read ahead further
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+FrameRecording::~FrameRecording()
+{
+	close(fd);
+}
+
+void FrameRecording::read(size_t index, VideoFrame& into) const
+{
+	if (index >= frameCount)
+		throw Exceptions::ArgumentOutOfRangeException("No such frame in the recording", __FUNCTION__);
+	if (into.getWidth() != width || into.getHeight() != height || into.getDepth() != 3 ||
+	    !into.hasPackedPixels() || into.getPitch() != width * 3)
+		throw Exceptions::ArgumentException("Frames must be read into a packed frame of the recording's size",
+		                                    __FUNCTION__);
+
+	// The header and the pixels go straight where they belong, in one call
+	Recording::FrameHeader header;
+	struct iovec parts[2];
+	parts[0].iov_base = &header;
+	parts[0].iov_len = sizeof(header);
+	parts[1].iov_base = into.getPixels();
+	parts[1].iov_len = width * height * 3;
+
+	const off_t offset = (off_t)(headerSize + index * recordSize);
+	size_t done = 0;
+	while (done < recordSize) {
+		// Skip past whatever an earlier, short read already filled in
+		struct iovec remaining[2];
+		int count = 0;
+		size_t skip = done;
+		for (const auto& part : parts) {
+			if (skip >= part.iov_len) {
+				skip -= part.iov_len;
+				continue;
+			}
+			remaining[count].iov_base = (uint8_t*)part.iov_base + skip;
+			remaining[count].iov_len = part.iov_len - skip;
+			skip = 0;
+			++count;
+		}
+
+		const ssize_t got = preadv(fd, remaining, count, offset + (off_t)done);
+		if (got < 0 && errno == EINTR)
+			continue;
+		if (got <= 0)
+			throw Exceptions::IOException(describeError("Could not read a frame from", path), __FUNCTION__);
+		done += (size_t)got;
+	}
+
+	into.setFrameID(header.frameID);
+	into.setCaptureTime(chrono::steady_clock::time_point(
+		chrono::duration_cast<chrono::steady_clock::duration>(chrono::nanoseconds(header.captureTime))));
+	into.setDuplicate(false);
+}
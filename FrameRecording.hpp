@@ -0,0 +1,167 @@
+#ifndef __FRAME_RECORDING_HPP__
+#define __FRAME_RECORDING_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "VideoFrame.hpp"
+
+/**
+ * \file FrameRecording.hpp
+ *
+ * A recording is a file of frames as they were captured, for going over again offline.
+ * It starts with a FileHeader, followed by one record per frame: a FrameHeader, then the frame's pixels as
+ * packed 24-bit RGB rows with no padding. Every frame in a recording is the same size, so every record is too,
+ * and any frame can be read straight from its offset without reading the ones before it. That's what lets
+ * several threads read one recording at once. Everything is in the byte order of the machine that wrote it.
+ */
+
+namespace Recording {
+
+struct FileHeader {
+	char magic[8]; ///< "FLAPREC1"
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t depth; ///< Bytes per pixel, which is always 3 for now
+	uint64_t headerSize; ///< Where the first frame starts, so later versions can add to this header
+};
+
+struct FrameHeader {
+	uint64_t frameID;
+	int64_t captureTime; ///< Nanoseconds on the steady clock, so only meaningful relative to other frames
+};
+
+static_assert(sizeof(FileHeader) == 32 && sizeof(FrameHeader) == 16, "Recording headers must not be padded");
+
+} // end namespace Recording
+
+/**
+ * \brief Writes frames to a recording on a thread of its own
+ *
+ * record() copies the frame into one of a fixed number of buffers and returns, so the thread handing it frames
+ * doesn't wait on the disk. If the disk falls behind and every buffer is full, the frame is dropped
+ * (and counted) instead, unless record() is told to wait.
+ */
+class FrameRecorder {
+
+public:
+
+	/**
+	 * \brief Creates (or truncates) a recording and starts the thread writing to it
+	 * \param path Where to write
+	 * \param w Width of every frame that will be recorded
+	 * \param h Height of every frame that will be recorded
+	 * \param buffers How many frames can wait to be written at once
+	 * \throws Exceptions::IOException if the file can't be created
+	 */
+	FrameRecorder(const std::string& path, size_t w, size_t h, size_t buffers = 16);
+
+	/// Finishes, if that hasn't been done yet
+	~FrameRecorder();
+
+	/// Writes out any frames still waiting and stops the writer. Frames recorded after this are dropped.
+	void finish();
+
+	/**
+	 * \brief Queues a frame to be written
+	 * \param wait Wait for the writer to catch up when it's behind, instead of dropping the frame.
+	 *             For recording something that can wait, like a simulated game.
+	 * \returns false if it was dropped, because the writer is behind or the frame is the wrong size
+	 */
+	bool record(const VideoFrame& frame, bool wait = false);
+
+	uint64_t getRecordedCount() const { return recorded.load(std::memory_order_relaxed); }
+
+	uint64_t getDroppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+	/// True if a write failed, after which nothing more is written
+	bool hasFailed() const { return failed.load(std::memory_order_relaxed); }
+
+	FrameRecorder(const FrameRecorder&) = delete;
+	FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+private:
+
+	void writerProc();
+
+	/// Writes all of a buffer, retrying short writes, returning false on an error
+	bool writeAll(const uint8_t* data, size_t size);
+
+	const size_t width;
+	const size_t height;
+	const size_t recordSize;
+	int fd;
+
+	// A ring of buffers, each holding one whole record. The recording thread fills them at head,
+	// and the writer empties them at tail.
+	std::vector<std::vector<uint8_t>> buffers;
+	size_t head = 0;
+	size_t tail = 0;
+	size_t queued = 0;
+	bool stopping = false;
+	std::mutex queueMutex;
+	std::condition_variable queueCV; ///< Signaled when a frame is queued
+	std::condition_variable spaceCV; ///< Signaled when a frame has been written
+	std::thread writer;
+
+	std::atomic<uint64_t> recorded;
+	std::atomic<uint64_t> dropped;
+	std::atomic<bool> failed;
+};
+
+/**
+ * \brief A recording opened for reading
+ *
+ * read() doesn't move a shared file position, so any number of threads can read from the same recording at once.
+ */
+class FrameRecording {
+
+public:
+
+	/// \throws Exceptions::IOException if the file can't be opened or isn't a recording
+	explicit FrameRecording(const std::string& path);
+
+	~FrameRecording();
+
+	/// How many whole frames the recording holds. A frame cut short (e.g. by a crash while recording) isn't counted.
+	size_t getFrameCount() const { return frameCount; }
+
+	size_t getWidth() const { return width; }
+
+	size_t getHeight() const { return height; }
+
+	/// How many bytes each frame takes up in the file
+	size_t getRecordSize() const { return recordSize; }
+
+	const std::string& getPath() const { return path; }
+
+	/**
+	 * \brief Reads a frame into an existing one, which must be packed and the recording's size,
+	 *        setting its frame ID and capture time
+	 * \throws Exceptions::IOException if the read fails
+	 */
+	void read(size_t index, VideoFrame& into) const;
+
+	FrameRecording(const FrameRecording&) = delete;
+	FrameRecording& operator=(const FrameRecording&) = delete;
+
+private:
+
+	const std::string path;
+	int fd;
+	size_t width;
+	size_t height;
+	size_t headerSize;
+	size_t recordSize;
+	size_t frameCount;
+};
+
+#endif
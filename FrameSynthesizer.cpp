@@ -0,0 +1,415 @@
+#include "FrameSynthesizer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Exceptions.hpp"
+#include "FlappyColors.hpp"
+
+using namespace std;
+
+namespace {
+
+const int noiseTableSize = 1 << 16;
+
+inline uint8_t blend(uint8_t a, uint8_t b) { return (uint8_t)(((int)a + (int)b + 1) / 2); }
+
+/// Writes a sprite pixel over a packed RGB pixel, blending anti-aliased edges with what's already there
+inline void paint(uint8_t* pix, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+	if (a == 255) {
+		pix[0] = r;
+		pix[1] = g;
+		pix[2] = b;
+	}
+	else if (a != 0) {
+		pix[0] = blend(pix[0], r);
+		pix[1] = blend(pix[1], g);
+		pix[2] = blend(pix[2], b);
+	}
+}
+
+/// A cheap integer hash, used to pick gap heights for typicalScene
+inline uint32_t hashPosition(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	x *= 0x846ca68b;
+	x ^= x >> 16;
+	return x;
+}
+
+} // end anonymous namespace
+
+FrameSynthesizer::FrameSynthesizer(size_t w, size_t h, bool aa, uint32_t seed)
+	: width(w),
+	  height(h),
+	  antiAlias(aa),
+	  scaledNoiseAmount(0),
+	  rngState(seed == 0 ? 1 : seed)
+{
+	if (w < 64 || h < 64)
+		throw Exceptions::ArgumentException("Synthetic frames must be at least 64x64", __FUNCTION__);
+
+	const int iw = (int)w;
+	const int ih = (int)h;
+
+	// Proportions eyeballed from the Flash version of the game.
+	// The dark line above the ground must be more than 5 pixels tall so that findPipes
+	// doesn't glue the bottom pipes to the striped ground.
+	groundTop = ih * 4 / 5;
+	groundStripeTop = groundTop + max(7, ih / 100);
+	groundTanTop = groundStripeTop + max(3, ih / 50);
+
+	pipeWidth = max(8, iw * 14 / 100);
+	lipOverhang = max(2, iw * 12 / 1000);
+	lipHeight = max(4, iw / 20);
+
+	birdWidth = max(10, iw * 9 / 100);
+	birdHeight = max(7, iw * 65 / 1000);
+	beakWidth = max(3, birdWidth / 4);
+	beakHeight = max(2, birdHeight / 4);
+
+	gapHeight = max(birdHeight * 3, groundTop / 4);
+	pipeSpacing = max(pipeWidth * 3, iw * 3 / 5);
+
+	buildBackground();
+	buildPipeRows();
+	buildBird();
+
+	noiseTable.resize(noiseTableSize);
+	for (auto& n : noiseTable)
+		n = (int8_t)((int)(nextRandom() % 255) - 127);
+}
+
+void FrameSynthesizer::buildBackground()
+{
+	using namespace FlappyColors;
+
+	const int stripeWidth = max(2, (int)width / 50);
+
+	background.resize(width * height * 3);
+	uint8_t* pix = background.data();
+	for (int y = 0; y < (int)height; ++y) {
+		for (int x = 0; x < (int)width; ++x, pix += 3) {
+			const RGB* c;
+			if (y < groundTop)
+				c = &sky;
+			else if (y < groundStripeTop)
+				c = &groundEdge;
+			else if (y < groundTanTop)
+				c = ((x / stripeWidth) % 2 == 0) ? &pipeBody : &pipeShade;
+			else
+				c = &ground;
+			memcpy(pix, c->data(), 3);
+		}
+	}
+}
+
+void FrameSynthesizer::buildPipeRows()
+{
+	using namespace FlappyColors;
+
+	auto buildRow = [this](int w) {
+		// One extra column on each side for anti-aliasing
+		vector<SpritePixel> row(w + 2);
+		const int outline = max(1, w / 24);
+		const int highlightEnd = outline + w * 15 / 100;
+		const int bodyEnd = highlightEnd + w / 2;
+		for (int i = 0; i < w; ++i) {
+			const RGB* c;
+			if (i < outline || i >= w - outline)
+				c = &pipeOutline;
+			else if (i < highlightEnd)
+				c = &pipeHighlight;
+			else if (i < bodyEnd)
+				c = &pipeBody;
+			else
+				c = &pipeShade;
+			row[i + 1] = { (*c)[0], (*c)[1], (*c)[2], 255 };
+		}
+		const uint8_t edgeAlpha = antiAlias ? 128 : 0;
+		row.front() = { pipeOutline[0], pipeOutline[1], pipeOutline[2], edgeAlpha };
+		row.back() = row.front();
+		return row;
+	};
+
+	pipeBodyRow = buildRow(pipeWidth);
+	pipeLipRow = buildRow(pipeWidth + 2 * lipOverhang);
+}
+
+void FrameSynthesizer::buildBird()
+{
+	using namespace FlappyColors;
+
+	// A one pixel margin on each side for anti-aliasing
+	birdSpriteWidth = birdWidth + beakWidth / 2 + 2;
+	birdSpriteHeight = birdHeight + 2;
+	birdSprite.assign(birdSpriteWidth * birdSpriteHeight, SpritePixel{ 0, 0, 0, 0 });
+
+	const float cx = 1.0f + (float)birdWidth / 2.0f - 0.5f;
+	const float cy = 1.0f + (float)birdHeight / 2.0f - 0.5f;
+	const float a = (float)birdWidth / 2.0f;
+	const float b = (float)birdHeight / 2.0f;
+
+	auto insideBody = [&](int x, int y) {
+		const float dx = ((float)x - cx) / a;
+		const float dy = ((float)y - cy) / b;
+		return dx * dx + dy * dy <= 1.0f;
+	};
+
+	auto insideCircle = [](int x, int y, float ox, float oy, float r) {
+		const float dx = (float)x - ox;
+		const float dy = (float)y - oy;
+		return dx * dx + dy * dy <= r * r;
+	};
+
+	const float eyeX = cx + a * 0.45f;
+	const float eyeY = cy - b * 0.35f;
+	const float eyeRadius = max(1.0f, b * 0.3f);
+
+	beakOpaque = Rectangle(1 + birdWidth - beakWidth / 2, (int)cy + 1,
+	                       1 + birdWidth - beakWidth / 2 + beakWidth - 1, (int)cy + beakHeight);
+
+	birdOpaque = Rectangle(birdSpriteWidth, birdSpriteHeight, 0, 0);
+
+	for (int y = 0; y < birdSpriteHeight; ++y) {
+		for (int x = 0; x < birdSpriteWidth; ++x) {
+			SpritePixel& p = birdSprite[y * birdSpriteWidth + x];
+			const RGB* c = nullptr;
+
+			if (beakOpaque.contains(x, y))
+				c = &beak;
+			else if (insideBody(x, y)) {
+				if (insideCircle(x, y, eyeX, eyeY, eyeRadius / 2.0f))
+					c = &birdPupil;
+				else if (insideCircle(x, y, eyeX, eyeY, eyeRadius))
+					c = &birdEye;
+				else if ((float)y > cy + b * 0.2f)
+					c = &birdOrange;
+				else
+					c = &birdYellow;
+			}
+
+			if (c != nullptr) {
+				p = { (*c)[0], (*c)[1], (*c)[2], 255 };
+				birdOpaque.left = min(birdOpaque.left, x);
+				birdOpaque.top = min(birdOpaque.top, y);
+				birdOpaque.right = max(birdOpaque.right, x);
+				birdOpaque.bottom = max(birdOpaque.bottom, y);
+			}
+		}
+	}
+
+	if (!antiAlias)
+		return;
+
+	// Feather the body's edge into whatever is behind it
+	for (int y = 0; y < birdSpriteHeight; ++y) {
+		for (int x = 0; x < birdSpriteWidth; ++x) {
+			SpritePixel& p = birdSprite[y * birdSpriteWidth + x];
+			if (p.a != 0)
+				continue;
+
+			for (int ny = max(0, y - 1); ny <= min(birdSpriteHeight - 1, y + 1) && p.a == 0; ++ny) {
+				for (int nx = max(0, x - 1); nx <= min(birdSpriteWidth - 1, x + 1); ++nx) {
+					const SpritePixel& n = birdSprite[ny * birdSpriteWidth + nx];
+					if (n.a == 255) {
+						p = { n.r, n.g, n.b, 128 };
+						break;
+					}
+				}
+			}
+		}
+	}
+}
+
+SyntheticTruth FrameSynthesizer::render(const SyntheticScene& scene, VideoFrame& frame, Point offset)
+{
+	if (frame.getDepth() != 3 || !frame.hasPackedPixels())
+		throw Exceptions::ArgumentException("The frame must be packed 24-bit RGB", __FUNCTION__);
+
+	if (offset.x < 0 || offset.y < 0 ||
+	    (size_t)offset.x + width > frame.getWidth() || (size_t)offset.y + height > frame.getHeight())
+		throw Exceptions::ArgumentException("The game does not fit in the frame at that offset", __FUNCTION__);
+
+	const size_t pitch = frame.getPitch();
+	uint8_t* game = frame.getPixel((size_t)offset.x, (size_t)offset.y);
+
+	SyntheticTruth truth;
+	truth.gameRect = Rectangle(offset.x, offset.y, offset.x + (int)width - 1, offset.y + (int)height - 1);
+
+	if (scene.gameOver) {
+		for (size_t y = 0; y < height; ++y)
+			memset(game + y * pitch, 255, width * 3);
+		return truth;
+	}
+
+	for (size_t y = 0; y < height; ++y)
+		memcpy(game + y * pitch, &background[y * width * 3], width * 3);
+
+	truth.floor = Rectangle(offset.x, offset.y + groundStripeTop,
+	                        offset.x + (int)width - 1, offset.y + groundTanTop - 1);
+
+	const Rectangle gameBounds(0, 0, (int)width - 1, (int)height - 1);
+
+	for (const auto& pipe : scene.pipes) {
+		// Offsets into the row patterns skip the anti-aliasing column
+		const int bodyLeft = pipe.left - 1;
+		const int lipLeft = pipe.left - lipOverhang - 1;
+		const int topLipStart = max(0, pipe.gapTop - lipHeight);
+		const int bottomLipEnd = min(groundTop - 1, pipe.gapBottom + lipHeight);
+
+		blitPipeRows(game, pitch, pipeBodyRow, bodyLeft, 0, topLipStart - 1);
+		blitPipeRows(game, pitch, pipeLipRow, lipLeft, topLipStart, pipe.gapTop - 1);
+		blitPipeRows(game, pitch, pipeLipRow, lipLeft, pipe.gapBottom + 1, bottomLipEnd);
+		blitPipeRows(game, pitch, pipeBodyRow, bodyLeft, bottomLipEnd + 1, groundTop - 1);
+
+		// Only report what actually made it onto the screen: near the edges, just a lip may be visible.
+		const Rectangle body(pipe.left, 0, pipe.left + pipeWidth - 1, groundTop - 1);
+		const Rectangle lip(pipe.left - lipOverhang, 0, pipe.left + pipeWidth + lipOverhang - 1, groundTop - 1);
+		auto visible = [&](Rectangle r, int top, int bottom) {
+			r.top = top;
+			r.bottom = bottom;
+			r.constrainBy(gameBounds);
+			return r;
+		};
+		auto nonEmpty = [](const Rectangle& r) { return r.left <= r.right && r.top <= r.bottom; };
+
+		const Rectangle segments[2][2] = {
+			{ visible(body, 0, topLipStart - 1), visible(lip, topLipStart, pipe.gapTop - 1) },
+			{ visible(lip, pipe.gapBottom + 1, bottomLipEnd), visible(body, bottomLipEnd + 1, groundTop - 1) }
+		};
+		for (const auto& halves : segments) {
+			Rectangle r;
+			bool any = false;
+			for (const auto& segment : halves) {
+				if (!nonEmpty(segment))
+					continue;
+				if (any)
+					r.expandTo(segment);
+				else
+					r = segment;
+				any = true;
+			}
+			if (any)
+				truth.pipes.emplace_back(r.left + offset.x, r.top + offset.y, r.right + offset.x, r.bottom + offset.y);
+		}
+	}
+
+	const Point spriteTopLeft(scene.bird.x - (1 + birdWidth / 2), scene.bird.y - (1 + birdHeight / 2));
+	blitBird(game, pitch, spriteTopLeft);
+
+	Rectangle bird(birdOpaque.left + spriteTopLeft.x, birdOpaque.top + spriteTopLeft.y,
+	               birdOpaque.right + spriteTopLeft.x, birdOpaque.bottom + spriteTopLeft.y);
+	bird.constrainBy(gameBounds);
+	truth.bird = Rectangle(bird.left + offset.x, bird.top + offset.y, bird.right + offset.x, bird.bottom + offset.y);
+	truth.beak = Point(beakOpaque.getCenterX() + spriteTopLeft.x + offset.x,
+	                   beakOpaque.getCenterY() + spriteTopLeft.y + offset.y);
+
+	if (scene.noise > 0)
+		addNoise(game, pitch, scene.noise);
+
+	return truth;
+}
+
+std::shared_ptr<VideoFrame> FrameSynthesizer::render(const SyntheticScene& scene, SyntheticTruth* truth)
+{
+	auto ret = make_shared<VideoFrame>(width, height, 3, false);
+	SyntheticTruth t = render(scene, *ret);
+	if (truth != nullptr)
+		*truth = std::move(t);
+	return ret;
+}
+
+SyntheticScene FrameSynthesizer::typicalScene(int scroll, int birdY) const
+{
+	SyntheticScene ret;
+	ret.bird = Point((int)width / 4, birdY);
+
+	// The first pipe starts just off the right edge of the screen when scroll is 0.
+	const int margin = lipHeight * 2;
+	const int gapRange = max(1, groundTop - 2 * margin - gapHeight);
+	const int overhang = lipOverhang + 1;
+
+	int k = max(0, (scroll - (int)width - pipeWidth - overhang) / pipeSpacing);
+	for (;; ++k) {
+		const int left = (int)width + k * pipeSpacing - scroll;
+		if (left - overhang >= (int)width)
+			break;
+		if (left + pipeWidth + overhang <= 0)
+			continue;
+
+		const int gapTop = margin + (int)(hashPosition((uint32_t)k) % (uint32_t)gapRange);
+		ret.pipes.emplace_back(left, gapTop, gapTop + gapHeight - 1);
+	}
+
+	return ret;
+}
+
+void FrameSynthesizer::blitPipeRows(uint8_t* game, size_t pitch, const vector<SpritePixel>& row, int left,
+                                    int top, int bottom)
+{
+	top = max(top, 0);
+	bottom = min(bottom, groundTop - 1);
+
+	const int first = max(0, -left);
+	const int last = min((int)row.size(), (int)width - left);
+	if (first >= last)
+		return;
+
+	for (int y = top; y <= bottom; ++y) {
+		uint8_t* pix = game + y * pitch + (left + first) * 3;
+		for (int i = first; i < last; ++i, pix += 3)
+			paint(pix, row[i].r, row[i].g, row[i].b, row[i].a);
+	}
+}
+
+void FrameSynthesizer::blitBird(uint8_t* game, size_t pitch, Point topLeft)
+{
+	const int firstX = max(0, -topLeft.x);
+	const int lastX = min(birdSpriteWidth, (int)width - topLeft.x);
+	const int firstY = max(0, -topLeft.y);
+	const int lastY = min(birdSpriteHeight, (int)height - topLeft.y);
+
+	for (int y = firstY; y < lastY; ++y) {
+		const SpritePixel* sp = &birdSprite[y * birdSpriteWidth + firstX];
+		uint8_t* pix = game + (topLeft.y + y) * pitch + (topLeft.x + firstX) * 3;
+		for (int x = firstX; x < lastX; ++x, ++sp, pix += 3)
+			paint(pix, sp->r, sp->g, sp->b, sp->a);
+	}
+}
+
+void FrameSynthesizer::addNoise(uint8_t* game, size_t pitch, int amount)
+{
+	const size_t rowBytes = width * 3;
+
+	if (amount != scaledNoiseAmount) {
+		// The table is padded by a row so that a row starting anywhere in the first noiseTableSize entries
+		// never has to wrap around.
+		scaledNoise.resize(noiseTableSize + rowBytes);
+		for (size_t i = 0; i < scaledNoise.size(); ++i)
+			scaledNoise[i] = (int16_t)((int)noiseTable[i % noiseTableSize] * amount / 127);
+		scaledNoiseAmount = amount;
+	}
+
+	for (size_t y = 0; y < height; ++y) {
+		// Start each row at a random spot in the table so rows don't repeat
+		const int16_t* n = &scaledNoise[nextRandom() % noiseTableSize];
+		uint8_t* pix = game + y * pitch;
+		for (size_t i = 0; i < rowBytes; ++i) {
+			const int v = (int)pix[i] + (int)n[i];
+			pix[i] = (uint8_t)min(255, max(0, v));
+		}
+	}
+}
+
+uint32_t FrameSynthesizer::nextRandom()
+{
+	// xorshift32
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 17;
+	rngState ^= rngState << 5;
+	return rngState;
+}
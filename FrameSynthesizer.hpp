@@ -0,0 +1,156 @@
+#ifndef __FRAME_SYNTHESIZER_HPP__
+#define __FRAME_SYNTHESIZER_HPP__
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Rectangle.hpp"
+#include "VideoFrame.hpp"
+
+/// A pipe pair in a synthetic scene
+struct SyntheticPipe {
+	SyntheticPipe(int l, int gt, int gb) : left(l), gapTop(gt), gapBottom(gb) { }
+
+	int left; ///< The left edge of the pipe's body (the lips stick out a bit further)
+	int gapTop; ///< The first row of the gap between the pipes
+	int gapBottom; ///< The last row of the gap between the pipes
+};
+
+/// Everything that varies from one synthetic frame to the next
+struct SyntheticScene {
+	Point bird = Point(0, 0); ///< The center of the bird's body
+	std::vector<SyntheticPipe> pipes;
+	int noise = 0; ///< Each channel of each pixel is perturbed by up to this much, in either direction
+	bool gameOver = false; ///< Paint the white flash shown when the bird dies
+};
+
+/// Where things were drawn in a synthetic frame, in the frame's coordinates
+struct SyntheticTruth {
+	Rectangle gameRect; ///< What findGameWindow should find
+	Rectangle bird; ///< The bird, including its beak
+	Point beak = Point(0, 0); ///< The center of the beak
+	Rectangle floor; ///< The striped band at the top of the ground, which findPipes reports as an obstacle
+	std::vector<Rectangle> pipes; ///< Each pipe (two per pair), lips included
+};
+
+/**
+ * \brief Renders Flappy Bird frames with known contents
+ *
+ * Frames are painted with the palette from FlappyColors.hpp, so they can feed benchmarks and accuracy checks
+ * of FlappySearches without a browser. The static background, pipe rows, and bird sprite are built once per
+ * synthesizer and blitted a row at a time, so rendering runs at thousands of frames per second.
+ */
+class FrameSynthesizer {
+
+public:
+
+	/**
+	 * \brief Creates a synthesizer for a game of the given size
+	 * \param w Width of the game
+	 * \param h Height of the game
+	 * \param antiAlias true to blend the edges of the bird and the pipes into the sky
+	 * \param seed Seed for the noise generator, so that noisy runs are repeatable
+	 */
+	FrameSynthesizer(size_t w, size_t h, bool antiAlias = false, uint32_t seed = 1);
+
+	/**
+	 * \brief Renders a scene into an existing frame
+	 * \param scene What to draw
+	 * \param frame The frame to draw into. It must be at least as large as the game plus the offset.
+	 * \param offset Where the top-left of the game goes in the frame, e.g. to simulate a game on a larger desktop
+	 * \returns Where everything was drawn, in frame coordinates
+	 */
+	SyntheticTruth render(const SyntheticScene& scene, VideoFrame& frame, Point offset = Point(0, 0));
+
+	/// Renders a scene into a new game-sized frame, optionally returning where everything was drawn
+	std::shared_ptr<VideoFrame> render(const SyntheticScene& scene, SyntheticTruth* truth = nullptr);
+
+	/**
+	 * \brief Makes a typical scene: the bird a quarter of the way across, with evenly spaced pipes
+	 * \param scroll How far (in pixels) the course has scrolled. Gap heights are a function of the pipe's
+	 *               position on the course, so the same scroll always produces the same scene.
+	 * \param birdY The vertical center of the bird
+	 */
+	SyntheticScene typicalScene(int scroll, int birdY) const;
+
+	size_t getWidth() const { return width; }
+
+	size_t getHeight() const { return height; }
+
+	/// The first row of the ground. Pipes end just above it.
+	int getGroundTop() const { return groundTop; }
+
+	/// The width of a pipe's body, lips excluded
+	int getPipeWidth() const { return pipeWidth; }
+
+	/// How far a pipe's lip sticks out from its body, on each side
+	int getLipOverhang() const { return lipOverhang; }
+
+	/// The vertical size of a gap in typicalScene
+	int getGapHeight() const { return gapHeight; }
+
+	/// The horizontal distance between pipes in typicalScene
+	int getPipeSpacing() const { return pipeSpacing; }
+
+	/// The size of the bird's body (its beak sticks out to the right of this)
+	int getBirdWidth() const { return birdWidth; }
+	int getBirdHeight() const { return birdHeight; }
+
+private:
+
+	/// A pixel of a sprite or pattern. Alpha is 0 (transparent), 128 (anti-aliased edge), or 255 (opaque).
+	struct SpritePixel {
+		uint8_t r, g, b, a;
+	};
+
+	void buildBackground();
+
+	void buildPipeRows();
+
+	void buildBird();
+
+	/// Paints a pipe row pattern over rows [top, bottom] of the game, clipped to the game
+	void blitPipeRows(uint8_t* game, size_t pitch, const std::vector<SpritePixel>& row, int left,
+	                  int top, int bottom);
+
+	void blitBird(uint8_t* game, size_t pitch, Point topLeft);
+
+	void addNoise(uint8_t* game, size_t pitch, int amount);
+
+	uint32_t nextRandom();
+
+	const size_t width;
+	const size_t height;
+	const bool antiAlias;
+
+	int groundTop;
+	int groundStripeTop;
+	int groundTanTop;
+	int pipeWidth;
+	int lipOverhang;
+	int lipHeight;
+	int gapHeight;
+	int pipeSpacing;
+	int birdWidth;
+	int birdHeight;
+	int beakWidth;
+	int beakHeight;
+
+	std::vector<uint8_t> background; ///< The sky and ground, packed RGB, one game's worth
+	std::vector<SpritePixel> pipeBodyRow; ///< One row of a pipe body, plus an anti-aliased column on each side
+	std::vector<SpritePixel> pipeLipRow; ///< One row of a pipe lip, plus an anti-aliased column on each side
+
+	std::vector<SpritePixel> birdSprite; ///< Bird body and beak, with a one pixel margin for anti-aliasing
+	int birdSpriteWidth;
+	int birdSpriteHeight;
+	Rectangle birdOpaque; ///< The opaque part of the bird, relative to its sprite
+	Rectangle beakOpaque; ///< The beak, relative to the bird's sprite
+
+	std::vector<int8_t> noiseTable; ///< Uniform noise in [-127, 127]
+	std::vector<int16_t> scaledNoise; ///< noiseTable scaled to the last amount of noise asked for
+	int scaledNoiseAmount;
+	uint32_t rngState;
+};
+
+#endif
@@ -0,0 +1,323 @@
+#include "HSVConversion.hpp"
+
+#include <algorithm>
+#include <array>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HSV_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+#include "MKMath.hpp"
+
+using namespace std;
+
+namespace {
+
+void rgb2hsvReference(const uint8_t* src, uint8_t* dst, size_t count)
+{
+	using namespace Math;
+
+	for (const uint8_t* end = src + count * 3; src < end; src += 3, dst += 3) {
+		float r = (float)src[0] / 255.0f;
+		float g = (float)src[1] / 255.0f;
+		float b = (float)src[2] / 255.0f;
+
+		float cmax = std::max({r, g, b});
+		float cmin = std::min({r, g, b});
+		float delta = cmax - cmin;
+
+		float h;
+		if (isZero(delta))
+			h = 0; // Otherwise we divide zero by zero below
+		else if (cmax == r)
+			h = 60.0f * (g - b)/delta;
+		else if (cmax == g)
+			h = 60.0f * ((b - r)/delta + 2);
+		else
+			h = 60.0f * ((r -g)/delta + 4);
+
+		while (h < 0.0f)
+			h += 360.0f;
+		while (h > 360.0f)
+			h -= 360.0f;
+
+		float s;
+		// Should use ulps, but we'll live for now
+		if (isZero(delta))
+			s = 0;
+		else
+			s = delta / cmax;
+
+		float v = cmax;
+
+		dst[0] = (uint8_t)(h / 360.0f * 255.0f);
+		dst[1] = (uint8_t)(s * 255.0f);
+		dst[2] = (uint8_t)(v * 255.0f);
+	}
+}
+
+/// 2^32 / n, rounded up, so that (x * table[n]) >> 32 == x / n for the ranges we use
+struct ReciprocalTable {
+	ReciprocalTable()
+	{
+		recip[0] = 0;
+		recip32[0] = recip32[1] = 0;
+		for (uint64_t n = 1; n < recip.size(); ++n) {
+			recip[n] = ((1ULL << 32) + n - 1) / n;
+			if (n > 1)
+				recip32[n] = (uint32_t)recip[n];
+		}
+	}
+
+	// Hue divides by six times the largest possible delta
+	array<uint64_t, 6 * 255 + 1> recip;
+
+	/// The same, for n > 1 where they fit in 32 bits, for the SIMD kernels' 32-bit lanes (0 below that)
+	array<uint32_t, 6 * 255 + 1> recip32;
+};
+
+const ReciprocalTable reciprocals;
+
+inline uint32_t divide(uint32_t x, uint32_t n) { return (uint32_t)((x * reciprocals.recip[n]) >> 32); }
+
+void rgb2hsvScalar(const uint8_t* src, uint8_t* dst, size_t count)
+{
+	for (const uint8_t* end = src + count * 3; src < end; src += 3, dst += 3) {
+		const int r = src[0];
+		const int g = src[1];
+		const int b = src[2];
+
+		const int cmax = max(r, max(g, b));
+		const int cmin = min(r, min(g, b));
+		const int delta = cmax - cmin;
+
+		// Hue in sixths of a circle, scaled by delta: [0, 6 * delta)
+		int h;
+		if (cmax == r)
+			h = g - b;
+		else if (cmax == g)
+			h = b - r + 2 * delta;
+		else
+			h = r - g + 4 * delta;
+		if (h < 0)
+			h += 6 * delta;
+
+		dst[0] = (uint8_t)(delta == 0 ? 0 : divide((uint32_t)h * 255, (uint32_t)(6 * delta)));
+		dst[1] = (uint8_t)(delta == 0 ? 0 : divide((uint32_t)delta * 255, (uint32_t)cmax));
+		dst[2] = (uint8_t)cmax;
+	}
+}
+
+#ifdef HSV_HAVE_X86
+
+// The SIMD kernels convert eight pixels at a time: shuffle 24 bytes of RGB into a register per channel,
+// widen those to integer lanes, do rgb2hsvScalar's math with selects standing in for its branches,
+// then shuffle the results back into 24 bytes of HSV. They divide the same way rgb2hsvScalar does,
+// by multiplying by a reciprocal from the table and keeping the high 32 bits, so they match it exactly.
+// Saturation divides delta * 510 by 2 * cmax rather than delta * 255 by cmax, since 2^32 / 1 doesn't fit a lane.
+// Each group of eight is read completely before it is written, so converting in place is fine.
+// Whatever doesn't fill a group at the end of the row goes through rgb2hsvScalar.
+
+/// Splits eight packed RGB pixels into the low eight bytes of r, g, and b
+__attribute__((target("ssse3"), always_inline))
+inline void load8(const uint8_t* src, __m128i& r, __m128i& g, __m128i& b)
+{
+	const __m128i lo = _mm_loadu_si128((const __m128i*)src);
+	const __m128i hi = _mm_loadl_epi64((const __m128i*)(src + 16));
+
+	r = _mm_or_si128(_mm_shuffle_epi8(lo, _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+	                 _mm_shuffle_epi8(hi, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, -1, -1, -1, -1, -1, -1, -1, -1)));
+	g = _mm_or_si128(_mm_shuffle_epi8(lo, _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+	                 _mm_shuffle_epi8(hi, _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, -1, -1, -1, -1, -1, -1, -1, -1)));
+	b = _mm_or_si128(_mm_shuffle_epi8(lo, _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+	                 _mm_shuffle_epi8(hi, _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, -1, -1, -1, -1, -1, -1, -1, -1)));
+}
+
+/// Packs the low eight bytes of h, s, and v into 24 bytes of HSV pixels
+__attribute__((target("ssse3"), always_inline))
+inline void store8(uint8_t* dst, __m128i h, __m128i s, __m128i v)
+{
+	// hs holds h0..h7 then s0..s7
+	const __m128i hs = _mm_unpacklo_epi64(h, s);
+	const __m128i lo = _mm_or_si128(
+		_mm_shuffle_epi8(hs, _mm_setr_epi8(0, 8, -1, 1, 9, -1, 2, 10, -1, 3, 11, -1, 4, 12, -1, 5)),
+		_mm_shuffle_epi8(v, _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1)));
+	const __m128i hi = _mm_or_si128(
+		_mm_shuffle_epi8(hs, _mm_setr_epi8(13, -1, 6, 14, -1, 7, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+		_mm_shuffle_epi8(v, _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, -1, -1, -1, -1, -1, -1)));
+	_mm_storeu_si128((__m128i*)dst, lo);
+	_mm_storel_epi64((__m128i*)(dst + 16), hi);
+}
+
+// Lambdas don't inherit their enclosing function's target attribute, so these small helpers are functions.
+
+/// The high 32 bits of each unsigned 32-bit lane of x times the same lane of recip, i.e. x / n for recip from the table
+inline __m128i mulHigh(__m128i x, __m128i recip)
+{
+	const __m128i even = _mm_mul_epu32(x, recip);
+	const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(x, 32), _mm_srli_epi64(recip, 32));
+	return _mm_or_si128(_mm_srli_epi64(even, 32), _mm_and_si128(odd, _mm_setr_epi32(0, -1, 0, -1)));
+}
+
+/// Looks up the reciprocals of four 16-bit divisors
+inline __m128i reciprocals4(const uint16_t* n)
+{
+	const uint32_t* table = reciprocals.recip32.data();
+	return _mm_setr_epi32((int)table[n[0]], (int)table[n[1]], (int)table[n[2]], (int)table[n[3]]);
+}
+
+/// Divides eight 16-bit lanes of x (scaled by mul, which leaves them below 2^20) by eight 16-bit lanes of n
+inline __m128i divide8(__m128i x, int mul, __m128i n)
+{
+	alignas(16) uint16_t divisors[8];
+	_mm_store_si128((__m128i*)divisors, n);
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i scale = _mm_set1_epi16((short)mul);
+	// x * mul, widened to 32 bits from the low and high halves of the product
+	const __m128i productLo = _mm_mullo_epi16(x, scale);
+	const __m128i productHi = _mm_mulhi_epu16(x, scale);
+	const __m128i lo = mulHigh(_mm_unpacklo_epi16(productLo, productHi), reciprocals4(divisors));
+	const __m128i hi = mulHigh(_mm_unpackhi_epi16(productLo, productHi), reciprocals4(divisors + 4));
+	return _mm_packus_epi16(_mm_packs_epi32(lo, hi), zero);
+}
+
+/// The high 32 bits of each unsigned 32-bit lane of x times the same lane of recip
+__attribute__((target("avx2"), always_inline))
+inline __m256i mulHigh(__m256i x, __m256i recip)
+{
+	const __m256i even = _mm256_mul_epu32(x, recip);
+	const __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), _mm256_srli_epi64(recip, 32));
+	return _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xaa);
+}
+
+/// Narrows eight int lanes (all in [0, 255]) to the low eight bytes of a register
+__attribute__((target("avx2"), always_inline))
+inline __m128i narrow(__m256i x)
+{
+	const __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+	return _mm_packus_epi16(words, _mm_setzero_si128());
+}
+
+__attribute__((target("ssse3")))
+void rgb2hsvSSSE3(const uint8_t* src, uint8_t* dst, size_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; count >= 8; count -= 8, src += 24, dst += 24) {
+		__m128i rb, gb, bb;
+		load8(src, rb, gb, bb);
+		// Every pixel in a 16-bit lane, where hue (in [-255, 6 * 255]) fits too
+		const __m128i r = _mm_unpacklo_epi8(rb, zero);
+		const __m128i g = _mm_unpacklo_epi8(gb, zero);
+		const __m128i b = _mm_unpacklo_epi8(bb, zero);
+
+		const __m128i cmax = _mm_max_epi16(r, _mm_max_epi16(g, b));
+		const __m128i cmin = _mm_min_epi16(r, _mm_min_epi16(g, b));
+		const __m128i delta = _mm_sub_epi16(cmax, cmin);
+
+		const __m128i isR = _mm_cmpeq_epi16(cmax, r);
+		const __m128i isG = _mm_andnot_si128(isR, _mm_cmpeq_epi16(cmax, g));
+		const __m128i isB = _mm_andnot_si128(_mm_or_si128(isR, isG), _mm_cmpeq_epi16(cmax, cmax));
+
+		const __m128i hr = _mm_sub_epi16(g, b);
+		const __m128i hg = _mm_add_epi16(_mm_sub_epi16(b, r), _mm_slli_epi16(delta, 1));
+		const __m128i hb = _mm_add_epi16(_mm_sub_epi16(r, g), _mm_slli_epi16(delta, 2));
+		__m128i h = _mm_or_si128(_mm_and_si128(isR, hr), _mm_or_si128(_mm_and_si128(isG, hg), _mm_and_si128(isB, hb)));
+		const __m128i sixDelta = _mm_mullo_epi16(delta, _mm_set1_epi16(6));
+		h = _mm_add_epi16(h, _mm_and_si128(_mm_cmplt_epi16(h, zero), sixDelta));
+
+		// Grays divide by zero, whose reciprocal in the table is zero, so they come out zero
+		store8(dst, divide8(h, 255, sixDelta), divide8(delta, 510, _mm_slli_epi16(cmax, 1)),
+		       _mm_packus_epi16(cmax, zero));
+	}
+
+	rgb2hsvScalar(src, dst, count);
+}
+
+__attribute__((target("avx2")))
+void rgb2hsvAVX2(const uint8_t* src, uint8_t* dst, size_t count)
+{
+	const int* table = (const int*)reciprocals.recip32.data();
+	const __m256i zero = _mm256_setzero_si256();
+
+	for (; count >= 8; count -= 8, src += 24, dst += 24) {
+		__m128i rb, gb, bb;
+		load8(src, rb, gb, bb);
+		const __m256i r = _mm256_cvtepu8_epi32(rb);
+		const __m256i g = _mm256_cvtepu8_epi32(gb);
+		const __m256i b = _mm256_cvtepu8_epi32(bb);
+
+		const __m256i cmax = _mm256_max_epi32(r, _mm256_max_epi32(g, b));
+		const __m256i cmin = _mm256_min_epi32(r, _mm256_min_epi32(g, b));
+		const __m256i delta = _mm256_sub_epi32(cmax, cmin);
+
+		const __m256i isR = _mm256_cmpeq_epi32(cmax, r);
+		const __m256i isG = _mm256_cmpeq_epi32(cmax, g);
+
+		const __m256i hr = _mm256_sub_epi32(g, b);
+		const __m256i hg = _mm256_add_epi32(_mm256_sub_epi32(b, r), _mm256_slli_epi32(delta, 1));
+		const __m256i hb = _mm256_add_epi32(_mm256_sub_epi32(r, g), _mm256_slli_epi32(delta, 2));
+		__m256i h = _mm256_blendv_epi8(_mm256_blendv_epi8(hb, hg, isG), hr, isR);
+		const __m256i sixDelta = _mm256_add_epi32(_mm256_slli_epi32(delta, 2), _mm256_slli_epi32(delta, 1));
+		h = _mm256_add_epi32(h, _mm256_and_si256(_mm256_cmpgt_epi32(zero, h), sixDelta));
+
+		// x * 255 is (x << 8) - x. Grays divide by zero, whose reciprocal in the table is zero.
+		const __m256i hue = mulHigh(_mm256_sub_epi32(_mm256_slli_epi32(h, 8), h),
+		                            _mm256_i32gather_epi32(table, sixDelta, 4));
+		const __m256i sat = mulHigh(_mm256_slli_epi32(_mm256_sub_epi32(_mm256_slli_epi32(delta, 8), delta), 1),
+		                            _mm256_i32gather_epi32(table, _mm256_slli_epi32(cmax, 1), 4));
+
+		store8(dst, narrow(hue), narrow(sat), narrow(cmax));
+	}
+
+	rgb2hsvScalar(src, dst, count);
+}
+
+#endif // HSV_HAVE_X86
+
+} // end anonymous namespace
+
+HSVRowFunction getHSVKernel(HSVKernel kernel)
+{
+	switch (kernel) {
+		case HK_REFERENCE:
+			return &rgb2hsvReference;
+		case HK_SCALAR:
+			return &rgb2hsvScalar;
+#ifdef HSV_HAVE_X86
+		case HK_SSSE3:
+			return __builtin_cpu_supports("ssse3") ? &rgb2hsvSSSE3 : nullptr;
+		case HK_AVX2:
+			return __builtin_cpu_supports("avx2") ? &rgb2hsvAVX2 : nullptr;
+#endif
+		default:
+			return nullptr;
+	}
+}
+
+HSVKernel getBestHSVKernel()
+{
+	static const HSVKernel best = getHSVKernel(HK_AVX2) != nullptr ? HK_AVX2
+	                            : getHSVKernel(HK_SSSE3) != nullptr ? HK_SSSE3
+	                            : HK_SCALAR;
+	return best;
+}
+
+void rgb2hsvRow(const uint8_t* src, uint8_t* dst, size_t count)
+{
+	static const HSVRowFunction best = getHSVKernel(getBestHSVKernel());
+	best(src, dst, count);
+}
+
+const char* getHSVKernelName(HSVKernel kernel)
+{
+	switch (kernel) {
+		case HK_REFERENCE: return "reference";
+		case HK_SCALAR: return "scalar";
+		case HK_SSSE3: return "ssse3";
+		case HK_AVX2: return "avx2";
+	}
+	return "unknown";
+}
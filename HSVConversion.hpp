@@ -0,0 +1,45 @@
+#ifndef __HSV_CONVERSION_HPP__
+#define __HSV_CONVERSION_HPP__
+
+/**
+ * \file HSVConversion.hpp
+ *
+ * Row-at-a-time RGB to HSV conversion. Each output channel is scaled to [0, 255]:
+ * hue is degrees * 255 / 360, saturation and value are fractions of 255.
+ * Grays (where saturation is zero) get a hue of zero.
+ *
+ * Several implementations are available so they can be checked against each other.
+ * rgb2hsvRow picks the fastest one the CPU supports the first time it is called.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+/// The available RGB to HSV kernels
+enum HSVKernel {
+	HK_REFERENCE, ///< The original floating point code. Slow, but what the others are checked against.
+	HK_SCALAR, ///< Integer arithmetic with a reciprocal table instead of division
+	HK_SSSE3, ///< The scalar kernel's math eight pixels at a time, with byte shuffles to split out the channels
+	HK_AVX2 ///< The same in 32-bit lanes, with the reciprocals gathered from the table
+};
+
+/**
+ * \brief Converts packed 24-bit RGB pixels to packed 24-bit HSV
+ * \param src The pixels to convert
+ * \param dst Where to write the converted pixels. This may be the same as src, but may not otherwise overlap it.
+ * \param count The number of pixels to convert
+ */
+typedef void (*HSVRowFunction)(const uint8_t* src, uint8_t* dst, size_t count);
+
+/// Converts a row of pixels using the fastest kernel this CPU supports. See HSVRowFunction.
+void rgb2hsvRow(const uint8_t* src, uint8_t* dst, size_t count);
+
+/// Returns a given kernel, or nullptr if this CPU (or build) doesn't support it
+HSVRowFunction getHSVKernel(HSVKernel kernel);
+
+/// Returns the kernel rgb2hsvRow uses
+HSVKernel getBestHSVKernel();
+
+const char* getHSVKernelName(HSVKernel kernel);
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef __LATENCY_HISTOGRAM_HPP__
+#define __LATENCY_HISTOGRAM_HPP__
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * \brief A log-linear (HDR-style) histogram of durations, in nanoseconds
+ *
+ * Each power of two is split into 16 buckets, so any recorded value is known to within about 6%.
+ * Recording is a pair of relaxed atomic operations with no locking, meant for a single writing thread.
+ * Any other thread can take a snapshot at any time and compute percentiles from it.
+ */
+class LatencyHistogram {
+
+public:
+
+	static const int subBucketBits = 4;
+	static const int subBuckets = 1 << subBucketBits;
+	/// Enough buckets to hold any 64-bit value
+	static const int bucketCount = (64 - subBucketBits + 1) * subBuckets;
+
+	/// A copy of the histogram's counts at some point in time
+	struct Snapshot {
+		std::array<uint64_t, bucketCount> counts;
+		uint64_t total;
+
+		/// Returns the (approximate) value below which the given fraction of samples fall, or 0 if there are none
+		uint64_t valueAtQuantile(double q) const
+		{
+			if (total == 0)
+				return 0;
+
+			const uint64_t rank = q >= 1.0 ? total : (uint64_t)(q * (double)total) + 1;
+			uint64_t seen = 0;
+			for (int i = 0; i < bucketCount; ++i) {
+				seen += counts[i];
+				if (seen >= rank)
+					return highestValueIn(i);
+			}
+			return highestValueIn(bucketCount - 1);
+		}
+
+		uint64_t max() const { return valueAtQuantile(1.0); }
+
+		/// Gets the samples recorded between an earlier snapshot and this one
+		Snapshot since(const Snapshot& earlier) const
+		{
+			Snapshot ret;
+			for (int i = 0; i < bucketCount; ++i)
+				ret.counts[i] = counts[i] - earlier.counts[i];
+			ret.total = total - earlier.total;
+			return ret;
+		}
+	};
+
+	LatencyHistogram()
+	{
+		for (auto& c : counts)
+			c.store(0, std::memory_order_relaxed);
+	}
+
+	/// Records a value. Only one thread should record into a given histogram.
+	void record(uint64_t nanoseconds)
+	{
+		auto& c = counts[indexOf(nanoseconds)];
+		// With a single writer, a load and store is enough, and avoids a locked read-modify-write.
+		c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	/// Copies the current counts. Safe to call from any thread.
+	Snapshot snapshot() const
+	{
+		Snapshot ret;
+		ret.total = 0;
+		for (int i = 0; i < bucketCount; ++i) {
+			ret.counts[i] = counts[i].load(std::memory_order_relaxed);
+			ret.total += ret.counts[i];
+		}
+		return ret;
+	}
+
+	static int indexOf(uint64_t value)
+	{
+		if (value < (uint64_t)subBuckets)
+			return (int)value;
+
+		const int exponent = 63 - __builtin_clzll(value);
+		const int shift = exponent - subBucketBits;
+		return (shift + 1) * subBuckets + (int)((value >> shift) & (subBuckets - 1));
+	}
+
+	static uint64_t highestValueIn(int index)
+	{
+		if (index < subBuckets)
+			return (uint64_t)index;
+
+		const int shift = index / subBuckets - 1;
+		const uint64_t lowest = (uint64_t)(subBuckets + index % subBuckets) << shift;
+		return lowest + ((uint64_t)1 << shift) - 1;
+	}
+
+	LatencyHistogram(const LatencyHistogram&) = delete;
+	LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+private:
+
+	std::array<std::atomic<uint64_t>, bucketCount> counts;
+};
+
+#endif
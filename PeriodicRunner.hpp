@@ -2,32 +2,38 @@
 #define __PERIODIC_RUNNER_HPP__
 
 #include <chrono>
+#include <mutex>
+
+#include "TimeSource.hpp"
 
 template <typename T = std::chrono::seconds>
 class PeriodicRunner {
 
 public:
 
+	/**
+	 * \param dur How often to run
+	 * \param clk What to measure that with
+	 */
 	template <typename C>
-	PeriodicRunner(C dur) : duration(dur) { }
+	PeriodicRunner(C dur, const TimeSource& clk = TimeSource::steady()) : clock(clk), duration(dur) { }
 
 	template <typename R>
 	void runPeriodically(R toRun)
 	{
 		std::lock_guard<std::mutex> lg(runMutex);
-		if (Clock::now() >= lastRan + duration)
+		if (clock.now() >= lastRan + duration)
 		{
 			toRun();
-			lastRan = Clock::now();
+			lastRan = clock.now();
 		}
 	}
 
 
 private:
 
-	typedef std::chrono::high_resolution_clock Clock;
-
-	Clock::time_point lastRan;
+	const TimeSource& clock;
+	TimeSource::TimePoint lastRan;
 	std::mutex runMutex;
 	T duration;
 };
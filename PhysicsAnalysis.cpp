@@ -1,7 +1,18 @@
 #include "PhysicsAnalysis.hpp"
 
+#include <algorithm>
+
 #include "Exceptions.hpp"
 
+// Each log briefly holds maxSamples entries before logPosition trims it back down
+PhysicsAnalysis::PhysicsAnalysis(size_t samplesToAverage, const TimeSource& clock)
+	: positionLog(std::max<size_t>(samplesToAverage, 1)),
+	  velocityLog(std::max<size_t>(samplesToAverage, 1)),
+	  accelLog(std::max<size_t>(samplesToAverage, 1)),
+	  maxSamples(samplesToAverage),
+	  clock(clock)
+{ }
+
 void PhysicsAnalysis::reset()
 {
 	positionLog.clear();
@@ -16,7 +27,10 @@ void PhysicsAnalysis::logPosition(int pos)
 		std::chrono::treat_as_floating_point<FloatingSeconds::rep>::value, "Rep required to be floating point"
 	);
 
-	positionLog.emplace_front(pos);
+	// One reading for the position and what's derived from it
+	const TimeSource::TimePoint time = clock.now();
+
+	positionLog.pushFront(Entry((float)pos, time));
 
 	if (positionLog.size() >= 2) {
 		const Entry& now = positionLog[0];
@@ -24,7 +38,7 @@ void PhysicsAnalysis::logPosition(int pos)
 		const float dt = FloatingSeconds(now.time - then.time).count(); // in seconds
 		// dx is a height value, but we want to preserve the traditional dx/dt notation
 		const float dx = now.val - then.val;
-		velocityLog.emplace_front(dx/dt); // pixels/second
+		velocityLog.pushFront(Entry(dx/dt, time)); // pixels/second
 	}
 	if (velocityLog.size() >= 2)
 	{
@@ -32,15 +46,15 @@ void PhysicsAnalysis::logPosition(int pos)
 		const Entry& then = velocityLog[1];
 		const float dt2 = FloatingSeconds(now.time - then.time).count(); // in seconds^2
 		const float d2x = now.val - then.val;
-		accelLog.emplace_front(d2x/dt2);
+		accelLog.pushFront(Entry(d2x/dt2, time));
 	}
 
 	while (positionLog.size() >= maxSamples)
-		positionLog.pop_back();
+		positionLog.popBack();
 	while (velocityLog.size() >= maxSamples)
-		velocityLog.pop_back();
+		velocityLog.popBack();
 	while (accelLog.size() >= maxSamples)
-		accelLog.pop_back();
+		accelLog.popBack();
 }
 
 float PhysicsAnalysis::getAveragePosition() const
@@ -50,11 +64,7 @@ float PhysicsAnalysis::getAveragePosition() const
 		                                           __FUNCTION__);
 	}
 
-	float loc = 0;
-	for (const auto& e : positionLog)
-		loc += e.val;
-	loc /= positionLog.size();
-	return loc;
+	return average(positionLog);
 }
 
 float PhysicsAnalysis::getAverageVelocity() const
@@ -64,11 +74,7 @@ float PhysicsAnalysis::getAverageVelocity() const
 		                                           __FUNCTION__);
 	}
 
-	float vel = 0;
-	for (const auto& e : velocityLog)
-		vel += e.val;
-	vel /= velocityLog.size();
-	return vel;
+	return average(velocityLog);
 }
 
 float PhysicsAnalysis::getAverageAcceleration() const
@@ -78,10 +84,13 @@ float PhysicsAnalysis::getAverageAcceleration() const
 		                                           __FUNCTION__);
 	}
 
-	float accel = 0;
-	for (const auto& e : accelLog)
-		accel += e.val;
-	accel /= accelLog.size();
-	return accel;
+	return average(accelLog);
 }
 
+float PhysicsAnalysis::average(const Log& log)
+{
+	float sum = 0;
+	for (size_t i = 0; i < log.size(); ++i)
+		sum += log[i].val;
+	return sum / log.size();
+}
@@ -2,13 +2,20 @@
 #define __PHYSICS_ANALYSIS_HPP__
 
 #include <chrono>
-#include <deque>
+#include <cstddef>
+#include <vector>
+
+#include "TimeSource.hpp"
 
 class PhysicsAnalysis {
 
 public:
 
-	PhysicsAnalysis(size_t samplesToAverage) : maxSamples(samplesToAverage) { }
+	/**
+	 * \param samplesToAverage How many of the latest samples each average is over
+	 * \param clock Where the time each position was logged at comes from
+	 */
+	explicit PhysicsAnalysis(size_t samplesToAverage, const TimeSource& clock = TimeSource::steady());
 
 	void reset();
 
@@ -33,21 +40,58 @@ public:
 
 private:
 
-	typedef std::chrono::high_resolution_clock Clock;
-
 	struct Entry {
-		Entry(float v) : val(v), time(Clock::now()) { }
+		Entry() = default;
+
+		Entry(float v, TimeSource::TimePoint t) : val(v), time(t) { }
+
+		float val;
+		TimeSource::TimePoint time;
+	};
+
+	/// The latest entries, newest first, in a fixed amount of memory so logging never allocates
+	class Log {
+
+	public:
+
+		explicit Log(size_t capacity) : entries(capacity) { }
 
-		const float val;
-		const Clock::time_point time;
+		/// Adds an entry as the newest, dropping the oldest if there's no room
+		void pushFront(const Entry& e)
+		{
+			first = (first + entries.size() - 1) % entries.size();
+			entries[first] = e;
+			if (count < entries.size())
+				++count;
+		}
+
+		void popBack() { --count; }
+
+		/// The i-th newest entry
+		const Entry& operator[](size_t i) const { return entries[(first + i) % entries.size()]; }
+
+		size_t size() const { return count; }
+
+		bool empty() const { return count == 0; }
+
+		void clear() { count = 0; }
+
+	private:
+
+		std::vector<Entry> entries;
+		size_t first = 0;
+		size_t count = 0;
 	};
 
-	// Should replace with a circular buffer
-	std::deque<Entry> positionLog;
-	std::deque<Entry> velocityLog;
-	std::deque<Entry> accelLog;
+	/// Averages the values in a log
+	static float average(const Log& log);
+
+	Log positionLog;
+	Log velocityLog;
+	Log accelLog;
 
 	const size_t maxSamples;
+	const TimeSource& clock;
 
 };
 
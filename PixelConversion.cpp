@@ -0,0 +1,26 @@
+#include "PixelConversion.hpp"
+
+#include "VideoFrame.hpp"
+
+void xPixelsToRGB(const uint8_t* src, size_t srcPitch, const Rectangle& from, VideoFrame& dst)
+{
+	if (dst.getDepth() != 3)
+		throw Exceptions::ArgumentException("The frame must be 24-bit RGB", __FUNCTION__);
+
+	if (from.getWidth() != (int)dst.getWidth() || from.getHeight() != (int)dst.getHeight())
+		throw Exceptions::ArgumentException("The source rectangle and frame must be the same size", __FUNCTION__);
+
+	const size_t step = dst.getBytesPerPixel();
+
+	for (int y = from.top; y <= from.bottom; ++y) {
+		const uint32_t* line_ptr = (const uint32_t*) &src[y * srcPitch];
+		uint8_t* curr = dst.getPixel(0, (size_t)(y - from.top));
+		for (int x = from.left; x <= from.right; ++x) {
+			uint32_t pixelvalue = line_ptr[x];
+			curr[0] = (uint8_t)((pixelvalue & 0x00FF0000) >> 16);
+			curr[1] = (uint8_t)((pixelvalue & 0x0000FF00) >> 8);
+			curr[2] = (uint8_t)((pixelvalue & 0x000000FF));
+			curr += step;
+		}
+	}
+}
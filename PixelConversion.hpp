@@ -0,0 +1,22 @@
+#ifndef __PIXEL_CONVERSION_HPP__
+#define __PIXEL_CONVERSION_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Rectangle.hpp"
+
+class VideoFrame;
+
+/**
+ * \brief Converts 32-bit padded pixels (as handed to us by X11) to a 24-bit RGB frame
+ * \param src The first line of the source image
+ * \param srcPitch The number of bytes between the start of each source line
+ * \param from The portion of the source to convert. It must be the same size as dst.
+ * \param dst The frame to write into, in any layout. The padding of padded pixels is left alone.
+ *
+ * This lives outside of X11ScreenIO so that it can be benchmarked without an X server.
+ */
+void xPixelsToRGB(const uint8_t* src, size_t srcPitch, const Rectangle& from, VideoFrame& dst);
+
+#endif
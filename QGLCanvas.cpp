@@ -1,26 +1,43 @@
 #include <QCoreApplication>
 
 #include "QGLCanvas.hpp"
+#include "Trace.hpp"
 
 using namespace std;
 
 QGLCanvas::QGLCanvas(QWidget* parent)
 	: QGLWidget(parent), paintMessageSent(false)
 {
+	// We're created on the GUI thread, which is also where painting happens
+	Trace::setThreadName("gui");
 }
 
 void QGLCanvas::setFrame(const std::shared_ptr<VideoFrame>& newFrame)
 {
+	Trace::Span span("QGLCanvas::setFrame");
+
 	// Keep the QGL canvas from drawing while we change the image
-	lock_guard<recursive_mutex> pixelLock(pixelsMutex);
+	unique_lock<recursive_mutex> pixelLock(pixelsMutex, defer_lock);
+	{
+		Trace::Span lockSpan("QGLCanvas lock");
+		pixelLock.lock();
+	}
 
-	// Keep a shared_ptr reference to our frame data
-	frame = newFrame;
+	// Keep a shared_ptr reference to our frame data.
+	// QImage has no format for RGB with a zero pad byte, so padded pixels get packed first.
+	if (newFrame->hasPackedPixels()) {
+		frame = newFrame;
+	}
+	else {
+		frame = make_shared<VideoFrame>(newFrame->getWidth(), newFrame->getHeight(), newFrame->getDepth(), false);
+		*frame = *newFrame;
+	}
 
 	// Create a new QImage, which is just a shallow copy of the frame.
 	setFrame(std::unique_ptr<QImage>(new QImage(frame->getPixels(),
 	                                 frame->getWidth(),
 	                                 frame->getHeight(),
+	                                 frame->getPitch(),
 	                                 QImage::Format_RGB888)));
 }
 
@@ -39,6 +56,8 @@ void QGLCanvas::paintEvent(QPaintEvent*)
 	if (img == nullptr)
 		return;
 
+	Trace::Span span("QGLCanvas::paintEvent");
+
 	QPainter painter(this);
 	painter.setRenderHint(QPainter::SmoothPixmapTransform, 1);
 
@@ -0,0 +1,84 @@
+#include "QualityController.hpp"
+
+#include <cstdio>
+
+#include "VideoFrame.hpp"
+
+using namespace std;
+
+namespace {
+
+typedef chrono::duration<double, milli> DoubleMilliseconds;
+
+/// How long before now the frame was captured, or zero if it doesn't say
+QualityController::Clock::duration ageOf(const VideoFrame& frame, QualityController::Clock::time_point now)
+{
+	const auto captured = frame.getCaptureTime();
+	if (captured == QualityController::Clock::time_point())
+		return QualityController::Clock::duration::zero();
+	return now - captured;
+}
+
+} // end anonymous namespace
+
+constexpr double QualityController::restoreFraction;
+
+QualityController::QualityController(Clock::duration latencyBudget, const TimeSource& clk)
+	: budget(latencyBudget),
+	  clock(clk)
+{ }
+
+bool QualityController::admit(const VideoFrame& frame)
+{
+	if (level < QL_DROP_STALE || dropStreak >= maxConsecutiveDrops || ageOf(frame, clock.now()) <= budget) {
+		dropStreak = 0;
+		return true;
+	}
+
+	// A dropped frame counts against us too, or we'd never have a reason to restore anything
+	++dropStreak;
+	++dropped;
+	underBudgetStreak = 0;
+	return false;
+}
+
+void QualityController::finished(const VideoFrame& frame)
+{
+	const Clock::duration age = ageOf(frame, clock.now());
+
+	if (age > budget) {
+		underBudgetStreak = 0;
+		if (++overBudgetStreak >= degradeAfter && level + 1 < QL_COUNT)
+			changeLevel((Level)(level + 1), "over budget", age);
+	}
+	else {
+		overBudgetStreak = 0;
+		if (DoubleMilliseconds(age).count() > DoubleMilliseconds(budget).count() * restoreFraction)
+			underBudgetStreak = 0;
+		else if (++underBudgetStreak >= restoreAfter && level > QL_FULL)
+			changeLevel((Level)(level - 1), "back under budget", age);
+	}
+}
+
+const char* QualityController::getLevelName(Level l)
+{
+	switch (l) {
+		case QL_FULL: return "full";
+		case QL_NO_PREVIEW: return "no preview";
+		case QL_ROI_DETECTION: return "ROI detection";
+		case QL_DROP_STALE: return "drop stale frames";
+		default: return "unknown";
+	}
+}
+
+void QualityController::changeLevel(Level to, const char* why, Clock::duration age)
+{
+	printf("Quality: %s -> %s (%s: frame was %.1f ms old, budget is %.1f ms)\n",
+	       getLevelName(level), getLevelName(to), why,
+	       DoubleMilliseconds(age).count(), DoubleMilliseconds(budget).count());
+	fflush(stdout);
+
+	level = to;
+	overBudgetStreak = 0;
+	underBudgetStreak = 0;
+}
@@ -0,0 +1,89 @@
+#ifndef __QUALITY_CONTROLLER_HPP__
+#define __QUALITY_CONTROLLER_HPP__
+
+#include <chrono>
+#include <cstdint>
+
+#include "TimeSource.hpp"
+
+class VideoFrame;
+
+/**
+ * \brief Sheds work in the play loop when frames take longer than a latency budget to act on
+ *
+ * Each frame's age (from its capture time to when we finish with it) is checked against the budget.
+ * After a few frames in a row over budget, the quality level drops by one step, each step cutting more:
+ * first the preview and its overlays, then full-frame detection in favor of searching near the last bird,
+ * and finally frames that are already over budget when they arrive are dropped unprocessed.
+ * Once frames come in comfortably under budget for a while, quality is restored a step at a time.
+ * Every change of level is logged to stdout.
+ */
+class QualityController {
+
+public:
+
+	typedef std::chrono::steady_clock Clock;
+
+	/// How much work to do per frame, from the most to the least
+	enum Level {
+		QL_FULL, ///< Everything, including the preview
+		QL_NO_PREVIEW, ///< No overlays or preview
+		QL_ROI_DETECTION, ///< Search for the bird only near where it last was, instead of over the whole frame
+		QL_DROP_STALE, ///< Drop frames that are already over budget when they arrive
+		QL_COUNT
+	};
+
+	/**
+	 * \param latencyBudget How old a frame may be by the time we're done with it
+	 * \param clk What frames' ages are measured with, which must be the clock their capture times came from
+	 */
+	explicit QualityController(Clock::duration latencyBudget, const TimeSource& clk = TimeSource::steady());
+
+	/**
+	 * \brief Called as a frame arrives
+	 * \returns false if the frame is too old to be worth processing and should be dropped
+	 */
+	bool admit(const VideoFrame& frame);
+
+	/// Called once a frame has been acted on, with its age at that point deciding whether to change levels
+	void finished(const VideoFrame& frame);
+
+	Level getLevel() const { return level; }
+
+	bool showPreview() const { return level < QL_NO_PREVIEW; }
+
+	bool useROIDetection() const { return level >= QL_ROI_DETECTION; }
+
+	Clock::duration getBudget() const { return budget; }
+
+	/// The number of frames admit has turned away
+	uint64_t getDroppedCount() const { return dropped; }
+
+	static const char* getLevelName(Level l);
+
+private:
+
+	/// Moves to a new level and logs why
+	void changeLevel(Level to, const char* why, Clock::duration age);
+
+	/// Frames in a row over budget before shedding more work
+	static const int degradeAfter = 3;
+
+	/// Frames in a row under restoreFraction of the budget before restoring some work
+	static const int restoreAfter = 60;
+
+	static constexpr double restoreFraction = 0.6;
+
+	/// Process a frame anyway after dropping this many in a row, so a slow capture can't starve the AI
+	static const int maxConsecutiveDrops = 2;
+
+	const Clock::duration budget;
+	const TimeSource& clock;
+	Level level = QL_FULL;
+	int overBudgetStreak = 0;
+	int underBudgetStreak = 0;
+	int dropStreak = 0;
+	uint64_t dropped = 0;
+};
+
+#endif
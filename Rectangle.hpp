@@ -5,8 +5,13 @@
 
 struct Point
 {
+	Point() : x(0), y(0) { }
+
 	Point(int x, int y) : x(x), y(y) { }
 
+	bool operator==(const Point& o) const { return x == o.x && y == o.y; }
+	bool operator!=(const Point& o) const { return !(*this == o); }
+
 	int x, y;
 };
 
@@ -18,6 +23,10 @@ struct Rectangle {
 
 	Rectangle(int l, int t, int r, int b) : left(l), top(t), right(r), bottom(b) { }
 
+	bool operator==(const Rectangle& o) const
+	{ return left == o.left && top == o.top && right == o.right && bottom == o.bottom; }
+	bool operator!=(const Rectangle& o) const { return !(*this == o); }
+
 	int getWidth() const { return right - left + 1; }
 	int getHeight() const { return bottom - top + 1; }
 	int getArea() const { return getWidth() * getHeight(); }
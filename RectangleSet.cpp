@@ -0,0 +1,167 @@
+#include "RectangleSet.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+#include "Exceptions.hpp"
+
+using namespace std;
+
+RectangleSet::RectangleSet(int tolerance, int cellSize, FrameArena* arena)
+	: tolerance(tolerance),
+	  cellSize(cellSize),
+	  rects(arena),
+	  parent(arena),
+	  slots(arena),
+	  cellStart(arena),
+	  cellItems(arena),
+	  fill(arena),
+	  merged(arena)
+{
+	if (tolerance < 0 || cellSize < 1)
+		throw Exceptions::ArgumentException("The tolerance must not be negative, and cells must have a size",
+		                                    __FUNCTION__);
+}
+
+void RectangleSet::add(const Rectangle& r)
+{
+	// Anything adjacent would be merged into the same box in the end anyway, so do it now if it's cheap.
+	// Detectors add pieces in scan order, so this usually leaves merge() only a handful of boxes to work on.
+	const size_t lookBack = min<size_t>(rects.size(), 4);
+	for (size_t i = rects.size(); i-- > rects.size() - lookBack; ) {
+		if (rects[i].adjacentTo(r, tolerance)) {
+			rects[i].expandTo(r);
+			return;
+		}
+	}
+	rects.push_back(r);
+}
+
+void RectangleSet::add(const Rectangle* rs, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+		add(rs[i]);
+}
+
+const RectangleList& RectangleSet::merge(int minArea)
+{
+	while (mergeOnce())
+		;
+
+	if (minArea > 0) {
+		rects.erase(remove_if(rects.begin(), rects.end(), [=](const Rectangle& r) { return r.getArea() < minArea; }),
+		            rects.end());
+	}
+
+	// Sort by index instead of stable_sort, which asks the heap for a buffer every time
+	slots.resize(rects.size());
+	iota(slots.begin(), slots.end(), 0);
+	sort(slots.begin(), slots.end(), [&](int l, int r) {
+		const int leftArea = rects[l].getArea();
+		const int rightArea = rects[r].getArea();
+		return leftArea != rightArea ? leftArea > rightArea : l < r;
+	});
+	merged.clear();
+	for (int i : slots)
+		merged.push_back(rects[i]);
+	rects.swap(merged);
+	return rects;
+}
+
+bool RectangleSet::mergeOnce()
+{
+	const size_t n = rects.size();
+	if (n < 2)
+		return false;
+
+	// Lay a grid over everything, with room for the tolerance around the edges
+	Rectangle bounds = rects[0];
+	for (const Rectangle& r : rects)
+		bounds.expandTo(r);
+	bounds.expandBy(tolerance);
+
+	const int columns = bounds.getWidth() / cellSize + 1;
+	const int rows = bounds.getHeight() / cellSize + 1;
+	const size_t cellCount = (size_t)columns * (size_t)rows;
+
+	// Anything within tolerance of a rectangle shares a cell with its grown box
+	auto cellsOf = [&](const Rectangle& r) {
+		return Rectangle((r.left - tolerance - bounds.left) / cellSize, (r.top - tolerance - bounds.top) / cellSize,
+		                 (r.right + tolerance - bounds.left) / cellSize, (r.bottom + tolerance - bounds.top) / cellSize);
+	};
+
+	// Bucket by counting first, so each cell is a run of one flat list: cellItems[cellStart[c], cellStart[c + 1])
+	cellStart.assign(cellCount + 1, 0);
+	for (const Rectangle& r : rects) {
+		const Rectangle c = cellsOf(r);
+		for (int y = c.top; y <= c.bottom; ++y) {
+			for (int x = c.left; x <= c.right; ++x)
+				++cellStart[(size_t)y * columns + x + 1];
+		}
+	}
+	partial_sum(cellStart.begin(), cellStart.end(), cellStart.begin());
+
+	cellItems.resize(cellStart.back());
+	fill.assign(cellStart.begin(), cellStart.end() - 1);
+	for (size_t i = 0; i < n; ++i) {
+		const Rectangle c = cellsOf(rects[i]);
+		for (int y = c.top; y <= c.bottom; ++y) {
+			for (int x = c.left; x <= c.right; ++x)
+				cellItems[fill[(size_t)y * columns + x]++] = (int)i;
+		}
+	}
+
+	parent.resize(n);
+	iota(parent.begin(), parent.end(), 0);
+
+	bool mergedAny = false;
+	auto unite = [&](int a, int b) {
+		a = find(a);
+		b = find(b);
+		if (a == b)
+			return;
+		if (b < a)
+			swap(a, b);
+		parent[b] = a;
+		mergedAny = true;
+	};
+
+	for (size_t c = 0; c < cellCount; ++c) {
+		const int* cell = &cellItems[0] + cellStart[c];
+		const int count = cellStart[c + 1] - cellStart[c];
+		for (int a = 0; a < count; ++a) {
+			for (int b = a + 1; b < count; ++b) {
+				if (find(cell[a]) != find(cell[b]) && rects[cell[a]].adjacentTo(rects[cell[b]], tolerance))
+					unite(cell[a], cell[b]);
+			}
+		}
+	}
+
+	if (!mergedAny)
+		return false;
+
+	// Each group becomes one box, in the order of the group's first rectangle
+	merged.clear();
+	slots.assign(n, -1);
+	for (size_t i = 0; i < n; ++i) {
+		const int root = find((int)i);
+		if (slots[root] < 0) {
+			slots[root] = (int)merged.size();
+			merged.push_back(rects[i]);
+		}
+		else {
+			merged[slots[root]].expandTo(rects[i]);
+		}
+	}
+	rects.swap(merged);
+	return true;
+}
+
+int RectangleSet::find(int i)
+{
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
@@ -0,0 +1,79 @@
+#ifndef __RECTANGLE_SET_HPP__
+#define __RECTANGLE_SET_HPP__
+
+#include <cstddef>
+#include <vector>
+
+#include "FrameArena.hpp"
+#include "Rectangle.hpp"
+
+/**
+ * \brief A collection of rectangles that can be merged down to the bounding boxes of the groups of them
+ *        within some tolerance of each other
+ *
+ * Rectangles adjacent to one of the last few added are folded into it as they come in.
+ * The rest are bucketed into the cells of a coarse grid that their boxes (grown by the tolerance) cover,
+ * so only rectangles sharing a cell are ever compared. Merged boxes can reach rectangles their parts couldn't,
+ * so merging repeats over the merged boxes until nothing changes, which is usually just once more.
+ * With small rectangles that makes a merge close to linear in their number, instead of
+ * comparing every pair over and over.
+ *
+ * Given a FrameArena, the set keeps everything (its scratch space included) there, so a set made
+ * for one frame's merging costs no heap allocations. A long-lived set without one reuses its memory instead.
+ */
+class RectangleSet {
+
+public:
+
+	/**
+	 * \param tolerance How far apart (in pixels) two rectangles can be and still merge, as in Rectangle::adjacentTo
+	 * \param cellSize The side of each grid cell in pixels. Cells a few times the size of a typical rectangle work well.
+	 * \param arena Where to allocate from, or nullptr for the heap. The set must not outlive the arena's next reset.
+	 */
+	explicit RectangleSet(int tolerance = 1, int cellSize = 32, FrameArena* arena = nullptr);
+
+	/// Adds a rectangle, right away growing one of the last few added to take it in if they're adjacent
+	void add(const Rectangle& r);
+
+	void add(const std::vector<Rectangle>& rs) { add(rs.data(), rs.size()); }
+
+	void add(const RectangleList& rs) { add(rs.data(), rs.size()); }
+
+	void add(const Rectangle* rs, size_t count);
+
+	void clear() { rects.clear(); }
+
+	/// The number of rectangles held, which may be fewer than were added (see add)
+	size_t size() const { return rects.size(); }
+
+	bool empty() const { return rects.empty(); }
+
+	/**
+	 * \brief Merges every group of rectangles within the tolerance of each other into its bounding box
+	 * \param minArea Merged rectangles smaller than this are dropped
+	 * \returns The merged rectangles, largest area first (ties keep the order they were added in).
+	 *          The set holds the same rectangles afterwards.
+	 */
+	const RectangleList& merge(int minArea = 0);
+
+private:
+
+	/// Does one pass of merging over rects, returning false if nothing was merged
+	bool mergeOnce();
+
+	int find(int i);
+
+	int tolerance;
+	int cellSize;
+	RectangleList rects;
+
+	// Scratch space kept between merges
+	ArenaVector<int> parent;
+	ArenaVector<int> slots; ///< Where each group's box goes in merged (or, when sorting, which rectangle goes where)
+	ArenaVector<int> cellStart; ///< Where each grid cell's run of cellItems starts, row by row
+	ArenaVector<int> cellItems; ///< The rectangles touching each cell
+	ArenaVector<int> fill;
+	RectangleList merged;
+};
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef __SCREEN_IO_HPP__
 #define __SCREEN_IO_HPP__
 
+#include <chrono>
 #include <memory>
 
 #include "VideoFrame.hpp"
@@ -17,6 +18,18 @@ public:
 	/// Focuses in on a certain part of the screen. Future calls to getFrame will just get this portion.
 	virtual void focusOn(const Rectangle& r) = 0;
 
+	/**
+	 * \brief Blocks until something inside the focused area may have changed
+	 * \param timeout The longest to wait
+	 * \returns false if the timeout passed with no change, true otherwise
+	 *
+	 * Implementations that can't tell when the screen changes return true immediately.
+	 */
+	virtual bool waitForChange(std::chrono::milliseconds timeout) { (void)timeout; return true; }
+
+	/// Returns the bounds of the whole screen, which is what getFrame captures when not focused
+	virtual Rectangle getScreenBounds() const = 0;
+
 	/// Undoes any focusing we've done and takes frames of the entire screen again
 	virtual void resetFocus() = 0;
 
@@ -25,8 +38,11 @@ public:
 	/// Moves the mouse to a given position
 	virtual void mouseTo(int x, int y) = 0;
 
-	/// clicks
-	virtual void click() = 0;
+	/**
+	 * \brief Clicks, without waiting for anything else talking to the screen
+	 * \returns When the click was actually handed to the display server
+	 */
+	virtual std::chrono::steady_clock::time_point click() = 0;
 
 };
 
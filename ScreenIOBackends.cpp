@@ -0,0 +1,26 @@
+#include "ScreenIOBackends.hpp"
+
+#include <cstdlib>
+
+#include "Exceptions.hpp"
+#include "X11ScreenIO.hpp"
+#include "XCBScreenIO.hpp"
+
+using namespace std;
+
+std::unique_ptr<ScreenIO> createScreenIO(const std::string& backend)
+{
+	if (backend == "x11")
+		return unique_ptr<ScreenIO>(new X11ScreenIO);
+	if (backend == "xcb")
+		return unique_ptr<ScreenIO>(new XCBScreenIO);
+
+	throw Exceptions::ArgumentException("Unknown screen backend \"" + backend + "\" (expected x11 or xcb)",
+	                                    __FUNCTION__);
+}
+
+std::string getDefaultScreenIOBackend()
+{
+	const char* env = getenv("FLAPPER_BACKEND");
+	return (env != nullptr && *env != '\0') ? string(env) : string("x11");
+}
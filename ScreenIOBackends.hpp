@@ -0,0 +1,19 @@
+#ifndef __SCREEN_IO_BACKENDS_HPP__
+#define __SCREEN_IO_BACKENDS_HPP__
+
+#include <memory>
+#include <string>
+
+#include "ScreenIO.hpp"
+
+/**
+ * \brief Creates a ScreenIO by name
+ * \param backend "x11" for X11ScreenIO or "xcb" for XCBScreenIO
+ * \throws Exceptions::ArgumentException if the name isn't one of the above
+ */
+std::unique_ptr<ScreenIO> createScreenIO(const std::string& backend);
+
+/// Returns the backend named by the FLAPPER_BACKEND environment variable, or "x11" if it isn't set
+std::string getDefaultScreenIOBackend();
+
+#endif
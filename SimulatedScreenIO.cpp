@@ -0,0 +1,209 @@
+#include "SimulatedScreenIO.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Exceptions.hpp"
+
+using namespace std;
+
+SimulatedScreenIO::SimulatedScreenIO(size_t w, size_t h, uint32_t seed)
+	: synth(w, h),
+	  origin(Clock::now()),
+	  clock(origin),
+	  rngState(1)
+{
+	// A flap lifts the bird about half a gap, taking 0.3 seconds to get there,
+	// and a new pipe comes along every second and a half
+	const float jumpHeight = (float)synth.getGapHeight() / 2;
+	const float riseTime = 0.3f;
+	defaultRules.gravity = 2 * jumpHeight / (riseTime * riseTime);
+	defaultRules.flapVelocity = -2 * jumpHeight / riseTime;
+	defaultRules.scrollSpeed = (float)synth.getPipeSpacing() / 1.5f;
+	defaultRules.frameRate = 60;
+	defaultRules.clickLatency = 0.02f;
+	defaultRules.leadIn = 2;
+	nextRules = defaultRules;
+
+	newGame(seed);
+}
+
+void SimulatedScreenIO::newGame(uint32_t seed)
+{
+	if (nextRules.frameRate <= 0 || nextRules.scrollSpeed <= 0 || nextRules.clickLatency < 0 || nextRules.leadIn < 0)
+		throw Exceptions::ArgumentException("The game needs a frame rate and a scroll speed, and can't look ahead",
+		                                    __FUNCTION__);
+
+	rules = nextRules;
+	started = false;
+	over = false;
+	birdY = (float)synth.getGroundTop() * 0.45f;
+	birdVelocity = 0;
+	scroll = 0;
+	score = 0;
+	flapTimes.clear();
+	gapTops.clear();
+	rngState = seed * 2654435761u + 1;
+	if (rngState == 0)
+		rngState = 1;
+	scene.gameOver = false;
+	framesRendered = 0;
+}
+
+shared_ptr<VideoFrame> SimulatedScreenIO::getFrame()
+{
+	advanceTo(elapsed + 1.0 / rules.frameRate);
+	clock.set(origin + toClock(elapsed));
+
+	// Reuse the last frame unless someone is still holding on to it, or to a view of it
+	if (!frame || frame.use_count() != 1 || frame->hasSharedPixels())
+		frame = make_shared<VideoFrame>(synth.getWidth(), synth.getHeight(), 3, false);
+
+	if (!over) {
+		buildScene();
+		truth = synth.render(scene, *frame);
+
+		const Rectangle& b = truth.bird;
+		bool hit = b.bottom >= synth.getGroundTop();
+		for (const Rectangle& p : truth.pipes)
+			hit = hit || p.adjacentTo(b, 0);
+		if (hit) {
+			over = true;
+			scene.gameOver = true;
+		}
+	}
+	// Once the bird has hit something, the game shows the flash from then on
+	if (over)
+		synth.render(scene, *frame);
+
+	frame->setCaptureTime(now());
+	frame->setFrameID(nextFrameID++);
+	frame->setDuplicate(false);
+	++framesRendered;
+
+	if (focused)
+		return frame->view(focus);
+	return frame;
+}
+
+void SimulatedScreenIO::focusOn(const Rectangle& r)
+{
+	focus = r;
+	focus.constrainBy(getScreenBounds());
+	focused = true;
+}
+
+void SimulatedScreenIO::resetFocus()
+{
+	focused = false;
+}
+
+Rectangle SimulatedScreenIO::getScreenBounds() const
+{
+	return Rectangle(0, 0, (int)synth.getWidth() - 1, (int)synth.getHeight() - 1);
+}
+
+void SimulatedScreenIO::mouseTo(int, int)
+{
+	// Anywhere on the game is as good as anywhere else
+}
+
+SimulatedScreenIO::Clock::time_point SimulatedScreenIO::click()
+{
+	flapTimes.push_back(elapsed + rules.clickLatency);
+	return now();
+}
+
+SimulatedScreenIO::Clock::duration SimulatedScreenIO::toClock(double seconds)
+{
+	return chrono::duration_cast<Clock::duration>(chrono::duration<double>(seconds));
+}
+
+void SimulatedScreenIO::advanceTo(double t)
+{
+	size_t flapped = 0;
+	for (; flapped < flapTimes.size() && flapTimes[flapped] <= t; ++flapped) {
+		const double at = max(flapTimes[flapped], elapsed);
+		fly((float)(at - elapsed));
+		elapsed = at;
+		if (over)
+			continue;
+		if (!started) {
+			started = true;
+			startTime = at;
+		}
+		birdVelocity = rules.flapVelocity;
+	}
+	flapTimes.erase(flapTimes.begin(), flapTimes.begin() + flapped);
+
+	fly((float)(t - elapsed));
+	elapsed = t;
+}
+
+void SimulatedScreenIO::fly(float seconds)
+{
+	// The bird waits in the air for the first click, and stays where it fell once the game is over
+	if (!started || over || seconds <= 0)
+		return;
+
+	birdY += birdVelocity * seconds + 0.5f * rules.gravity * seconds * seconds;
+	birdVelocity += rules.gravity * seconds;
+	scroll += rules.scrollSpeed * seconds;
+
+	// The bird can't fly off the top of the screen, but it can still hit the pipes there
+	const float ceiling = (float)synth.getBirdHeight() / 2;
+	if (birdY < ceiling) {
+		birdY = ceiling;
+		birdVelocity = max(birdVelocity, 0.0f);
+	}
+}
+
+int SimulatedScreenIO::pipeLeft(int k) const
+{
+	const float leadIn = rules.leadIn * rules.scrollSpeed;
+	return (int)synth.getWidth() + (int)(leadIn - scroll) + k * synth.getPipeSpacing();
+}
+
+int SimulatedScreenIO::gapTopOf(int k)
+{
+	// Like the real game, the gaps can be anywhere, short of running into the top of the screen or the ground
+	const int margin = synth.getGapHeight() / 2;
+	const int range = max(1, synth.getGroundTop() - 2 * margin - synth.getGapHeight());
+	while ((int)gapTops.size() <= k)
+		gapTops.push_back(margin + (int)(nextRandom() % (uint32_t)range));
+	return gapTops[k];
+}
+
+void SimulatedScreenIO::buildScene()
+{
+	const int width = (int)synth.getWidth();
+	const int overhang = synth.getLipOverhang() + 1;
+	const int birdX = width / 4;
+
+	scene.bird = Point(birdX, (int)lround(birdY));
+	scene.pipes.clear();
+
+	// A pipe is passed once all of it, lips included, is behind the bird
+	while (pipeLeft(score) + synth.getPipeWidth() + overhang < birdX - synth.getBirdWidth() / 2)
+		++score;
+
+	for (int k = score > 0 ? score - 1 : 0;; ++k) {
+		const int left = pipeLeft(k);
+		if (left - overhang >= width)
+			break;
+		if (left + synth.getPipeWidth() + overhang <= 0)
+			continue;
+
+		const int gapTop = gapTopOf(k);
+		scene.pipes.emplace_back(left, gapTop, gapTop + synth.getGapHeight() - 1);
+	}
+}
+
+uint32_t SimulatedScreenIO::nextRandom()
+{
+	// xorshift32
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 17;
+	rngState ^= rngState << 5;
+	return rngState;
+}
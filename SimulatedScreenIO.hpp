@@ -0,0 +1,148 @@
+#ifndef __SIMULATED_SCREEN_IO_HPP__
+#define __SIMULATED_SCREEN_IO_HPP__
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "FrameSynthesizer.hpp"
+#include "ScreenIO.hpp"
+#include "TimeSource.hpp"
+
+/**
+ * \brief A game of Flappy Bird played entirely in memory, behind the ScreenIO interface
+ *
+ * Each getFrame advances the game by one frame on a virtual clock, then renders it with a FrameSynthesizer,
+ * so the detectors see the palette they look for in the real game. Clicks flap the bird (the first one starts
+ * the game) a little later on that same clock. Nothing waits on real time, so games can be played as fast as
+ * the AI can keep up with, as long as the AI reads the time from getClock().
+ *
+ * The screen is just the game, so the game window is the whole of getScreenBounds().
+ */
+class SimulatedScreenIO : public ScreenIO {
+
+public:
+
+	typedef std::chrono::steady_clock Clock;
+
+	/// How the game plays. Distances are in pixels, down is positive, and times are in seconds.
+	struct Rules {
+		float gravity; ///< Downward acceleration of the bird
+		float flapVelocity; ///< The bird's vertical velocity right after a flap (negative, as it's upward)
+		float scrollSpeed; ///< How fast the pipes move left
+		float frameRate; ///< How many frames getFrame renders per second of game time
+		float clickLatency; ///< How long after click() the bird flaps
+		float leadIn; ///< How long after the game starts the first pipe comes on screen
+	};
+
+	/**
+	 * \brief Creates a game, waiting for its first click
+	 * \param w Width of the game
+	 * \param h Height of the game
+	 * \param seed Picks the course, so the same seed always plays the same pipes
+	 */
+	SimulatedScreenIO(size_t w, size_t h, uint32_t seed = 1);
+
+	/// Starts over with a new course, waiting for the first click. The rules stay the same.
+	void newGame(uint32_t seed);
+
+	/// Rules scaled to the size of the game, somewhat like the real thing's
+	const Rules& getDefaultRules() const { return defaultRules; }
+
+	const Rules& getRules() const { return rules; }
+
+	/// Changes the rules, which only takes effect at the next newGame
+	void setRules(const Rules& r) { nextRules = r; }
+
+	/// Renders the next frame, a frame period later than the last
+	std::shared_ptr<VideoFrame> getFrame() override;
+
+	void focusOn(const Rectangle& r) override;
+
+	void resetFocus() override;
+
+	Rectangle getScreenBounds() const override;
+
+	using ScreenIO::mouseTo;
+
+	void mouseTo(int x, int y) override;
+
+	/// Flaps the bird (or starts the game) once clickLatency has passed
+	Clock::time_point click() override;
+
+	/// The virtual time of the last frame rendered
+	Clock::time_point now() const { return clock.now(); }
+
+	/// The virtual clock, for everything timing the game (PhysicsAnalysis, BirdAI) to read
+	const TimeSource& getClock() const { return clock; }
+
+	/// How long the current game has been running, in virtual seconds, since its first click
+	float getGameTime() const { return started ? (float)(elapsed - startTime) : 0; }
+
+	bool isStarted() const { return started; }
+
+	/// Whether the bird has hit something. The frame where it did is the game over flash.
+	bool isOver() const { return over; }
+
+	/// How many pipes the bird has passed
+	int getScore() const { return score; }
+
+	/// How many frames this game has rendered
+	uint64_t getFramesRendered() const { return framesRendered; }
+
+	// No copy or assign
+	SimulatedScreenIO(const SimulatedScreenIO&) = delete;
+	SimulatedScreenIO& operator=(const SimulatedScreenIO&) = delete;
+
+private:
+
+	static Clock::duration toClock(double seconds);
+
+	/// Moves the bird and the pipes from elapsed up to t, flapping whenever a click lands in between
+	void advanceTo(double t);
+
+	/// Moves the bird without flapping
+	void fly(float seconds);
+
+	/// The screen position of the left of the body of the k-th pipe of the course
+	int pipeLeft(int k) const;
+
+	/// The top of the gap of the k-th pipe of the course, picking it if it hasn't been yet
+	int gapTopOf(int k);
+
+	/// Builds the scene as it is now, and scores the pipes the bird has passed
+	void buildScene();
+
+	uint32_t nextRandom();
+
+	FrameSynthesizer synth;
+	Rules defaultRules;
+	Rules rules;
+	Rules nextRules;
+
+	const Clock::time_point origin; ///< Virtual time zero
+	ManualTimeSource clock; ///< Set to each frame's time as it's rendered
+	double elapsed = 0; ///< Virtual seconds since origin, which keeps counting from one game to the next
+	double startTime = 0; ///< When the game started (on its first click)
+
+	bool started = false;
+	bool over = false;
+	float birdY; ///< The center of the bird's body
+	float birdVelocity = 0;
+	float scroll = 0; ///< How far the course has moved since the game started
+	int score = 0;
+	std::vector<double> flapTimes; ///< When clicks sent but not yet acted on will flap, in order
+	std::vector<int> gapTops; ///< The gaps of the course so far
+	uint32_t rngState;
+
+	SyntheticScene scene;
+	SyntheticTruth truth;
+	std::shared_ptr<VideoFrame> frame; ///< Rendered into again once nobody else holds it or its pixels
+	Rectangle focus;
+	bool focused = false;
+	uint64_t framesRendered = 0;
+	uint64_t nextFrameID = 0;
+};
+
+#endif
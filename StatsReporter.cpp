@@ -0,0 +1,68 @@
+#include "StatsReporter.hpp"
+
+#include <cstdio>
+
+#include "Exceptions.hpp"
+#include "FPSTracker.hpp"
+
+using namespace std;
+
+StatsReporter::StatsReporter(std::chrono::milliseconds p) : period(p) { }
+
+StatsReporter::~StatsReporter()
+{
+	stop();
+}
+
+void StatsReporter::add(const std::string& label, FPSTracker& tracker, bool onlyWhenActive)
+{
+	if (worker)
+		throw Exceptions::InvalidOperationException("Trackers must be added before reporting starts", __FUNCTION__);
+
+	entries.push_back({ label, &tracker, onlyWhenActive });
+}
+
+void StatsReporter::start()
+{
+	if (worker)
+		return;
+
+	stopRequested = false;
+	worker.reset(new std::thread(&StatsReporter::workerProc, this));
+}
+
+void StatsReporter::stop()
+{
+	if (!worker)
+		return;
+
+	{
+		lock_guard<mutex> sl(stopLock);
+		stopRequested = true;
+	}
+	stopCV.notify_one();
+	worker->join();
+	worker.reset();
+}
+
+void StatsReporter::workerProc()
+{
+	auto ms = [](uint64_t ns) { return (double)ns / 1e6; };
+
+	unique_lock<mutex> sl(stopLock);
+	while (!stopCV.wait_for(sl, period, [this] { return stopRequested; })) {
+		for (auto& e : entries) {
+			const FPSTracker::Sample s = e.tracker->sample();
+			if (e.onlyWhenActive && s.perSecond < 0.5f)
+				continue;
+			if (s.latencyCount == 0) {
+				printf("%s%d\n", e.label.c_str(), (int)(s.perSecond + 0.5f));
+			}
+			else {
+				printf("%s%d (p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms)\n",
+				       e.label.c_str(), (int)(s.perSecond + 0.5f), ms(s.p50), ms(s.p90), ms(s.p99), ms(s.max));
+			}
+		}
+		fflush(stdout);
+	}
+}
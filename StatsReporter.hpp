@@ -0,0 +1,65 @@
+#ifndef __STATS_REPORTER_HPP__
+#define __STATS_REPORTER_HPP__
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class FPSTracker;
+
+/**
+ * \brief Periodically samples a set of FPSTrackers and prints their rates and latencies
+ *
+ * Sampling and printing happen on the reporter's own thread, so the threads being measured
+ * never block on stdout.
+ */
+class StatsReporter final {
+
+public:
+
+	StatsReporter(std::chrono::milliseconds period = std::chrono::seconds(1));
+
+	/// Stops the reporting thread, if it was started
+	~StatsReporter();
+
+	/**
+	 * \brief Adds a tracker to report on. Must be called before start().
+	 * \param label Printed before the tracker's rate, e.g. "Processing FPS: "
+	 * \param tracker The tracker to sample. It must outlive the reporter (or the reporter must be stopped first).
+	 * \param onlyWhenActive Skip the line when the rate rounds to zero, e.g. for a breakdown of something rare
+	 */
+	void add(const std::string& label, FPSTracker& tracker, bool onlyWhenActive = false);
+
+	void start();
+
+	void stop();
+
+	StatsReporter(const StatsReporter&) = delete;
+	StatsReporter& operator=(const StatsReporter&) = delete;
+
+private:
+
+	void workerProc();
+
+	struct Entry {
+		std::string label;
+		FPSTracker* tracker;
+		bool onlyWhenActive;
+	};
+
+	std::vector<Entry> entries;
+
+	const std::chrono::milliseconds period;
+
+	std::mutex stopLock;
+	std::condition_variable stopCV;
+	bool stopRequested = false;
+
+	std::unique_ptr<std::thread> worker;
+};
+
+#endif
@@ -0,0 +1,173 @@
+#include "TileClassifier.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Exceptions.hpp"
+#include "FlappyColors.hpp"
+#include "Trace.hpp"
+#include "VideoFrame.hpp"
+
+using namespace std;
+
+namespace {
+
+/// Returns true if the two byte ranges differ anywhere
+inline bool bytesDiffer(const uint8_t* a, const uint8_t* b, size_t n)
+{
+#ifdef __SSE2__
+	// OR together the differences of the whole range and test once at the end.
+	// Tile rows are short, so an early exit would mostly cost us branches.
+	__m128i diff = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+		const __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+		diff = _mm_or_si128(diff, _mm_xor_si128(va, vb));
+	}
+	if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF)
+		return true;
+	return memcmp(a + i, b + i, n - i) != 0;
+#else
+	return memcmp(a, b, n) != 0;
+#endif
+}
+
+} // end anonymous namespace
+
+const int TileClassifier::tileSize;
+
+size_t TileClassifier::update(const VideoFrame& frame)
+{
+	if (frame.getDepth() != 3 || !frame.hasPackedPixels())
+		throw Exceptions::ArgumentException("The frame must be packed 24-bit RGB", __FUNCTION__);
+
+	Trace::Span span("TileClassifier::update");
+
+	if (!previous || previous->getWidth() != frame.getWidth() || previous->getHeight() != frame.getHeight()) {
+		reset(frame);
+	}
+	else {
+		fill(begin(dirty), end(dirty), 0);
+
+		const size_t rowBytes = frame.getWidth() * 3;
+		const size_t tileBytes = tileSize * 3;
+
+		// Walk the frame row by row (rather than tile by tile) to stay friendly to the cache and prefetcher.
+		// Rows of a tile that differ are copied into the previous frame as we go,
+		// so it's up to date when we're done without a second pass.
+		for (size_t y = 0; y < frame.getHeight(); ++y) {
+			const uint8_t* current = frame.getPixel(0, y);
+			uint8_t* last = previous->getPixel(0, y);
+			uint8_t* dirtyRow = &dirty[(y / tileSize) * tilesAcross];
+
+			for (size_t tx = 0, offset = 0; tx < tilesAcross; ++tx, offset += tileBytes) {
+				const size_t n = min(tileBytes, rowBytes - offset);
+				if (bytesDiffer(current + offset, last + offset, n)) {
+					dirtyRow[tx] = 1;
+					memcpy(last + offset, current + offset, n);
+				}
+			}
+		}
+	}
+
+	dirtyCount = 0;
+	for (size_t ty = 0; ty < tilesDown; ++ty) {
+		for (size_t tx = 0; tx < tilesAcross; ++tx) {
+			if (isDirty(tx, ty)) {
+				classify(frame, tx, ty);
+				++dirtyCount;
+			}
+		}
+	}
+
+	return dirtyCount;
+}
+
+void TileClassifier::collect(TileClass c, RectangleList& out) const
+{
+	const uint8_t bit = (uint8_t)(1 << c);
+
+	for (size_t ty = 0; ty < tilesDown; ++ty) {
+		for (size_t tx = 0; tx < tilesAcross; ++tx) {
+			const Tile& tile = tiles[ty * tilesAcross + tx];
+			if (!(tile.classes & bit))
+				continue;
+
+			const int left = (int)tx * tileSize;
+			const int top = (int)ty * tileSize;
+			const auto& rows = tile.rows[c];
+
+			// Emit a box for each run of rows that have the class
+			bool inRun = false;
+			Rectangle run;
+			for (int r = 0; r < tileSize; ++r) {
+				const RowSpan& span = rows[r];
+				if (span.left > span.right) {
+					if (inRun)
+						out.push_back(run);
+					inRun = false;
+				}
+				else if (!inRun) {
+					run = Rectangle(left + span.left, top + r, left + span.right, top + r);
+					inRun = true;
+				}
+				else {
+					run.left = min(run.left, left + span.left);
+					run.right = max(run.right, left + span.right);
+					run.bottom = top + r;
+				}
+			}
+			if (inRun)
+				out.push_back(run);
+		}
+	}
+}
+
+void TileClassifier::reset(const VideoFrame& frame)
+{
+	previous.reset(new VideoFrame(frame));
+	tilesAcross = (frame.getWidth() + tileSize - 1) / tileSize;
+	tilesDown = (frame.getHeight() + tileSize - 1) / tileSize;
+	dirty.assign(getTileCount(), 1);
+	tiles.assign(getTileCount(), Tile());
+}
+
+void TileClassifier::classify(const VideoFrame& frame, size_t tileX, size_t tileY)
+{
+	Tile& tile = tiles[tileY * tilesAcross + tileX];
+	tile.classes = 0;
+	const RowSpan empty = { tileSize, 0 };
+	for (auto& rows : tile.rows)
+		rows.fill(empty);
+
+	const int left = (int)tileX * tileSize;
+	const int top = (int)tileY * tileSize;
+	const int width = min(tileSize, (int)frame.getWidth() - left);
+	const int height = min(tileSize, (int)frame.getHeight() - top);
+
+	for (int r = 0; r < height; ++r) {
+		const uint8_t* pix = frame.getPixel((size_t)left, (size_t)(top + r));
+
+		auto mark = [&](TileClass c, int x) {
+			RowSpan& span = tile.rows[c][r];
+			span.left = min(span.left, (uint8_t)x);
+			span.right = max(span.right, (uint8_t)x);
+			tile.classes |= (uint8_t)(1 << c);
+		};
+
+		for (int x = 0; x < width; ++x, pix += 3) {
+			if (FlappyColors::isBirdColor(pix)) {
+				mark(TC_BIRD, x);
+				if (FlappyColors::isBeakColor(pix))
+					mark(TC_BEAK, x);
+			}
+			if (FlappyColors::isPipeColor(pix))
+				mark(TC_PIPE, x);
+		}
+	}
+}
@@ -0,0 +1,95 @@
+#ifndef __TILE_CLASSIFIER_HPP__
+#define __TILE_CLASSIFIER_HPP__
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "FrameArena.hpp"
+#include "Rectangle.hpp"
+
+class VideoFrame;
+
+/**
+ * \brief Tracks which tiles of a frame changed since the last one, and what each tile contains
+ *
+ * update() compares each new frame against a copy of the previous one, a fixed-size tile at a time,
+ * and only rescans the tiles that differ. For each tile it caches which columns of each row hold pixels of
+ * each TileClass, so the detectors can assemble objects from per-tile boxes (see the TileClassifier
+ * overloads in FlappySearches.hpp) and their cost follows how much of the screen changed, not its area.
+ */
+class TileClassifier {
+
+public:
+
+	/// Tiles are this many pixels on a side (except along the right and bottom edges of odd-sized frames)
+	static const int tileSize = 16;
+
+	/// The kinds of pixels tracked per tile
+	enum TileClass {
+		TC_BEAK, ///< See FlappyColors::isBeakColor
+		TC_BIRD, ///< See FlappyColors::isBirdColor
+		TC_PIPE, ///< See FlappyColors::isPipeColor
+		TC_COUNT
+	};
+
+	TileClassifier() = default;
+
+	/**
+	 * \brief Diffs a frame against the previous one and reclassifies the tiles that changed
+	 * \returns The number of tiles that changed. Every tile counts as changed on the first frame,
+	 *          or when the frame size changes.
+	 */
+	size_t update(const VideoFrame& frame);
+
+	/**
+	 * \brief Appends boxes covering the pixels of the given class, in row-major tile order
+	 *
+	 * Each tile contributes one box per run of consecutive rows containing the class,
+	 * so two objects separated by a blank row within a tile come out as separate boxes.
+	 */
+	void collect(TileClass c, RectangleList& out) const;
+
+	/// Returns true if the given tile changed in the last update
+	bool isDirty(size_t tileX, size_t tileY) const { return dirty[tileY * tilesAcross + tileX] != 0; }
+
+	size_t getTilesAcross() const { return tilesAcross; }
+
+	size_t getTilesDown() const { return tilesDown; }
+
+	size_t getTileCount() const { return tilesAcross * tilesDown; }
+
+	/// The number of tiles that changed in the last update
+	size_t getDirtyCount() const { return dirtyCount; }
+
+	TileClassifier(const TileClassifier&) = delete;
+	TileClassifier& operator=(const TileClassifier&) = delete;
+
+private:
+
+	/// The leftmost and rightmost columns (relative to the tile) of a class in one row. Empty if left > right.
+	struct RowSpan {
+		uint8_t left;
+		uint8_t right;
+	};
+
+	struct Tile {
+		uint8_t classes; ///< Bit n is set if the tile contains pixels of TileClass n
+		std::array<std::array<RowSpan, tileSize>, TC_COUNT> rows; ///< Only meaningful for the classes present
+	};
+
+	void reset(const VideoFrame& frame);
+
+	void classify(const VideoFrame& frame, size_t tileX, size_t tileY);
+
+	std::unique_ptr<VideoFrame> previous; ///< The last frame we saw, kept up to date a tile row at a time
+	size_t tilesAcross = 0;
+	size_t tilesDown = 0;
+	std::vector<uint8_t> dirty;
+	std::vector<Tile> tiles;
+	size_t dirtyCount = 0;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef __TIME_SOURCE_HPP__
+#define __TIME_SOURCE_HPP__
+
+#include <atomic>
+#include <chrono>
+
+/**
+ * \brief Where the play loop's classes get the time from
+ *
+ * Everything that measures how the game moves (PhysicsAnalysis, BirdAI) or how fast we keep up with it
+ * (FPSTracker, PeriodicRunner, QualityController) reads the time through one of these, passed in when it's
+ * created. By default that's the real, monotonic clock. A ManualTimeSource lets a simulated or recorded game
+ * set the time itself, so it can run faster than real time and come out the same every time.
+ *
+ * Times are steady_clock time points either way, so they can be compared with frames' capture times.
+ */
+class TimeSource {
+
+public:
+
+	typedef std::chrono::steady_clock::time_point TimePoint;
+	typedef std::chrono::steady_clock::duration Duration;
+
+	virtual ~TimeSource() { }
+
+	virtual TimePoint now() const = 0;
+
+	/// The real clock, which is what everything uses unless told otherwise
+	static const TimeSource& steady();
+};
+
+/// Reads std::chrono::steady_clock
+class SteadyTimeSource final : public TimeSource {
+
+public:
+
+	TimePoint now() const override { return std::chrono::steady_clock::now(); }
+};
+
+inline const TimeSource& TimeSource::steady()
+{
+	static const SteadyTimeSource source;
+	return source;
+}
+
+/**
+ * \brief A clock that only moves when it's told to
+ *
+ * Safe to read from other threads (e.g. a StatsReporter sampling an FPSTracker) while one thread sets it.
+ */
+class ManualTimeSource final : public TimeSource {
+
+public:
+
+	explicit ManualTimeSource(TimePoint start = TimePoint()) : ticks(start.time_since_epoch().count()) { }
+
+	TimePoint now() const override { return TimePoint(Duration(ticks.load(std::memory_order_acquire))); }
+
+	void set(TimePoint t) { ticks.store(t.time_since_epoch().count(), std::memory_order_release); }
+
+	void advance(Duration d) { ticks.fetch_add(d.count(), std::memory_order_acq_rel); }
+
+	ManualTimeSource(const ManualTimeSource&) = delete;
+	ManualTimeSource& operator=(const ManualTimeSource&) = delete;
+
+private:
+
+	std::atomic<Duration::rep> ticks;
+};
+
+#endif
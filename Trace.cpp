@@ -0,0 +1,191 @@
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct Event {
+	const char* name;
+	uint64_t frameID;
+	uint64_t start;
+	uint64_t end;
+};
+
+/// Spans recorded by one thread. Only that thread writes to it.
+struct ThreadBuffer {
+	static const size_t capacity = 1 << 14;
+
+	ThreadBuffer(int id) : threadID(id), head(0), events(capacity) { }
+
+	const int threadID;
+	string threadName;
+	atomic<uint64_t> head; ///< Total number of events ever written. The newest is at (head - 1) % capacity.
+	vector<Event> events;
+};
+
+// Buffers are kept around after their threads exit so that their spans still show up in dumps.
+mutex registryLock;
+vector<shared_ptr<ThreadBuffer>> registry;
+
+ThreadBuffer& localBuffer()
+{
+	thread_local shared_ptr<ThreadBuffer> buffer;
+	if (!buffer) {
+		lock_guard<mutex> rl(registryLock);
+		buffer = make_shared<ThreadBuffer>((int)registry.size() + 1);
+		registry.push_back(buffer);
+	}
+	return *buffer;
+}
+
+atomic<bool> dumpRequested(false);
+
+extern "C" void onDumpSignal(int)
+{
+	dumpRequested.store(true);
+}
+
+extern "C" void onToggleSignal(int)
+{
+	Trace::Detail::enabled.store(!Trace::Detail::enabled.load());
+}
+
+/// Escapes the few characters that could show up in span and thread names
+string jsonString(const string& s)
+{
+	string ret = "\"";
+	for (char c : s) {
+		if (c == '"' || c == '\\')
+			ret += '\\';
+		ret += c;
+	}
+	ret += '"';
+	return ret;
+}
+
+} // end anonymous namespace
+
+namespace Trace {
+
+namespace Detail {
+
+atomic<bool> enabled(false);
+
+uint64_t now()
+{
+	return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(
+		chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void record(const char* name, uint64_t frameID, uint64_t start, uint64_t end)
+{
+	ThreadBuffer& b = localBuffer();
+	const uint64_t h = b.head.load(memory_order_relaxed);
+	b.events[h % ThreadBuffer::capacity] = { name, frameID, start, end };
+	b.head.store(h + 1, memory_order_release);
+}
+
+uint64_t& currentFrame()
+{
+	thread_local uint64_t frame = 0;
+	return frame;
+}
+
+} // end namespace Detail
+
+void setEnabled(bool enable)
+{
+	Detail::enabled.store(enable);
+}
+
+void setThreadName(const char* name)
+{
+	ThreadBuffer& b = localBuffer();
+	lock_guard<mutex> rl(registryLock);
+	b.threadName = name;
+}
+
+bool dump(const std::string& path)
+{
+	// Pause recording so that writers don't lap us while we read.
+	// A span that checked the flag just before we cleared it may still land, which is harmless
+	// unless its thread has filled its whole ring since, and then we just get one garbled span.
+	const bool wasEnabled = Detail::enabled.exchange(false);
+
+	FILE* out = fopen(path.c_str(), "w");
+	if (out == nullptr) {
+		setEnabled(wasEnabled);
+		return false;
+	}
+
+	vector<shared_ptr<ThreadBuffer>> buffers;
+	{
+		lock_guard<mutex> rl(registryLock);
+		buffers = registry;
+	}
+
+	// Timestamps are relative to the oldest span, to keep the numbers readable.
+	uint64_t epoch = UINT64_MAX;
+	for (const auto& b : buffers) {
+		const uint64_t h = b->head.load(memory_order_acquire);
+		for (uint64_t i = h > ThreadBuffer::capacity ? h - ThreadBuffer::capacity : 0; i < h; ++i)
+			epoch = min(epoch, b->events[i % ThreadBuffer::capacity].start);
+	}
+
+	fprintf(out, "{\"traceEvents\":[\n");
+	bool first = true;
+	for (const auto& b : buffers) {
+		string threadName;
+		{
+			lock_guard<mutex> rl(registryLock);
+			threadName = b->threadName.empty() ? "thread " + to_string(b->threadID) : b->threadName;
+		}
+		fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":%s}}",
+		        first ? "" : ",\n", b->threadID, jsonString(threadName).c_str());
+		first = false;
+
+		const uint64_t h = b->head.load(memory_order_acquire);
+		for (uint64_t i = h > ThreadBuffer::capacity ? h - ThreadBuffer::capacity : 0; i < h; ++i) {
+			const Event& e = b->events[i % ThreadBuffer::capacity];
+			fprintf(out, ",\n{\"name\":%s,\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+			        "\"args\":{\"frame\":%llu}}",
+			        jsonString(e.name).c_str(), b->threadID,
+			        (double)(e.start - epoch) / 1000.0, (double)(e.end - e.start) / 1000.0,
+			        (unsigned long long)e.frameID);
+		}
+	}
+	fprintf(out, "\n]}\n");
+
+	const bool ok = ferror(out) == 0;
+	fclose(out);
+	setEnabled(wasEnabled);
+	return ok;
+}
+
+void installSignalHandlers()
+{
+	if (getenv("FLAPPER_TRACE") != nullptr)
+		setEnabled(true);
+
+	signal(SIGUSR1, &onDumpSignal);
+	signal(SIGUSR2, &onToggleSignal);
+}
+
+bool takeDumpRequest()
+{
+	if (!dumpRequested.load(memory_order_relaxed))
+		return false;
+	return dumpRequested.exchange(false);
+}
+
+} // end namespace Trace
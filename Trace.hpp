@@ -0,0 +1,98 @@
+#ifndef __TRACE_HPP__
+#define __TRACE_HPP__
+
+/**
+ * \file Trace.hpp
+ *
+ * Lightweight scoped timing spans, for finding out which stage made a given frame slow.
+ *
+ * Each thread records into its own fixed-size ring buffer, so recording never locks or allocates
+ * (after a thread's first span). When tracing is disabled (the default), a span costs one relaxed atomic load.
+ * The buffers can be dumped at any time as Chrome trace-event JSON (load it in chrome://tracing or Perfetto).
+ *
+ * Spans carry the ID of the frame being worked on, so a frame can be followed from the capture thread
+ * to the processing thread.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace Trace {
+
+namespace Detail {
+	extern std::atomic<bool> enabled;
+
+	uint64_t now();
+
+	void record(const char* name, uint64_t frameID, uint64_t start, uint64_t end);
+
+	uint64_t& currentFrame();
+}
+
+inline bool isEnabled() { return Detail::enabled.load(std::memory_order_relaxed); }
+
+void setEnabled(bool enable);
+
+/// Names the calling thread in dumps
+void setThreadName(const char* name);
+
+/**
+ * \brief Writes every span still in the ring buffers to a Chrome trace-event JSON file
+ * \returns true on success
+ *
+ * Recording is paused while the buffers are read.
+ */
+bool dump(const std::string& path);
+
+/**
+ * \brief Installs signal handlers so tracing can be controlled from outside the process
+ *
+ * SIGUSR2 toggles recording and SIGUSR1 requests a dump, which is picked up by takeDumpRequest().
+ * Setting the FLAPPER_TRACE environment variable turns recording on at startup.
+ */
+void installSignalHandlers();
+
+/// Returns true (once) if a dump was requested by a signal since the last call
+bool takeDumpRequest();
+
+/// Sets the frame ID that spans on this thread are tagged with, for the lifetime of the scope
+class FrameScope {
+public:
+	explicit FrameScope(uint64_t frameID) : previous(Detail::currentFrame())
+	{
+		Detail::currentFrame() = frameID;
+	}
+
+	~FrameScope() { Detail::currentFrame() = previous; }
+
+	FrameScope(const FrameScope&) = delete;
+	FrameScope& operator=(const FrameScope&) = delete;
+
+private:
+	const uint64_t previous;
+};
+
+/// Records the time between its construction and destruction
+class Span {
+public:
+	/// \param spanName The name shown in the trace. Must be a string literal (or otherwise live forever).
+	explicit Span(const char* spanName) : name(spanName), start(isEnabled() ? Detail::now() : 0) { }
+
+	~Span()
+	{
+		if (start != 0 && isEnabled())
+			Detail::record(name, Detail::currentFrame(), start, Detail::now());
+	}
+
+	Span(const Span&) = delete;
+	Span& operator=(const Span&) = delete;
+
+private:
+	const char* const name;
+	const uint64_t start;
+};
+
+} // end namespace Trace
+
+#endif
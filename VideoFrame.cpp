@@ -1,88 +1,242 @@
 #include "VideoFrame.hpp"
 
-#include "MKMath.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
 
-void VideoFrame::rgb2hsv()
+#include "HSVConversion.hpp"
+
+namespace {
+
+size_t roundUp(size_t n, size_t to) { return (n + to - 1) / to * to; }
+
+inline uint64_t rotl64(uint64_t v, int r) { return (v << r) | (v >> (64 - r)); }
+
+inline uint64_t mixWord(uint64_t h, uint64_t w)
 {
-	using namespace Math;
+	return rotl64(h ^ (w * 0x9E3779B97F4A7C15ULL), 29) * 0xBF58476D1CE4E5B9ULL;
+}
 
-	if (depth != 3)
-		throw Exceptions::ArgumentException("The frame must be 24-bit RGB", __FUNCTION__);
+/// Sets every pixel of a frame to a color, with the step between pixels known at compile time
+template <size_t Step>
+void fillRows(VideoFrame& frame, const std::array<uint8_t, 3>& color)
+{
+	frame.foreachRow<Step>([&](uint8_t* row, size_t length, size_t) {
+		for (size_t x = 0; x < length; ++x, row += Step) {
+			row[0] = color[0];
+			row[1] = color[1];
+			row[2] = color[2];
+		}
+		return true;
+	});
+}
+
+/// Fills the part of r that lies within the frame
+void fillRectangle(VideoFrame& frame, Rectangle r, const std::array<uint8_t, 3>& color)
+{
+	r.constrainBy(Rectangle(0, 0, (int)frame.getWidth() - 1, (int)frame.getHeight() - 1));
+	if (r.left > r.right || r.top > r.bottom)
+		return;
+
+	VideoFrame area(frame, r);
+	if (area.getBytesPerPixel() == 4)
+		fillRows<4>(area, color);
+	else
+		fillRows<3>(area, color);
+}
 
-	uint8_t* pix = pixels;
-	uint8_t* end = pix + getTotalSize();
-
-	while (pix < end) {
-		float r = (float)pix[0] / 255.0f;
-		float g = (float)pix[1] / 255.0f;
-		float b = (float)pix[2] / 255.0f;
-
-		float cmax = std::max({r, g, b});
-		float cmin = std::min({r, g, b});
-		float delta = cmax - cmin;
-
-		float h;
-		if (cmax == r)
-			h = 60.0f * (g - b)/delta;
-		else if (cmax == g)
-			h = 60.0f * ((b - r)/delta + 2);
-		else
-			h = 60.0f * ((r -g)/delta + 4);
-
-		while (h < 0.0f)
-			h += 360.0f;
-		while (h > 360.0f)
-			h -= 360.0f;
-
-		float s;
-		// Should use ulps, but we'll live for now
-		if (isZero(delta))
-			s = 0;
-		else
-			s = delta / cmax;
-
-		float v = cmax;
-
-		pix[0] = (uint8_t)(h / 360.0f * 255.0f);
-		pix[1] = (uint8_t)(s * 255.0f);
-		pix[2] = (uint8_t)(v * 255.0f);
-		pix += 3;
+} // end anonymous namespace
+
+VideoFrame::VideoFrame(uint8_t* pix, size_t w, size_t h, size_t d, bool makeCopy, size_t srcPitch)
+	: pixels(pix),
+	  width(w),
+	  height(h),
+	  depth(d),
+	  bytesPerPixel(d),
+	  pitch(srcPitch != 0 ? srcPitch : w * d),
+	  totalSize(h == 0 ? 0 : pitch * (h - 1) + w * d),
+	  layout(FL_PACKED)
+{
+	if (makeCopy) {
+		allocate();
+		for (size_t y = 0; y < height; ++y)
+			memcpy(getPixel(0, y), pix + y * (srcPitch != 0 ? srcPitch : w * d), width * depth);
 	}
 }
 
-void VideoFrame::crosshairsAt(Point p, std::array<uint8_t, 3> color, int radius)
+VideoFrame::VideoFrame(size_t w, size_t h, size_t d, bool zero, FrameLayout l)
+	: pixels(nullptr),
+	  width(w),
+	  height(h),
+	  depth(d),
+	  layout(l)
 {
-	if (depth != 3)
-		throw Exceptions::ArgumentException("The frame must be 24-bit RGB", __FUNCTION__);
+	if (layout == FL_ALIGNED_RGBX && depth != 3)
+		throw Exceptions::ArgumentException("Only 3-byte pixels can be padded", __FUNCTION__);
 
-	if (p.x < 0 || p.x >= (int)width || p.y < 0 || p.y >= (int)height)
-		throw Exceptions::ArgumentException("Invalid point", __FUNCTION__);
+	allocate();
+	if (zero || bytesPerPixel != depth)
+		memset(pixels, 0, pitch * height);
+}
+
+VideoFrame::VideoFrame(const VideoFrame& other)
+	: pixels(nullptr),
+	  width(other.width),
+	  height(other.height),
+	  depth(other.depth),
+	  layout(other.layout),
+	  frameID(other.frameID),
+	  duplicate(other.duplicate),
+	  captureTime(other.captureTime)
+{
+	allocate();
+	for (size_t y = 0; y < height; ++y)
+		memcpy(getPixel(0, y), other.getPixel(0, y), width * bytesPerPixel);
+}
+
+VideoFrame::VideoFrame(const VideoFrame& parent, Rectangle r, bool alignLeft)
+	: depth(parent.depth),
+	  bytesPerPixel(parent.bytesPerPixel),
+	  pitch(parent.pitch),
+	  layout(parent.layout),
+	  frameID(parent.frameID),
+	  duplicate(parent.duplicate),
+	  captureTime(parent.captureTime)
+{
+	if (r.left > r.right || r.top > r.bottom || r.left < 0 || r.top < 0 ||
+	    r.right >= (int)parent.width || r.bottom >= (int)parent.height)
+		throw Exceptions::ArgumentException("The view must lie within the frame", __FUNCTION__);
+
+	if (alignLeft && parent.isAligned()) {
+		while (((size_t)r.left * bytesPerPixel) % alignment != 0)
+			--r.left;
+	}
+
+	// Alias the storage, so the view keeps all of it alive but points at its own corner
+	pixels = const_cast<uint8_t*>(parent.getPixel((size_t)r.left, (size_t)r.top));
+	storage = std::shared_ptr<uint8_t>(parent.storage, pixels);
+	width = (size_t)r.getWidth();
+	height = (size_t)r.getHeight();
+	totalSize = pitch * (height - 1) + width * bytesPerPixel;
+	origin = parent.toParent(Point(r.left, r.top));
+	isAView = true;
+}
+
+void VideoFrame::allocate()
+{
+	bytesPerPixel = layout == FL_ALIGNED_RGBX ? 4 : depth;
+	pitch = width * bytesPerPixel;
+	if (layout != FL_PACKED)
+		pitch = roundUp(pitch, alignment);
+
+	void* memory;
+	if (posix_memalign(&memory, alignment, std::max<size_t>(pitch * height, 1)) != 0)
+		throw std::bad_alloc();
+
+	storage.reset((uint8_t*)memory, free);
+	pixels = storage.get();
+	totalSize = height == 0 ? 0 : pitch * (height - 1) + width * bytesPerPixel;
+}
+
+std::shared_ptr<VideoFrame> VideoFrame::view(const Rectangle& r, bool alignLeft)
+{
+	return std::shared_ptr<VideoFrame>(new VideoFrame(*this, r, alignLeft));
+}
+
+void VideoFrame::wipe(int memsetTo)
+{
+	if (isContiguous()) {
+		memset(pixels, memsetTo, totalSize);
+		return;
+	}
 
-	const size_t left = (size_t)std::max(p.x - radius, 0);
-	const size_t top = (size_t)std::max(p.y - radius, 0);
-	const size_t right = (size_t)std::min(p.x + radius, (int)width - 1);
-	const size_t bottom = (size_t)std::min(p.y + radius, (int)height - 1);
+	for (size_t y = 0; y < height; ++y)
+		memset(getPixel(0, y), memsetTo, width * bytesPerPixel);
+}
+
+VideoFrame& VideoFrame::operator= (const VideoFrame& other)
+{
+	if (width != other.width || height != other.height || depth != other.depth)
+		throw Exceptions::InvalidOperationException("To copy from one frame to another,"
+		                                            " frames must be the same dimensions.",
+		                                            __FUNCTION__);
+
+	if (this == &other)
+		return *this;
+
+	for (size_t y = 0; y < height; ++y) {
+		if (bytesPerPixel == other.bytesPerPixel) {
+			memmove(getPixel(0, y), other.getPixel(0, y), width * bytesPerPixel);
+			continue;
+		}
 
-	for (size_t y = top; y < (size_t)p.y; ++y) {
-		auto pix = getPixel((size_t)p.x, y);
-		pix[0] = color[0];
-		pix[1] = color[1];
-		pix[2] = color[2];
+		// One of them has padded pixels, so go a pixel at a time and leave the padding alone
+		uint8_t* to = getPixel(0, y);
+		const uint8_t* from = other.getPixel(0, y);
+		for (size_t x = 0; x < width; ++x, to += bytesPerPixel, from += other.bytesPerPixel)
+			memcpy(to, from, depth);
 	}
+	return *this;
+}
+
+void VideoFrame::rgb2hsv()
+{
+	if (depth != 3 || !hasPackedPixels())
+		throw Exceptions::ArgumentException("The frame must be packed 24-bit RGB", __FUNCTION__);
 
-	for (size_t x = left; x <= right; ++x) {
-		auto pix = getPixel(x, (size_t)p.y);
-		pix[0] = color[0];
-		pix[1] = color[1];
-		pix[2] = color[2];
+	for (size_t y = 0; y < height; ++y) {
+		uint8_t* row = getPixel(0, y);
+		rgb2hsvRow(row, row, width);
 	}
+}
+
+void VideoFrame::rgb2hsv(VideoFrame& dst) const
+{
+	if (depth != 3 || dst.depth != 3 || !hasPackedPixels() || !dst.hasPackedPixels())
+		throw Exceptions::ArgumentException("The frames must be packed 24-bit", __FUNCTION__);
+
+	if (dst.width != width || dst.height != height)
+		throw Exceptions::ArgumentException("The frames must be the same dimensions", __FUNCTION__);
 
-	for (size_t y = p.y + 1; y <= bottom; ++y) {
-		auto pix = getPixel((size_t)p.x, y);
-		pix[0] = color[0];
-		pix[1] = color[1];
-		pix[2] = color[2];
+	for (size_t y = 0; y < height; ++y)
+		rgb2hsvRow(getPixel(0, y), dst.getPixel(0, y), width);
+}
+
+uint64_t VideoFrame::contentHash() const
+{
+	// Four independent lanes so the multiplies overlap instead of waiting on each other
+	uint64_t lanes[4] = { 1, 2, 3, 4 };
+	const size_t rowBytes = width * bytesPerPixel;
+
+	for (size_t y = 0; y < height; ++y) {
+		const uint8_t* row = getPixel(0, y);
+		size_t i = 0;
+		for (; i + 32 <= rowBytes; i += 32) {
+			uint64_t w[4];
+			memcpy(w, row + i, sizeof(w));
+			for (int l = 0; l < 4; ++l)
+				lanes[l] = mixWord(lanes[l], w[l]);
+		}
+		for (; i < rowBytes; ++i)
+			lanes[0] = mixWord(lanes[0], row[i]);
 	}
+
+	uint64_t h = (uint64_t)width << 32 | height;
+	for (int l = 0; l < 4; ++l)
+		h = mixWord(h, lanes[l]);
+	return h ^ (h >> 31);
+}
+
+void VideoFrame::crosshairsAt(Point p, std::array<uint8_t, 3> color, int radius)
+{
+	if (depth != 3)
+		throw Exceptions::ArgumentException("The frame must be 24-bit RGB", __FUNCTION__);
+
+	if (p.x < 0 || p.x >= (int)width || p.y < 0 || p.y >= (int)height)
+		throw Exceptions::ArgumentException("Invalid point", __FUNCTION__);
+
+	fillRectangle(*this, Rectangle(p.x, p.y - radius, p.x, p.y + radius), color);
+	fillRectangle(*this, Rectangle(p.x - radius, p.y, p.x + radius, p.y), color);
 }
 
 void VideoFrame::rectangleAt(Rectangle r, std::array<uint8_t, 3> color)
@@ -90,17 +244,5 @@ void VideoFrame::rectangleAt(Rectangle r, std::array<uint8_t, 3> color)
 	if (depth != 3)
 		throw Exceptions::ArgumentException("The frame must be 24-bit RGB", __FUNCTION__);
 
-	const size_t left = (size_t)std::max(r.left, 0);
-	const size_t top = (size_t)std::max(r.top, 0);
-	const size_t right = (size_t)std::min(r.right, (int)width - 1);
-	const size_t bottom = (size_t)std::min(r.bottom, (int)height - 1);
-
-	for (size_t y = top; y <= bottom; ++y) {
-		uint8_t* pixel = getPixel((size_t)left, (size_t)y);
-		for (size_t x = left; x <= right; ++x, pixel +=3) {
-			pixel[0] = color[0];
-			pixel[1] = color[1];
-			pixel[2] = color[2];
-		}
-	}
+	fillRectangle(*this, r, color);
 }
@@ -2,15 +2,39 @@
 #define __VIDEO_FRAME_HPP__
 
 #include <array>
+#include <chrono>
+#include <cstdint>
 #include <cstring>
+#include <memory>
 
 #include "Exceptions.hpp"
 #include "Rectangle.hpp"
 
-/// A frame of video with a width, height, depth, and data
+/// How a frame's rows and pixels are laid out in memory
+enum FrameLayout {
+	FL_PACKED, ///< Each row directly follows the last
+	FL_ALIGNED, ///< Each row starts on a VideoFrame::alignment byte boundary, with padding at the end of the row
+	FL_ALIGNED_RGBX ///< Like FL_ALIGNED, with each 3-byte pixel padded out to 4 bytes by a trailing zero
+};
+
+/**
+ * \brief A frame of video with a width, height, depth, and data
+ *
+ * Rows are getPitch() bytes apart and pixels are getBytesPerPixel() bytes apart, either of which can include
+ * padding depending on the frame's layout. Code that walks a frame should step by those instead of assuming
+ * width * depth. Frames own their pixels unless created from someone else's.
+ *
+ * A view is a frame that shares a rectangle of another frame's pixels, keeping them alive for as long as
+ * the view is. Views are cheap enough to make on the stack for each search, and since they're frames,
+ * anything that takes a frame takes a view. Results come back in the view's coordinates;
+ * toParent and fromParent convert to and from the coordinates of the frame that owns the pixels.
+ */
 class VideoFrame {
 public:
 
+	/// Every allocation is aligned to this many bytes, as are the rows of aligned layouts
+	static const size_t alignment = 64;
+
 	/**
 	 * \brief Creates a frame from existing pixel data.
 	 * \param pix The pixel data on which to base the frame
@@ -19,21 +43,9 @@ public:
 	 * \param d Byte depth of each pixel
 	 * \param makeCopy true to make a copy of the data. If this is false, the frame is not responsible for managing
 	 *                 the pixel memory
+	 * \param srcPitch The distance between rows of pix in bytes, or 0 if they're packed
 	 */
-	VideoFrame(uint8_t* pix, size_t w, size_t h, size_t d, bool makeCopy)
-		: pixels(pix),
-		  width(w),
-		  height(h),
-		  depth(d),
-		  pitch(w * d),
-		  totalSize(w * h * d),
-		  ownsPixels(makeCopy)
-	{
-		if (makeCopy) {
-			pixels = new uint8_t[width * height * depth];
-			memcpy(pixels, pix, totalSize);
-		}
-	}
+	VideoFrame(uint8_t* pix, size_t w, size_t h, size_t d, bool makeCopy, size_t srcPitch = 0);
 
 	/**
 	 * \brief Creates a blank frame, memset with the given value
@@ -41,71 +53,114 @@ public:
 	 * \param h Height of the frame
 	 * \param d Byte depth of each pixel
 	 * \param zero True to zero the frame, otherwise leave it uninitialized.
+	 *             The padding of FL_ALIGNED_RGBX pixels is zeroed either way.
+	 * \param l How to lay the rows and pixels out
 	 */
-	VideoFrame(size_t w, size_t h, size_t d, bool zero = true)
-		: pixels(nullptr),
-		  width(w),
-		  height(h),
-		  depth(d),
-		  pitch(w * d),
-		  totalSize(w * h * d),
-		  ownsPixels(true)
-	{
-		pixels = new uint8_t[totalSize];
-		if (zero)
-			memset(pixels, 0, totalSize);
-	}
+	VideoFrame(size_t w, size_t h, size_t d, bool zero = true, FrameLayout l = FL_PACKED);
 
-	/// Constructs a video frame from another frame
-	VideoFrame(const VideoFrame& other)
-		: pixels(nullptr),
-		  width(other.width),
-		  height(other.height),
-		  depth(other.depth),
-		  pitch(other.pitch),
-		  totalSize(other.totalSize),
-		  ownsPixels(true)
-	{
-		pixels = new uint8_t[totalSize];
-		memcpy(pixels, other.pixels, totalSize);
-	}
+	/// Constructs a video frame from another frame, with the same layout (but its own, unpadded memory if a view)
+	VideoFrame(const VideoFrame& other);
 
-	virtual ~VideoFrame() { if(ownsPixels) delete[] pixels; }
+	/**
+	 * \brief Creates a view of part of another frame, sharing its pixels without copying them
+	 * \param parent The frame to view, which may itself be a view
+	 * \param r The part to share, in the parent's coordinates. It must lie within the parent.
+	 * \param alignLeft true to move the left edge left (by up to alignment bytes' worth of pixels)
+	 *                  so that each row of the view starts on an aligned address, if the parent's rows do
+	 *
+	 * Writes through either frame are seen by the other. Frame IDs, capture times, and the like are copied.
+	 * Like QImage over const data, a view of a const frame should only be read through.
+	 */
+	VideoFrame(const VideoFrame& parent, Rectangle r, bool alignLeft = false);
 
-	/// Memsets the frame to a given value (or a default of 0)
-	void wipe(int memsetTo = 0)
-	{
-		memset(pixels, memsetTo, totalSize);
-	}
+	virtual ~VideoFrame() { }
+
+	/// Creates a view (see the view constructor) on the heap, e.g. to hand to another thread
+	std::shared_ptr<VideoFrame> view(const Rectangle& r, bool alignLeft = false);
+
+	/// Where this frame's top-left pixel is in the frame that owns its pixels, which is (0, 0) unless it's a view
+	Point getOrigin() const { return origin; }
+
+	/// True if this frame shares another frame's pixels
+	bool isView() const { return isAView; }
+
+	/// True if any other frame (a view of this one, say) shares this frame's pixels
+	bool hasSharedPixels() const { return storage.use_count() > 1; }
+
+	/// Converts from this frame's coordinates to those of the frame that owns its pixels
+	Point toParent(Point p) const { return Point(p.x + origin.x, p.y + origin.y); }
+
+	Rectangle toParent(Rectangle r) const
+	{ return Rectangle(r.left + origin.x, r.top + origin.y, r.right + origin.x, r.bottom + origin.y); }
+
+	/// Converts from the coordinates of the frame that owns this frame's pixels to this frame's
+	Point fromParent(Point p) const { return Point(p.x - origin.x, p.y - origin.y); }
+
+	Rectangle fromParent(Rectangle r) const
+	{ return Rectangle(r.left - origin.x, r.top - origin.y, r.right - origin.x, r.bottom - origin.y); }
+
+	/// Memsets the frame's rows to a given value (or a default of 0)
+	void wipe(int memsetTo = 0);
 
 	// All of these are project-specific. Move them somewhere else, someday.
 
+	/// Converts the frame from RGB to HSV in place. See HSVConversion.hpp for the scaling of each channel.
 	void rgb2hsv();
 
+	/// Writes an HSV version of this RGB frame to dst, which must be the same size
+	void rgb2hsv(VideoFrame& dst) const;
+
 	void crosshairsAt(Point p, std::array<uint8_t, 3> color, int radius);
 
 	void rectangleAt(Rectangle r, std::array<uint8_t, 3> color);
 
 	// Currently too lazy/sleep-deprived to write a proper iterator class.
 	// Also wondering how I would do so if it needs to be default constructible and we need the depth.
+	// Anything hot should use foreachRow instead, since a call per pixel keeps the compiler from vectorizing.
 	template <typename T>
 	void foreachPixel(T iteration) const
 	{
-		int x = 0;
-		int y = 0;
-		const uint8_t* const end = pixels + totalSize;
+		for (size_t y = 0; y < height; ++y) {
+			const uint8_t* currentPixel = getPixel(0, y);
+			for (size_t x = 0; x < width; ++x, currentPixel += bytesPerPixel) {
+				if (!iteration(currentPixel, (int)x, (int)y))
+					return;
+			}
+		}
+	}
 
-		for (const uint8_t* currentPixel = pixels; currentPixel < end; currentPixel += depth) {
-			if (!iteration(currentPixel, x, y))
-				break;
+	/**
+	 * \brief Calls iteration(row, width, y) with the first pixel of each row, until it returns false
+	 *
+	 * Step is the number of bytes between pixels, which must be getBytesPerPixel(): 3 for packed RGB
+	 * or 4 for FL_ALIGNED_RGBX. Since it's a constant, the callback's loop along the row
+	 * (x * Step from row) compiles to fixed-stride code the compiler can unroll and vectorize.
+	 * Code taking either kind of frame picks the specialization once, with hasPackedPixels().
+	 */
+	template <size_t Step, typename T>
+	void foreachRow(T iteration) const
+	{
+		static_assert(Step == 3 || Step == 4, "RGB frames have 3 or 4 bytes per pixel");
+		checkStep(Step, __FUNCTION__);
+		for (size_t y = 0; y < height; ++y) {
+			if (!iteration(getPixel(0, y), width, y))
+				return;
+		}
+	}
 
-			if (++x == width) {
-				x = 0;
-				++y;
-			}
+	/// Like the const foreachRow, with rows that can be written to
+	template <size_t Step, typename T>
+	void foreachRow(T iteration)
+	{
+		static_assert(Step == 3 || Step == 4, "RGB frames have 3 or 4 bytes per pixel");
+		checkStep(Step, __FUNCTION__);
+		for (size_t y = 0; y < height; ++y) {
+			if (!iteration(getPixel(0, y), width, y))
+				return;
 		}
 	}
 
+	/// Gets the first pixel of the frame. Rows are getPitch() bytes apart.
 	uint8_t* getPixels() { return pixels; }
 
 	const uint8_t* getPixels() const { return pixels; }
@@ -113,12 +168,12 @@ public:
 	/// Gets a pixel at a given coordinate
 	/// \warning Does not do bounds checking
 	/// \returns The address of the first byte of the given pixel
-	uint8_t* getPixel(size_t x, size_t y) { return &pixels[(y * width + x) * depth]; }
+	uint8_t* getPixel(size_t x, size_t y) { return &pixels[y * pitch + x * bytesPerPixel]; }
 
 	/// Gets a pixel at a given coordinate
 	/// \warning Does not do bounds checking
 	/// \returns The address of the first byte of the given pixel
-	const uint8_t* getPixel(size_t x, size_t y) const { return &pixels[(y * width + x) * depth]; }
+	const uint8_t* getPixel(size_t x, size_t y) const { return &pixels[y * pitch + x * bytesPerPixel]; }
 
 	size_t getWidth() const { return width; }
 
@@ -126,33 +181,79 @@ public:
 
 	size_t getDepth() const { return depth; }
 
+	/// The distance between the starts of two rows, in bytes
 	size_t getPitch() const { return pitch; }
 
-	/// Returns the image's size, in bytes
+	/// Returns the number of bytes from the first pixel to the end of the last, padding included
 	size_t getTotalSize() const {return totalSize; }
 
-	size_t getBytesPerPixel() const { return depth; }
+	/// The distance between two pixels in a row, which is the depth unless pixels are padded
+	size_t getBytesPerPixel() const { return bytesPerPixel; }
 
-	VideoFrame& operator= (const VideoFrame& other)
-	{
-		if (width != other.width || height != other.height || depth != other.depth)
-			throw Exceptions::InvalidOperationException("To copy from one frame to another,"
-			                                            " frames must be the same dimensions.",
-			                                            __FUNCTION__);
+	/// True if pixels are depth bytes apart, as most of the detection code expects
+	bool hasPackedPixels() const { return bytesPerPixel == depth; }
 
-		memcpy(pixels, other.pixels, totalSize);
-		return *this;
-	}
+	/// True if rows directly follow each other, so the frame is one block of getTotalSize() bytes
+	bool isContiguous() const { return pitch == width * bytesPerPixel; }
+
+	/// True if the first pixel and every row start on an aligned address
+	bool isAligned() const { return (uintptr_t)pixels % alignment == 0 && pitch % alignment == 0; }
+
+	/// The layout the frame was created with, which copies of it keep. Frames over someone else's pixels report FL_PACKED.
+	FrameLayout getLayout() const { return layout; }
+
+	/// An increasing number identifying where this frame came from in the capture stream (0 if unknown)
+	uint64_t getFrameID() const { return frameID; }
+
+	void setFrameID(uint64_t id) { frameID = id; }
+
+	/// True if the capturer found this frame to be identical to the one captured before it
+	bool isDuplicate() const { return duplicate; }
+
+	void setDuplicate(bool dup) { duplicate = dup; }
+
+	/// When the screen was grabbed for this frame (the epoch if unknown)
+	std::chrono::steady_clock::time_point getCaptureTime() const { return captureTime; }
+
+	void setCaptureTime(std::chrono::steady_clock::time_point t) { captureTime = t; }
+
+	/**
+	 * \brief Returns a fast (non-cryptographic) hash of the frame's pixels
+	 *
+	 * Meant for spotting frames identical to the last one, so it runs at close to memory bandwidth.
+	 * The padding of padded pixels is included, but not the padding at the ends of rows.
+	 */
+	uint64_t contentHash() const;
+
+	/// Copies the pixels of another frame of the same dimensions into this one, whatever their layouts
+	VideoFrame& operator= (const VideoFrame& other);
 
 private:
 
+	/// Allocates pixels for the frame's size and layout
+	void allocate();
+
+	/// Throws if a foreachRow specialization doesn't match the frame's pixels
+	void checkStep(size_t step, const char* function) const
+	{
+		if (step != bytesPerPixel)
+			throw Exceptions::ArgumentException("The pixel step does not match the frame", function);
+	}
+
+	std::shared_ptr<uint8_t> storage; ///< Owns the pixels (unless they're someone else's). Views share it.
 	uint8_t* pixels;
 	size_t width;
 	size_t height;
 	size_t depth;
+	size_t bytesPerPixel;
 	size_t pitch;
 	size_t totalSize;
-	bool ownsPixels;
+	FrameLayout layout;
+	Point origin = Point(0, 0);
+	bool isAView = false;
+	uint64_t frameID = 0;
+	bool duplicate = false;
+	std::chrono::steady_clock::time_point captureTime;
 
 };
 
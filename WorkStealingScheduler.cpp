@@ -0,0 +1,113 @@
+#include "WorkStealingScheduler.hpp"
+
+#include <algorithm>
+#include <thread>
+
+#include "Exceptions.hpp"
+
+using namespace std;
+
+WorkStealingScheduler::WorkStealingScheduler(size_t threads)
+	: threadCount(threads > 0 ? threads : max(1u, thread::hardware_concurrency())),
+	  shares(new Share[threadCount]),
+	  abort(false),
+	  steals(0)
+{ }
+
+void WorkStealingScheduler::run(size_t count, size_t chunk, const Body& body)
+{
+	if (chunk == 0)
+		throw Exceptions::ArgumentException("Chunks must hold at least one item", __FUNCTION__);
+
+	for (size_t t = 0; t < threadCount; ++t) {
+		shares[t].begin = count * t / threadCount;
+		shares[t].end = count * (t + 1) / threadCount;
+	}
+	abort = false;
+	steals = 0;
+	firstError = nullptr;
+
+	// The calling thread does its share too
+	vector<thread> workers;
+	workers.reserve(threadCount - 1);
+	for (size_t t = 1; t < threadCount; ++t)
+		workers.emplace_back(&WorkStealingScheduler::workerProc, this, t, chunk, cref(body));
+	workerProc(0, chunk, body);
+	for (auto& w : workers)
+		w.join();
+
+	if (firstError)
+		rethrow_exception(firstError);
+}
+
+void WorkStealingScheduler::workerProc(size_t thread, size_t chunk, const Body& body)
+{
+	try {
+		size_t begin, end;
+		while (!abort.load(memory_order_relaxed)) {
+			if (takeOwn(thread, chunk, begin, end))
+				body(begin, end, thread);
+			else if (!steal(thread))
+				return;
+		}
+	}
+	catch (...) {
+		lock_guard<mutex> guard(errorLock);
+		if (!firstError)
+			firstError = current_exception();
+		abort = true;
+	}
+}
+
+bool WorkStealingScheduler::takeOwn(size_t thread, size_t chunk, size_t& begin, size_t& end)
+{
+	Share& own = shares[thread];
+	lock_guard<mutex> guard(own.lock);
+	if (own.begin == own.end)
+		return false;
+	begin = own.begin;
+	end = min(own.end, own.begin + chunk);
+	own.begin = end;
+	return true;
+}
+
+bool WorkStealingScheduler::steal(size_t thread)
+{
+	for (;;) {
+		size_t victim = thread;
+		size_t most = 0;
+		for (size_t t = 0; t < threadCount; ++t) {
+			if (t == thread)
+				continue;
+			lock_guard<mutex> guard(shares[t].lock);
+			const size_t left = shares[t].end - shares[t].begin;
+			if (left > most) {
+				most = left;
+				victim = t;
+			}
+		}
+		// Anything not in a share has been taken by someone, so this thread is done
+		if (victim == thread)
+			return false;
+
+		size_t begin, end;
+		{
+			Share& from = shares[victim];
+			lock_guard<mutex> guard(from.lock);
+			const size_t left = from.end - from.begin;
+			if (left == 0)
+				continue; // Its owner or another thief got there first
+			// Take the back half, leaving the owner the part it's about to get to
+			end = from.end;
+			begin = end - (left + 1) / 2;
+			from.end = begin;
+		}
+
+		Share& own = shares[thread];
+		lock_guard<mutex> guard(own.lock);
+		own.begin = begin;
+		own.end = end;
+		steals.fetch_add(1, memory_order_relaxed);
+		return true;
+	}
+}
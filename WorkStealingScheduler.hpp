@@ -0,0 +1,76 @@
+#ifndef __WORK_STEALING_SCHEDULER_HPP__
+#define __WORK_STEALING_SCHEDULER_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * \brief Runs independent pieces of work, numbered 0 through n - 1, on every core
+ *
+ * Each thread starts out owning an equal, contiguous share of the numbers, and works through its share from
+ * the front, a chunk at a time. That keeps each thread on neighboring items (e.g. consecutive frames of a
+ * recording, so its reads stay sequential). A thread that runs out steals the back half of the share of
+ * whichever thread has the most left, so threads that got slow items (or a slow core) don't hold everyone up.
+ *
+ * Shares are only ever locked by their owner taking a chunk and by a thief splitting them, so with chunks
+ * of more than a trivial amount of work, the threads hardly ever wait on each other.
+ */
+class WorkStealingScheduler {
+
+public:
+
+	/// Called with a chunk [begin, end) to do, and the index of the thread doing it (below getThreadCount())
+	typedef std::function<void(size_t begin, size_t end, size_t thread)> Body;
+
+	/// \param threads How many threads to run on, or 0 for one per core
+	explicit WorkStealingScheduler(size_t threads = 0);
+
+	size_t getThreadCount() const { return threadCount; }
+
+	/**
+	 * \brief Does all of [0, count), returning once it's done
+	 * \param chunk How many items a thread takes at a time
+	 *
+	 * If body throws, the other threads finish what they've taken and stop, and the first exception thrown
+	 * is rethrown here.
+	 */
+	void run(size_t count, size_t chunk, const Body& body);
+
+	/// How many times a thread stole work in the last run
+	size_t getSteals() const { return steals.load(std::memory_order_relaxed); }
+
+	WorkStealingScheduler(const WorkStealingScheduler&) = delete;
+	WorkStealingScheduler& operator=(const WorkStealingScheduler&) = delete;
+
+private:
+
+	/// What's left of one thread's share, padded so that neighboring shares are never on the same cache line
+	struct Share {
+		std::mutex lock;
+		size_t begin = 0;
+		size_t end = 0;
+		char padding[64];
+	};
+
+	void workerProc(size_t thread, size_t chunk, const Body& body);
+
+	/// Takes the next chunk of a thread's own share, returning false if it's empty
+	bool takeOwn(size_t thread, size_t chunk, size_t& begin, size_t& end);
+
+	/// Moves half of the fullest other share into a thread's own, returning false if there's nothing left
+	bool steal(size_t thread);
+
+	const size_t threadCount;
+	std::unique_ptr<Share[]> shares;
+	std::atomic<bool> abort;
+	std::atomic<size_t> steals;
+	std::exception_ptr firstError;
+	std::mutex errorLock;
+};
+
+#endif
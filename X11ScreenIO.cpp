@@ -1,17 +1,32 @@
 #include "X11ScreenIO.hpp"
 #include <cstdint>
+#include <poll.h>
 #include <X11/extensions/XTest.h>
 
 #include "Exceptions.hpp"
+#include "PixelConversion.hpp"
+#include "Trace.hpp"
 
 using namespace std;
 
 X11ScreenIO::X11ScreenIO()
 {
+	// The capture thread, the play thread, and the damage waiter all use Xlib.
+	// This should have already been called before anything else touched Xlib (see main),
+	// but calling it again is harmless.
+	XInitThreads();
+
 	mainDisplay = XOpenDisplay(NULL);
 	if (!mainDisplay)
 		throw Exceptions::IOException("Could not open the default X11 display", __FUNCTION__);
 
+	inputDisplay = XOpenDisplay(NULL);
+	if (!inputDisplay) {
+		XCloseDisplay(mainDisplay);
+		throw Exceptions::IOException("Could not open a second connection to the X11 display", __FUNCTION__);
+	}
+	inputRootWindow = DefaultRootWindow(inputDisplay);
+
 	rootWindow = DefaultRootWindow(mainDisplay);
 	resetFocus();
 	// Throwaway values
@@ -21,25 +36,53 @@ X11ScreenIO::X11ScreenIO()
 
 	if (!XGetGeometry(mainDisplay, rootWindow, &root,
 	                  &x, &y, &screenWidth, &screenHeight, &borderWidth, &depth)) {
+		XCloseDisplay(inputDisplay);
+		XCloseDisplay(mainDisplay);
 		throw Exceptions::IOException("Couldn't get geometry of the default X11 display", __FUNCTION__);
 	}
 	if (depth != 24) {
+		XCloseDisplay(inputDisplay);
+		XCloseDisplay(mainDisplay);
 		throw Exceptions::IOException("This program assumes a 24-bit display."
 		                              " This does not seem to be the case.", __FUNCTION__);
 	}
 	resetFocus();
+
+	// If XDamage isn't around, waitForChange just returns immediately and we fall back to polling.
+	damageDisplay = XOpenDisplay(NULL);
+	int damageErrorBase;
+	// The damage object itself isn't created until the first waitForChange, since nothing else reads its events.
+	// Capturing continuously, they would just pile up on the connection.
+	if (damageDisplay != nullptr && !XDamageQueryExtension(damageDisplay, &damageEventBase, &damageErrorBase)) {
+		XCloseDisplay(damageDisplay);
+		damageDisplay = nullptr;
+	}
 }
 
 X11ScreenIO::~X11ScreenIO()
 {
+	if (damageDisplay != nullptr) {
+		if (damage != None)
+			XDamageDestroy(damageDisplay, damage);
+		XCloseDisplay(damageDisplay);
+	}
+	XCloseDisplay(inputDisplay);
 	XCloseDisplay(mainDisplay);
 }
 
 std::shared_ptr<VideoFrame> X11ScreenIO::getFrame()
 {
-	// Still skewing oddly under circumstances. For now, avoid those. Later, figure out why.
-
-	XImage* img = XGetImage(mainDisplay, rootWindow, 0, 0, screenWidth, screenHeight, AllPlanes, ZPixmap);
+	// Only ask for the focused area. The skew this used to show came from assuming
+	// lines were exactly width * 4 bytes long; xPixelsToRGB honors bytes_per_line instead.
+	XImage* img;
+	const auto captured = chrono::steady_clock::now();
+	{
+		Trace::Span span("XGetImage");
+		img = XGetImage(mainDisplay, rootWindow, capRect.left, capRect.top,
+		                (unsigned int)capRect.getWidth(), (unsigned int)capRect.getHeight(), AllPlanes, ZPixmap);
+	}
+	if (img == nullptr)
+		throw Exceptions::IOException("Could not get an image of the screen", __FUNCTION__);
 	if (img->depth != 24) {
 		throw Exceptions::IOException("This program assumes a 24-bit display."
 		                              " This does not seem to be the case.", __FUNCTION__);
@@ -49,30 +92,24 @@ std::shared_ptr<VideoFrame> X11ScreenIO::getFrame()
 		                              "This does not seem to be the case.", __FUNCTION__);
 	}
 
-	std::shared_ptr<VideoFrame> ret = make_shared<VideoFrame>(capRect.getWidth(), capRect.getHeight(), 3, false);
+	std::shared_ptr<VideoFrame> ret = make_shared<VideoFrame>(capRect.getWidth(), capRect.getHeight(), 3, false,
+	                                                          FL_ALIGNED);
+	ret->setCaptureTime(captured);
 
-	auto curr = ret->getPixels();
-
-	for (int y = 0; y < img->height; ++y) {
-		uint32_t* line_ptr = (uint32_t*) &(img->data)[y * img->bytes_per_line];
-		for (int x = 0; x < img->width; ++x) {
-			if (!capRect.contains(x, y))
-				continue;
-
-			uint32_t pixelvalue = line_ptr[x];
-			curr[0] = (uint8_t)((pixelvalue & 0x00FF0000) >> 16);
-			curr[1] = (uint8_t)((pixelvalue & 0x0000FF00) >> 8);
-			curr[2] = (uint8_t)((pixelvalue & 0x000000FF));
-			curr += 3;
-		}
+	{
+		Trace::Span span("xPixelsToRGB");
+		xPixelsToRGB((const uint8_t*)img->data, img->bytes_per_line,
+		             Rectangle(0, 0, capRect.getWidth() - 1, capRect.getHeight() - 1), *ret);
 	}
+
 	XDestroyImage(img);
 	return ret;
 }
 
 void X11ScreenIO::focusOn(const Rectangle& r)
 {
-	if (r.left >= r.right || r.top >= r.bottom || r.left < 0 || r.top < 0)
+	if (r.left >= r.right || r.top >= r.bottom || r.left < 0 || r.top < 0 ||
+	    r.right >= (int)screenWidth || r.bottom >= (int)screenHeight)
 		throw Exceptions::ArgumentException("Invalid bounds", __FUNCTION__);
 
 	capRect = r;
@@ -87,14 +124,70 @@ void X11ScreenIO::resetFocus()
 }
 
 
+bool X11ScreenIO::waitForChange(std::chrono::milliseconds timeout)
+{
+	if (damageDisplay == nullptr)
+		return true;
+
+	Trace::Span span("waitForChange");
+	if (damage == None) {
+		// Raw rectangles so that we can check each one against the focused area ourselves.
+		// They also don't need to be acknowledged with XDamageSubtract.
+		damage = XDamageCreate(damageDisplay, DefaultRootWindow(damageDisplay), XDamageReportRawRectangles);
+		XFlush(damageDisplay);
+	}
+
+	const auto deadline = chrono::steady_clock::now() + timeout;
+	bool changed = false;
+
+	while (true) {
+		// Drain everything that's queued so that a burst of damage only wakes us once
+		while (XPending(damageDisplay) > 0) {
+			XEvent ev;
+			XNextEvent(damageDisplay, &ev);
+			if (ev.type != damageEventBase + XDamageNotify)
+				continue;
+
+			const XDamageNotifyEvent* de = reinterpret_cast<const XDamageNotifyEvent*>(&ev);
+			const Rectangle area(de->area.x, de->area.y,
+			                     de->area.x + de->area.width - 1, de->area.y + de->area.height - 1);
+			if (area.left <= capRect.right && area.right >= capRect.left
+			    && area.top <= capRect.bottom && area.bottom >= capRect.top)
+				changed = true;
+		}
+
+		if (changed)
+			return true;
+
+		const auto remaining = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now());
+		if (remaining.count() <= 0)
+			return false;
+
+		pollfd pfd;
+		pfd.fd = ConnectionNumber(damageDisplay);
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		poll(&pfd, 1, (int)remaining.count());
+	}
+}
+
+Rectangle X11ScreenIO::getScreenBounds() const
+{
+	return Rectangle(0, 0, (int)screenWidth - 1, (int)screenHeight - 1);
+}
+
 void X11ScreenIO::mouseTo(int x, int y)
 {
-	XWarpPointer(mainDisplay, None, rootWindow, 0, 0, 0, 0, x, y);
-	XFlush(mainDisplay);
+	XWarpPointer(inputDisplay, None, inputRootWindow, 0, 0, 0, 0, x, y);
+	XFlush(inputDisplay);
 }
 
-void X11ScreenIO::click()
+std::chrono::steady_clock::time_point X11ScreenIO::click()
 {
-	XTestFakeButtonEvent(mainDisplay, 1, true, CurrentTime);
-	XTestFakeButtonEvent(mainDisplay, 1, false, CurrentTime);
+	Trace::Span span("click");
+	XTestFakeButtonEvent(inputDisplay, 1, true, CurrentTime);
+	XTestFakeButtonEvent(inputDisplay, 1, false, CurrentTime);
+	// Without this, the events sit in Xlib's buffer until something else happens to flush it
+	XFlush(inputDisplay);
+	return chrono::steady_clock::now();
 }
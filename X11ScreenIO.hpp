@@ -5,6 +5,7 @@
 
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
+#include <X11/extensions/Xdamage.h>
 
 /// An X11 implementation of ScreenIO
 class X11ScreenIO : public ScreenIO {
@@ -22,9 +23,17 @@ public:
 
 	void resetFocus() override;
 
-	void mouseTo(int x, int y);
+	Rectangle getScreenBounds() const override;
 
-	void click();
+	/// Waits for XDamage to report damage inside the focused area, if the server supports the extension
+	bool waitForChange(std::chrono::milliseconds timeout) override;
+
+	/// Returns true if the server supports XDamage, so waitForChange actually waits
+	bool hasDamageEvents() const { return damageDisplay != nullptr; }
+
+	void mouseTo(int x, int y) override;
+
+	std::chrono::steady_clock::time_point click() override;
 
 	// No copy or assign
 	X11ScreenIO(const X11ScreenIO&) = delete;
@@ -32,10 +41,20 @@ public:
 
 private:
 
-	Display* mainDisplay;
+	Display* mainDisplay; ///< Used for captures
 	Window rootWindow;
+
+	// Input gets its own connection, so a click never queues up behind a capture in flight on mainDisplay
+	Display* inputDisplay = nullptr;
+	Window inputRootWindow;
 	unsigned int screenWidth, screenHeight;
 	Rectangle capRect;
+
+	// Damage events get their own connection so that waiting on them
+	// doesn't contend with captures and clicks on mainDisplay.
+	Display* damageDisplay = nullptr;
+	Damage damage = None; ///< Created by the first waitForChange, so only damage that's waited on is reported
+	int damageEventBase = 0;
 };
 
 #endif
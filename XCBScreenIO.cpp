@@ -0,0 +1,280 @@
+#include "XCBScreenIO.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <xcb/xtest.h>
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include "Exceptions.hpp"
+#include "PixelConversion.hpp"
+#include "Trace.hpp"
+
+using namespace std;
+
+namespace {
+
+xcb_screen_t* defaultScreen(xcb_connection_t* c, int screenNumber)
+{
+	xcb_screen_iterator_t it = xcb_setup_roots_iterator(xcb_get_setup(c));
+	for (int i = 0; it.rem > 0; xcb_screen_next(&it), ++i) {
+		if (i == screenNumber)
+			return it.data;
+	}
+	return nullptr;
+}
+
+/// Returns true if depth 24 images are 32 bits per pixel, padded to 32 bits, in little-endian order
+bool hasExpectedPixelFormat(xcb_connection_t* c)
+{
+	const xcb_setup_t* setup = xcb_get_setup(c);
+	if (setup->image_byte_order != XCB_IMAGE_ORDER_LSB_FIRST)
+		return false;
+
+	xcb_format_iterator_t it = xcb_setup_pixmap_formats_iterator(setup);
+	for (; it.rem > 0; xcb_format_next(&it)) {
+		if (it.data->depth == 24)
+			return it.data->bits_per_pixel == 32 && it.data->scanline_pad == 32;
+	}
+	return false;
+}
+
+} // end anonymous namespace
+
+XCBScreenIO::XCBScreenIO()
+{
+	int screenNumber;
+	connection = xcb_connect(nullptr, &screenNumber);
+	if (xcb_connection_has_error(connection)) {
+		xcb_disconnect(connection);
+		throw Exceptions::IOException("Could not connect to the X server", __FUNCTION__);
+	}
+
+	xcb_screen_t* screen = defaultScreen(connection, screenNumber);
+	if (screen == nullptr || screen->root_depth != 24 || !hasExpectedPixelFormat(connection)) {
+		xcb_disconnect(connection);
+		throw Exceptions::IOException("This program assumes a 24-bit display with 32-bit padded pixels."
+		                              " This does not seem to be the case.", __FUNCTION__);
+	}
+	root = screen->root;
+	screenWidth = screen->width_in_pixels;
+	screenHeight = screen->height_in_pixels;
+
+	int inputScreenNumber;
+	inputConnection = xcb_connect(nullptr, &inputScreenNumber);
+	const xcb_query_extension_reply_t* xtest = xcb_connection_has_error(inputConnection) ? nullptr
+	                                         : xcb_get_extension_data(inputConnection, &xcb_test_id);
+	if (xtest == nullptr || !xtest->present) {
+		xcb_disconnect(inputConnection);
+		xcb_disconnect(connection);
+		throw Exceptions::IOException("Could not open an input connection with the XTest extension", __FUNCTION__);
+	}
+	inputRoot = defaultScreen(inputConnection, inputScreenNumber)->root;
+
+	const xcb_query_extension_reply_t* shm = xcb_get_extension_data(connection, &xcb_shm_id);
+	if (shm != nullptr && shm->present) {
+		xcb_shm_query_version_reply_t* version =
+			xcb_shm_query_version_reply(connection, xcb_shm_query_version(connection), nullptr);
+		useShm = version != nullptr;
+		free(version);
+	}
+
+	resetFocus();
+}
+
+XCBScreenIO::~XCBScreenIO()
+{
+	cancelPending();
+	freeBuffers();
+	xcb_disconnect(inputConnection);
+	xcb_disconnect(connection);
+}
+
+std::shared_ptr<VideoFrame> XCBScreenIO::getFrame()
+{
+	if (!pending)
+		request(0);
+
+	const int ready = pendingBuffer;
+	const Rectangle rect = pendingRect;
+	const auto captured = pendingTime;
+	pending = false;
+
+	const uint8_t* data = nullptr;
+	size_t pitch = 0;
+	void* reply;
+	{
+		Trace::Span span("xcb get image reply");
+		xcb_generic_error_t* error = nullptr;
+		if (useShm) {
+			reply = xcb_shm_get_image_reply(connection, shmCookie, &error);
+			data = buffers[ready].data;
+			pitch = (size_t)rect.getWidth() * 4;
+		}
+		else {
+			xcb_get_image_reply_t* plain = xcb_get_image_reply(connection, plainCookie, &error);
+			reply = plain;
+			if (plain != nullptr) {
+				data = xcb_get_image_data(plain);
+				pitch = (size_t)xcb_get_image_data_length(plain) / (size_t)rect.getHeight();
+			}
+		}
+		free(error);
+	}
+	if (reply == nullptr)
+		throw Exceptions::IOException("Could not get an image of the screen", __FUNCTION__);
+
+	// Get the server started on the next image while we convert this one.
+	// That request only touches the other buffer, so data stays put.
+	request(1 - ready);
+
+	std::shared_ptr<VideoFrame> ret = make_shared<VideoFrame>(rect.getWidth(), rect.getHeight(), 3, false, FL_ALIGNED);
+	ret->setCaptureTime(captured);
+	{
+		Trace::Span span("xPixelsToRGB");
+		xPixelsToRGB(data, pitch, Rectangle(0, 0, rect.getWidth() - 1, rect.getHeight() - 1), *ret);
+	}
+
+	free(reply);
+	// If that request gave up on shared memory, the buffer just converted can go now too
+	if (!useShm)
+		freeBuffers();
+	return ret;
+}
+
+void XCBScreenIO::focusOn(const Rectangle& r)
+{
+	if (r.left >= r.right || r.top >= r.bottom || r.left < 0 || r.top < 0 ||
+	    r.right >= screenWidth || r.bottom >= screenHeight)
+		throw Exceptions::ArgumentException("Invalid bounds", __FUNCTION__);
+
+	// Whatever is in flight is for the old rectangle
+	cancelPending();
+	capRect = r;
+}
+
+void XCBScreenIO::resetFocus()
+{
+	cancelPending();
+	capRect = getScreenBounds();
+}
+
+Rectangle XCBScreenIO::getScreenBounds() const
+{
+	return Rectangle(0, 0, screenWidth - 1, screenHeight - 1);
+}
+
+void XCBScreenIO::mouseTo(int x, int y)
+{
+	xcb_warp_pointer(inputConnection, XCB_NONE, inputRoot, 0, 0, 0, 0, (int16_t)x, (int16_t)y);
+	xcb_flush(inputConnection);
+}
+
+std::chrono::steady_clock::time_point XCBScreenIO::click()
+{
+	Trace::Span span("click");
+	xcb_test_fake_input(inputConnection, XCB_BUTTON_PRESS, 1, XCB_CURRENT_TIME, XCB_NONE, 0, 0, 0);
+	xcb_test_fake_input(inputConnection, XCB_BUTTON_RELEASE, 1, XCB_CURRENT_TIME, XCB_NONE, 0, 0, 0);
+	xcb_flush(inputConnection);
+	return chrono::steady_clock::now();
+}
+
+void XCBScreenIO::request(int buffer)
+{
+	const uint16_t w = (uint16_t)capRect.getWidth();
+	const uint16_t h = (uint16_t)capRect.getHeight();
+
+	// Fall back to images in the replies if shared memory doesn't work out, e.g. with a remote server
+	if (useShm && !reserveBuffer(buffers[buffer], (size_t)w * h * 4)) {
+		fprintf(stderr, "Could not share memory with the X server. Falling back to slower captures.\n");
+		useShm = false;
+	}
+
+	if (useShm) {
+		shmCookie = xcb_shm_get_image(connection, root, (int16_t)capRect.left, (int16_t)capRect.top, w, h,
+		                              ~0u, XCB_IMAGE_FORMAT_Z_PIXMAP, buffers[buffer].segment, 0);
+	}
+	else {
+		plainCookie = xcb_get_image(connection, XCB_IMAGE_FORMAT_Z_PIXMAP, root,
+		                            (int16_t)capRect.left, (int16_t)capRect.top, w, h, ~0u);
+	}
+	xcb_flush(connection);
+
+	pending = true;
+	pendingBuffer = buffer;
+	pendingRect = capRect;
+	pendingTime = chrono::steady_clock::now();
+}
+
+void XCBScreenIO::cancelPending()
+{
+	if (!pending)
+		return;
+
+	// Wait for the reply rather than discarding it, so the server is done with the buffer before we touch it again
+	if (useShm)
+		free(xcb_shm_get_image_reply(connection, shmCookie, nullptr));
+	else
+		free(xcb_get_image_reply(connection, plainCookie, nullptr));
+	pending = false;
+}
+
+bool XCBScreenIO::reserveBuffer(ShmBuffer& b, size_t bytes)
+{
+	if (b.size >= bytes)
+		return true;
+
+	if (b.data != nullptr) {
+		xcb_shm_detach(connection, b.segment);
+		shmdt(b.data);
+		b = ShmBuffer();
+	}
+
+	b.id = shmget(IPC_PRIVATE, bytes, IPC_CREAT | 0600);
+	if (b.id < 0) {
+		b = ShmBuffer();
+		return false;
+	}
+
+	void* mapped = shmat(b.id, nullptr, 0);
+	if (mapped == (void*)-1) {
+		shmctl(b.id, IPC_RMID, nullptr);
+		b = ShmBuffer();
+		return false;
+	}
+
+	b.data = (uint8_t*)mapped;
+	b.size = bytes;
+	b.segment = xcb_generate_id(connection);
+
+	xcb_generic_error_t* error = xcb_request_check(connection,
+		xcb_shm_attach_checked(connection, b.segment, (uint32_t)b.id, 0));
+	// Once the server has attached (or failed to), mark the segment for removal, so it can't outlive us.
+	// It stays around until everyone detaches. Marking it any earlier would rely on Linux letting the server
+	// attach a segment that's already marked, which POSIX doesn't promise.
+	shmctl(b.id, IPC_RMID, nullptr);
+	if (error != nullptr) {
+		free(error);
+		shmdt(b.data);
+		b = ShmBuffer();
+		return false;
+	}
+	return true;
+}
+
+void XCBScreenIO::freeBuffers()
+{
+	bool detached = false;
+	for (ShmBuffer& b : buffers) {
+		if (b.data == nullptr)
+			continue;
+		xcb_shm_detach(connection, b.segment);
+		shmdt(b.data);
+		b = ShmBuffer();
+		detached = true;
+	}
+	if (detached)
+		xcb_flush(connection);
+}
@@ -0,0 +1,95 @@
+#ifndef __XCB_SCREEN_IO_HPP__
+#define __XCB_SCREEN_IO_HPP__
+
+#include "ScreenIO.hpp"
+
+#include <xcb/xcb.h>
+#include <xcb/shm.h>
+
+/**
+ * \brief An XCB implementation of ScreenIO which keeps the next capture in flight while converting the last one
+ *
+ * Xlib's XGetImage waits out a full round trip with nothing else going on. Here, as soon as a capture's reply
+ * arrives, the request for the following capture is sent, so the server copies out the next image while we
+ * convert the current one. The catch is that each frame was requested when the previous getFrame returned,
+ * so with a slow consumer it can be that much older than a frame requested on demand.
+ *
+ * Images come through MIT-SHM (double buffered) when the server supports it, and in the replies otherwise.
+ */
+class XCBScreenIO : public ScreenIO {
+
+public:
+
+	XCBScreenIO();
+
+	~XCBScreenIO();
+
+	std::shared_ptr<VideoFrame> getFrame() override;
+
+	/// Focuses in on a certain part of the screen. Future calls to getFrame will just get this portion.
+	void focusOn(const Rectangle& r) override;
+
+	void resetFocus() override;
+
+	Rectangle getScreenBounds() const override;
+
+	void mouseTo(int x, int y) override;
+
+	std::chrono::steady_clock::time_point click() override;
+
+	/// Returns true if images come through shared memory instead of the socket
+	bool usingSharedMemory() const { return useShm; }
+
+	// No copy or assign
+	XCBScreenIO(const XCBScreenIO&) = delete;
+	XCBScreenIO& operator=(const XCBScreenIO&) = delete;
+
+private:
+
+	/// A shared memory segment the server writes images into
+	struct ShmBuffer {
+		int id = -1;
+		uint8_t* data = nullptr;
+		size_t size = 0;
+		xcb_shm_seg_t segment = 0;
+	};
+
+	/// Sends a request for an image of capRect, into the given buffer if using shared memory
+	void request(int buffer);
+
+	/// Waits for and throws away the reply to any request in flight
+	void cancelPending();
+
+	/**
+	 * \brief Makes sure a shared memory buffer holds at least the given number of bytes
+	 *
+	 * Only the buffer being requested into is touched, since the other one may still be being converted.
+	 * \returns false (with that buffer freed) if the memory couldn't be shared with the server
+	 */
+	bool reserveBuffer(ShmBuffer& b, size_t bytes);
+
+	void freeBuffers();
+
+	xcb_connection_t* connection; ///< Used for captures
+	xcb_window_t root;
+
+	// Input gets its own connection, so a click never queues up behind a capture
+	xcb_connection_t* inputConnection = nullptr;
+	xcb_window_t inputRoot;
+
+	int screenWidth, screenHeight;
+	Rectangle capRect;
+
+	bool useShm = false;
+	ShmBuffer buffers[2];
+
+	// The request in flight, if any
+	bool pending = false;
+	int pendingBuffer = 0;
+	Rectangle pendingRect;
+	std::chrono::steady_clock::time_point pendingTime; ///< When the request went out, which dates the image
+	xcb_shm_get_image_cookie_t shmCookie;
+	xcb_get_image_cookie_t plainCookie;
+};
+
+#endif
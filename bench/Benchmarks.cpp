@@ -0,0 +1,1240 @@
+/**
+ * \file Benchmarks.cpp
+ *
+ * Times the detection and conversion kernels in isolation over generated frames at several resolutions.
+ * Output is one line per kernel and resolution, in a fixed order and format, so runs from different versions
+ * can be diffed directly.
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "BirdAI.hpp"
+#include "BitMask.hpp"
+#include "FlapFitter.hpp"
+#include "FlapPlanner.hpp"
+#include "FlappyColors.hpp"
+#include "FlappySearches.hpp"
+#include "FrameArena.hpp"
+#include "FrameRecording.hpp"
+#include "FrameSynthesizer.hpp"
+#include "HSVConversion.hpp"
+#include "PhysicsAnalysis.hpp"
+#include "PixelConversion.hpp"
+#include "RectangleSet.hpp"
+#include "ScreenIO.hpp"
+#include "TileClassifier.hpp"
+#include "VideoFrame.hpp"
+#include "WorkStealingScheduler.hpp"
+
+using namespace std;
+
+namespace {
+
+atomic<size_t> allocationCount(0);
+
+} // end anonymous namespace
+
+// Count every heap allocation so we can report allocations per call.
+void* operator new(size_t size)
+{
+	++allocationCount;
+	void* ret = malloc(size == 0 ? 1 : size);
+	if (ret == nullptr)
+		throw bad_alloc();
+	return ret;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void* p) noexcept { free(p); }
+
+void operator delete[](void* p) noexcept { free(p); }
+
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+typedef chrono::duration<double, nano> DoubleNanoseconds;
+
+/// Options from the command line
+struct Options {
+	size_t pixelBudget = 200 * 1000 * 1000; ///< Approximate number of pixels to push through each case
+	const char* filter = nullptr; ///< Only run kernels whose names contain this
+	bool accuracy = false; ///< Check detection against synthetic ground truth instead of timing
+	bool verify = false; ///< Check the fast kernels against their reference versions instead of timing
+};
+
+const array<uint8_t, 3> desktopRGB = { 60, 60, 60 };
+
+/// A desktop-sized frame with the game somewhere in the middle of it, as seen at startup
+unique_ptr<VideoFrame> makeDesktopFrame(size_t w, size_t h)
+{
+	unique_ptr<VideoFrame> frame(new VideoFrame(w, h, 3));
+	frame->rectangleAt(Rectangle(0, 0, (int)w - 1, (int)h - 1), desktopRGB);
+	const size_t gameHeight = h * 2 / 3;
+	const size_t gameWidth = gameHeight * 5 / 7;
+	FrameSynthesizer synth(gameWidth, gameHeight);
+	synth.render(synth.typicalScene(0, (int)gameHeight / 2), *frame,
+	             Point((int)(w - gameWidth) / 2, (int)(h - gameHeight) / 2));
+	return frame;
+}
+
+/// What X11 hands us: 32 bits per pixel, with some padding at the end of each line
+vector<uint8_t> makeXImage(const VideoFrame& frame, size_t& pitch)
+{
+	pitch = frame.getWidth() * 4 + 64;
+	vector<uint8_t> ret(pitch * frame.getHeight());
+	for (size_t y = 0; y < frame.getHeight(); ++y) {
+		uint32_t* line = (uint32_t*)&ret[y * pitch];
+		for (size_t x = 0; x < frame.getWidth(); ++x) {
+			const uint8_t* pix = frame.getPixel(x, y);
+			line[x] = ((uint32_t)pix[0] << 16) | ((uint32_t)pix[1] << 8) | (uint32_t)pix[2];
+		}
+	}
+	return ret;
+}
+
+/**
+ * \brief Runs a kernel enough times to get a stable measurement and prints a line about it
+ * \param name The kernel's name
+ * \param w Width of the frames the kernel processes
+ * \param h Height of the frames the kernel processes
+ * \param setup Called before each timed call, outside of the timing. Restores any state the kernel modifies.
+ * \param body The kernel call being timed
+ *
+ * The median time per call is reported, since it's less sensitive to the odd preemption than the mean.
+ */
+template <typename S, typename B>
+void run(const Options& opts, const char* name, size_t w, size_t h, S setup, B body)
+{
+	if (opts.filter != nullptr && strstr(name, opts.filter) == nullptr)
+		return;
+
+	const size_t pixels = w * h;
+	const size_t iterations = max<size_t>(5, opts.pixelBudget / pixels);
+
+	vector<double> times;
+	times.reserve(iterations);
+	size_t allocations = 0;
+
+	// Warm up caches and any lazily-initialized statics
+	setup();
+	body();
+
+	for (size_t i = 0; i < iterations; ++i) {
+		setup();
+		const size_t allocsBefore = allocationCount;
+		const auto start = Clock::now();
+		body();
+		const auto end = Clock::now();
+		allocations += allocationCount - allocsBefore;
+		times.emplace_back(DoubleNanoseconds(end - start).count());
+	}
+
+	nth_element(begin(times), begin(times) + times.size() / 2, end(times));
+	const double median = times[times.size() / 2];
+
+	printf("%-24s %5zux%-5zu %10.3f ns/px %12.1f fps %8.2f allocs/call\n",
+	       name, w, h, median / (double)pixels, 1e9 / median, (double)allocations / (double)iterations);
+	fflush(stdout);
+}
+
+/// True if every edge of found is within tol pixels of the corresponding edge of truth
+bool closeTo(const Rectangle& found, const Rectangle& truth, int tol)
+{
+	return abs(found.left - truth.left) <= tol && abs(found.top - truth.top) <= tol &&
+	       abs(found.right - truth.right) <= tol && abs(found.bottom - truth.bottom) <= tol;
+}
+
+/**
+ * \brief Runs the detectors over synthetic frames and reports how often they agree with the ground truth
+ *
+ * Frames sweep the course and the bird's height so pipes and the bird appear everywhere they can in a game.
+ */
+void checkAccuracy(const vector<pair<size_t, size_t>>& sizes)
+{
+	const int framesPerCase = 200;
+	const int tol = 2;
+
+	struct Variant {
+		const char* name;
+		bool antiAlias;
+		int noise;
+	};
+	const Variant variants[] = { { "clean", false, 0 }, { "aa", true, 0 }, { "noise", false, 4 },
+	                             { "aa+noise", true, 4 } };
+
+	for (const auto& size : sizes) {
+		for (const auto& variant : variants) {
+			FrameSynthesizer synth(size.first, size.second, variant.antiAlias);
+			VideoFrame frame(size.first, size.second, 3, false);
+			TileClassifier tiles; // Fed every frame in order, like the play loop does
+
+			int beaks = 0;
+			int birds = 0;
+			int pipes = 0;
+			int floors = 0;
+			int tiledPipes = 0;
+			int columnPipes = 0;
+			int columnFloors = 0;
+			int maskBeaks = 0;
+			int maskBirds = 0;
+			int maskPipes = 0;
+			int maskFloors = 0;
+			BitMask mask;
+
+			for (int i = 0; i < framesPerCase; ++i) {
+				const int scroll = i * synth.getPipeSpacing() / 17;
+				const int birdY = synth.getBirdHeight() +
+				                  (i * 7919) % (synth.getGroundTop() - 2 * synth.getBirdHeight());
+				SyntheticScene scene = synth.typicalScene(scroll, birdY);
+				scene.noise = variant.noise;
+				const SyntheticTruth truth = synth.render(scene, frame);
+
+				const SearchResult<Point> beak = findBeakLocation(frame);
+				if (beak.found()) {
+					if (abs(beak.value.x - truth.beak.x) <= tol && abs(beak.value.y - truth.beak.y) <= tol)
+						++beaks;
+					if (closeTo(findBird(frame, beak.value), truth.bird, tol))
+						++birds;
+				}
+
+				RectangleList found = findPipes(frame);
+				auto matches = [&](const Rectangle& t) {
+					return any_of(begin(found), end(found), [&](const Rectangle& f) { return closeTo(f, t, tol); });
+				};
+				if (matches(truth.floor))
+					++floors;
+				if (all_of(begin(truth.pipes), end(truth.pipes), matches))
+					++pipes;
+
+				tiles.update(frame);
+				found = findPipes(tiles);
+				if (all_of(begin(truth.pipes), end(truth.pipes), matches))
+					++tiledPipes;
+
+				SearchResult<RectangleList> byColumns = findPipesByColumns(frame);
+				if (byColumns.found()) {
+					found = std::move(byColumns.value);
+					if (all_of(begin(truth.pipes), end(truth.pipes), matches))
+						++columnPipes;
+					if (matches(truth.floor))
+						++columnFloors;
+				}
+
+				mask.classify(frame, FlappyColors::isBeakColor);
+				const SearchResult<Point> maskBeak = findBeakLocation(mask);
+				if (maskBeak.found()) {
+					if (abs(maskBeak.value.x - truth.beak.x) <= tol && abs(maskBeak.value.y - truth.beak.y) <= tol)
+						++maskBeaks;
+					mask.classify(frame, FlappyColors::isBirdColor);
+					if (closeTo(findBird(mask, maskBeak.value), truth.bird, tol))
+						++maskBirds;
+				}
+
+				mask.classify(frame, FlappyColors::isPipeColor);
+				found = findPipes(mask);
+				if (all_of(begin(truth.pipes), end(truth.pipes), matches))
+					++maskPipes;
+				if (matches(truth.floor))
+					++maskFloors;
+			}
+
+			printf("accuracy %-9s %5zux%-5zu beak %5.1f%%  bird %5.1f%%  pipes %5.1f%%  floor %5.1f%%"
+			       "  pipes/tiles %5.1f%%  pipes/columns %5.1f%%  floor/columns %5.1f%%"
+			       "  beak/mask %5.1f%%  bird/mask %5.1f%%  pipes/mask %5.1f%%  floor/mask %5.1f%%\n",
+			       variant.name, size.first, size.second,
+			       100.0 * beaks / framesPerCase, 100.0 * birds / framesPerCase,
+			       100.0 * pipes / framesPerCase, 100.0 * floors / framesPerCase,
+			       100.0 * tiledPipes / framesPerCase, 100.0 * columnPipes / framesPerCase,
+			       100.0 * columnFloors / framesPerCase, 100.0 * maskBeaks / framesPerCase,
+			       100.0 * maskBirds / framesPerCase, 100.0 * maskPipes / framesPerCase,
+			       100.0 * maskFloors / framesPerCase);
+			fflush(stdout);
+		}
+	}
+}
+
+/// Checks that the coarse game window search and the border check agree with the exhaustive search on desktops
+void checkGameWindow(const vector<pair<size_t, size_t>>& sizes)
+{
+	for (const auto& size : sizes) {
+		auto desktop = makeDesktopFrame(size.first, size.second);
+		const Rectangle exact = findGameWindow(*desktop).value;
+
+		const SearchResult<Rectangle> coarse = findGameWindowCoarse(*desktop);
+		const bool coarseMatches = coarse.found() && coarse.value.left == exact.left &&
+		                           coarse.value.top == exact.top && coarse.value.right == exact.right &&
+		                           coarse.value.bottom == exact.bottom;
+
+		// The check should pass where the window is, and fail if it is off by a pixel in any direction
+		Rectangle shifted[4] = { exact, exact, exact, exact };
+		shifted[0].left -= 1;
+		shifted[1].top -= 1;
+		shifted[2].right += 1;
+		shifted[3].bottom += 1;
+		int rejected = 0;
+		for (const auto& r : shifted)
+			rejected += isGameWindowAt(*desktop, r) ? 0 : 1;
+
+		printf("accuracy gameWindow %5zux%-5zu coarse %s  border check %s, rejects %d/4 shifted\n",
+		       size.first, size.second, coarseMatches ? "matches" : "DIFFERS",
+		       isGameWindowAt(*desktop, exact) ? "passes" : "FAILS", rejected);
+	}
+	fflush(stdout);
+}
+
+/**
+ * \brief Checks every HSV kernel this CPU supports against the reference kernel over all 2^24 colors
+ * \returns true if every channel of every color is within one step of the reference, and the SIMD kernels
+ *          match the scalar one exactly (they do the same integer math). Hue is compared around the circle,
+ *          so 0 and 254 are two steps apart.
+ */
+bool verifyHSV()
+{
+	const size_t colors = 1 << 24;
+	vector<uint8_t> rgb(colors * 3);
+	for (size_t c = 0; c < colors; ++c) {
+		rgb[c * 3 + 0] = (uint8_t)(c >> 16);
+		rgb[c * 3 + 1] = (uint8_t)(c >> 8);
+		rgb[c * 3 + 2] = (uint8_t)c;
+	}
+
+	vector<uint8_t> expected(colors * 3);
+	getHSVKernel(HK_REFERENCE)(rgb.data(), expected.data(), colors);
+
+	bool ok = true;
+	vector<uint8_t> scalar;
+	vector<uint8_t> actual(colors * 3);
+	for (HSVKernel k : { HK_SCALAR, HK_SSSE3, HK_AVX2 }) {
+		HSVRowFunction kernel = getHSVKernel(k);
+		if (kernel == nullptr) {
+			printf("verify rgb2hsv/%-9s unsupported\n", getHSVKernelName(k));
+			continue;
+		}
+
+		// Convert in uneven row lengths to exercise the tails
+		for (size_t start = 0; start < colors; ) {
+			const size_t n = min(colors - start, (size_t)(start % 997 + 1));
+			kernel(&rgb[start * 3], &actual[start * 3], n);
+			start += n;
+		}
+
+		array<int, 3> worst = { 0, 0, 0 };
+		size_t mismatches = 0;
+		for (size_t i = 0; i < colors * 3; ++i) {
+			const int channel = (int)(i % 3);
+			int diff = abs((int)actual[i] - (int)expected[i]);
+			if (channel == 0)
+				diff = min(diff, 255 - diff);
+			worst[channel] = max(worst[channel], diff);
+			if (diff > 1)
+				++mismatches;
+		}
+
+		bool matchesScalar = true;
+		if (k == HK_SCALAR)
+			scalar = actual;
+		else
+			matchesScalar = actual == scalar;
+
+		printf("verify rgb2hsv/%-9s max diff h %d s %d v %d, %zu channels off by more than one%s\n",
+		       getHSVKernelName(k), worst[0], worst[1], worst[2], mismatches,
+		       k == HK_SCALAR ? "" : matchesScalar ? ", same as scalar" : ", DIFFERS from scalar");
+		ok = ok && mismatches == 0 && matchesScalar;
+	}
+	fflush(stdout);
+	return ok;
+}
+
+/**
+ * \brief Checks that frames laid out with padded rows, padded pixels, or as views of a larger frame
+ *        hold the same pixels and get the same detection results as packed frames
+ */
+bool verifyLayouts()
+{
+	const size_t w = 500;
+	const size_t h = 700;
+	FrameSynthesizer synth(w, h);
+	auto packed = synth.render(synth.typicalScene(synth.getPipeSpacing() / 2, (int)h / 2));
+
+	size_t pitch;
+	const vector<uint8_t> ximage = makeXImage(*packed, pitch);
+	const Rectangle whole(0, 0, (int)w - 1, (int)h - 1);
+
+	VideoFrame aligned(w, h, 3, false, FL_ALIGNED);
+	xPixelsToRGB(ximage.data(), pitch, whole, aligned);
+	VideoFrame rgbx(w, h, 3, false, FL_ALIGNED_RGBX);
+	xPixelsToRGB(ximage.data(), pitch, whole, rgbx);
+
+	// The same game in the middle of a bigger aligned frame, seen through a view
+	VideoFrame desktop(w + 100, h + 20, 3, true, FL_ALIGNED);
+	synth.render(synth.typicalScene(synth.getPipeSpacing() / 2, (int)h / 2), desktop, Point(37, 10));
+	auto view = desktop.view(Rectangle(37, 10, 37 + (int)w - 1, 10 + (int)h - 1));
+	auto alignedView = desktop.view(Rectangle(37, 10, 37 + (int)w - 1, 10 + (int)h - 1), true);
+
+	auto samePixels = [&](const VideoFrame& f) {
+		bool same = true;
+		packed->foreachPixel([&](const uint8_t* pix, int x, int y) {
+			same = memcmp(pix, f.getPixel((size_t)x, (size_t)y), 3) == 0;
+			return same;
+		});
+		return same;
+	};
+	auto sameDetections = [&](const VideoFrame& f) {
+		const Point beak = findBeakLocation(*packed).value;
+		const RectangleList pipes = findPipes(*packed);
+		return findBeakLocation(f).value == beak && findBird(f, beak) == findBird(*packed, beak) &&
+		       findPipes(f) == pipes;
+	};
+
+	bool ok = true;
+	auto report = [&](const char* name, bool pixels, bool detections, bool extra) {
+		printf("verify layout/%-13s pixels %s  detections %s  %s\n", name, pixels ? "same" : "DIFFER",
+		       detections ? "same" : "DIFFER", extra ? "ok" : "FAILED");
+		ok = ok && pixels && detections && extra;
+	};
+
+	report("aligned", samePixels(aligned), sameDetections(aligned) &&
+	       findPipesByColumns(aligned).value == findPipesByColumns(*packed).value,
+	       aligned.isAligned() && aligned.contentHash() == packed->contentHash());
+	report("rgbx", samePixels(rgbx), sameDetections(rgbx), rgbx.isAligned() && rgbx.getBytesPerPixel() == 4);
+	report("view", samePixels(*view), sameDetections(*view),
+	       view->getPitch() == desktop.getPitch() && view->getPixels() == desktop.getPixel(37, 10));
+	// Results from views map back onto the frame they came from, through views of views too
+	const Point beakInDesktop = findBeakLocation(desktop).value;
+	const VideoFrame stackView(desktop, Rectangle(20, 5, (int)w + 60, (int)h + 15));
+	const VideoFrame nested(stackView, Rectangle(17, 5, 17 + (int)w - 1, 5 + (int)h - 1));
+	report("view/coords", samePixels(nested), nested.toParent(findBeakLocation(nested).value) == beakInDesktop &&
+	       view->toParent(findBeakLocation(*view).value) == beakInDesktop,
+	       nested.getOrigin() == Point(37, 10) && stackView.fromParent(beakInDesktop) ==
+	       stackView.fromParent(nested.toParent(findBeakLocation(nested).value)));
+	report("view/aligned", alignedView->isAligned() && alignedView->getWidth() == w + 37, true,
+	       alignedView->getPixels() == desktop.getPixel(0, 10));
+
+	// Overlays draw the same in every layout, and only inside the frame
+	VideoFrame drawnPacked(*packed);
+	VideoFrame drawnRGBX(rgbx);
+	for (VideoFrame* f : { &drawnPacked, &drawnRGBX }) {
+		f->rectangleAt(Rectangle(-5, 10, 30, 20), { { 255, 0, 0 } });
+		f->crosshairsAt(Point((int)w - 3, 100), { { 0, 0, 255 } }, 10);
+	}
+	size_t red = 0;
+	drawnPacked.foreachPixel([&](const uint8_t* pix, int, int) {
+		red += pix[0] == 255 && pix[1] == 0 && pix[2] == 0;
+		return true;
+	});
+	report("drawing", red == 31 * 11, memcmp(drawnPacked.getPixel(w - 1, 100), drawnRGBX.getPixel(w - 1, 100), 3) == 0,
+	       drawnRGBX.getPixel(w - 1, 100)[3] == 0 && memcmp(drawnPacked.getPixel(w - 3, 90), drawnRGBX.getPixel(w - 3, 90), 3) == 0);
+
+	// Copies of views get their own memory, and frames copy between layouts
+	VideoFrame copied(*view);
+	VideoFrame repacked(w, h, 3, false);
+	repacked = rgbx;
+	report("copies", samePixels(copied) && samePixels(repacked), true,
+	       copied.getPixels() != view->getPixels() && copied.isAligned());
+
+	fflush(stdout);
+	return ok;
+}
+
+/**
+ * \brief Checks the word-at-a-time BitMask operations against pixel-by-pixel versions on random masks,
+ *        with widths on and off word boundaries
+ */
+bool verifyBitMask()
+{
+	bool ok = true;
+	unsigned seed = 12345;
+	auto random = [&] { seed = seed * 1103515245 + 12345; return (seed >> 16) & 0x7fff; };
+
+	for (size_t w : { 1, 63, 64, 65, 130, 200 }) {
+		const size_t h = 37;
+		BitMask mask(w, h);
+		for (size_t y = 0; y < h; ++y) {
+			for (size_t x = 0; x < w; ++x) {
+				if (random() % 3 != 0)
+					mask.set(x, y);
+			}
+		}
+
+		// Pixel by pixel, with the same edge rules as BitMask
+		auto slowStep = [&](const BitMask& in, bool eroding) {
+			BitMask out(w, h);
+			for (int y = 0; y < (int)h; ++y) {
+				for (int x = 0; x < (int)w; ++x) {
+					bool result = eroding;
+					for (int dy = -1; dy <= 1; ++dy) {
+						for (int dx = -1; dx <= 1; ++dx) {
+							const int nx = x + dx, ny = y + dy;
+							const bool inside = nx >= 0 && ny >= 0 && nx < (int)w && ny < (int)h;
+							const bool bit = inside ? in.get((size_t)nx, (size_t)ny) : eroding;
+							result = eroding ? (result && bit) : (result || bit);
+						}
+					}
+					if (result)
+						out.set((size_t)x, (size_t)y);
+				}
+			}
+			return out;
+		};
+		auto same = [&](const BitMask& a, const BitMask& b) {
+			for (size_t y = 0; y < h; ++y) {
+				if (!equal(a.getRow(y), a.getRow(y) + a.getWordsPerRow(), b.getRow(y)))
+					return false;
+			}
+			return true;
+		};
+
+		BitMask eroded = mask;
+		eroded.erode(2);
+		BitMask dilated = mask;
+		dilated.dilate(2);
+		const bool morphology = same(eroded, slowStep(slowStep(mask, true), true)) &&
+		                        same(dilated, slowStep(slowStep(mask, false), false));
+
+		vector<int> rows, columns;
+		mask.rowCounts(rows);
+		mask.columnCounts(columns, 3, (int)h - 5);
+		bool counts = mask.count() == (size_t)accumulate(rows.begin(), rows.end(), 0);
+		for (size_t x = 0; x < w; ++x) {
+			int n = 0;
+			for (size_t y = 3; y <= h - 5; ++y)
+				n += mask.get(x, y);
+			counts = counts && columns[x] == n;
+		}
+
+		// Flood fill from each unvisited pixel, in raster order, which finds groups in the same order
+		BitMask sparse(w, h);
+		for (size_t y = 0; y < h; ++y) {
+			for (size_t x = 0; x < w; ++x) {
+				if (random() % 4 == 0)
+					sparse.set(x, y);
+			}
+		}
+		vector<Rectangle> boxes, filled;
+		sparse.components(boxes);
+		BitMask visited(w, h);
+		for (size_t y = 0; y < h; ++y) {
+			for (size_t x = 0; x < w; ++x) {
+				if (!sparse.get(x, y) || visited.get(x, y))
+					continue;
+				Rectangle box(Point((int)x, (int)y));
+				vector<Point> todo(1, Point((int)x, (int)y));
+				visited.set(x, y);
+				while (!todo.empty()) {
+					const Point p = todo.back();
+					todo.pop_back();
+					box.expandTo(p.x, p.y);
+					for (int dy = -1; dy <= 1; ++dy) {
+						for (int dx = -1; dx <= 1; ++dx) {
+							const int nx = p.x + dx, ny = p.y + dy;
+							if (nx < 0 || ny < 0 || nx >= (int)w || ny >= (int)h ||
+							    !sparse.get((size_t)nx, (size_t)ny) || visited.get((size_t)nx, (size_t)ny))
+								continue;
+							visited.set((size_t)nx, (size_t)ny);
+							todo.emplace_back(nx, ny);
+						}
+					}
+				}
+				filled.push_back(box);
+			}
+		}
+		const bool groups = boxes == filled;
+
+		printf("verify bitmask/%-4zu morphology %s  counts %s  components %s\n", w,
+		       morphology ? "ok" : "FAILED", counts ? "ok" : "FAILED", groups ? "ok" : "FAILED");
+		ok = ok && morphology && counts && groups;
+	}
+
+	fflush(stdout);
+	return ok;
+}
+
+/// Checks RectangleSet against merging every adjacent pair over and over until nothing changes
+bool verifyRectangleSet()
+{
+	unsigned seed = 777;
+	auto random = [&](int n) { seed = seed * 1103515245 + 12345; return (int)((seed >> 16) % (unsigned)n); };
+
+	bool ok = true;
+	for (int tolerance : { 0, 1, 5 }) {
+		bool same = true;
+		for (int trial = 0; trial < 50; ++trial) {
+			vector<Rectangle> rects;
+			const int count = 1 + random(200);
+			for (int i = 0; i < count; ++i) {
+				const int x = random(500);
+				const int y = random(700);
+				rects.emplace_back(x, y, x + random(40), y + random(10));
+			}
+
+			RectangleSet set(tolerance, 1 + random(64));
+			set.add(rects);
+			RectangleList fast = set.merge();
+
+			RectangleList slow(rects.begin(), rects.end());
+			for (bool merged = true; merged; ) {
+				merged = false;
+				for (size_t a = 0; a < slow.size() && !merged; ++a) {
+					for (size_t b = a + 1; b < slow.size() && !merged; ++b) {
+						if (slow[a].adjacentTo(slow[b], tolerance)) {
+							slow[a].expandTo(slow[b]);
+							slow.erase(slow.begin() + (ptrdiff_t)b);
+							merged = true;
+						}
+					}
+				}
+			}
+
+			auto byPosition = [](const Rectangle& l, const Rectangle& r) {
+				return make_pair(l.top, make_pair(l.left, make_pair(l.bottom, l.right))) <
+				       make_pair(r.top, make_pair(r.left, make_pair(r.bottom, r.right)));
+			};
+			const bool sorted = is_sorted(fast.begin(), fast.end(),
+			                              [](const Rectangle& l, const Rectangle& r) { return l.getArea() > r.getArea(); });
+			sort(fast.begin(), fast.end(), byPosition);
+			sort(slow.begin(), slow.end(), byPosition);
+			same = same && sorted && fast == slow;
+		}
+		printf("verify rectangleSet/tol%d  %s\n", tolerance, same ? "ok" : "FAILED");
+		ok = ok && same;
+	}
+
+	fflush(stdout);
+	return ok;
+}
+
+/// A screen that's never there, for running the AI without one
+class NullScreenIO : public ScreenIO {
+
+public:
+
+	shared_ptr<VideoFrame> getFrame() override { return nullptr; }
+
+	void focusOn(const Rectangle&) override { }
+
+	Rectangle getScreenBounds() const override { return Rectangle(); }
+
+	void resetFocus() override { }
+
+	void mouseTo(int, int) override { }
+
+	chrono::steady_clock::time_point click() override { return chrono::steady_clock::now(); }
+};
+
+/**
+ * \brief Runs what the play loop does with each frame over a stretch of a game, and checks that once it has
+ *        warmed up, none of it (detection, physics, or the AI) touches the heap
+ *
+ * Both ways the loop finds the beak are used: from the tiles, and around where the bird last was.
+ */
+bool verifySteadyState()
+{
+	const size_t w = 500;
+	const size_t h = 700;
+	FrameSynthesizer synth(w, h);
+
+	// The bird bobbing up and down as the pipes scroll by
+	vector<shared_ptr<VideoFrame>> frames;
+	for (int i = 0; i < 48; ++i) {
+		const int birdY = synth.getGroundTop() / 2 + (i % 16 < 8 ? i % 8 : 8 - i % 8) * 6;
+		frames.push_back(synth.render(synth.typicalScene(i * 3, birdY)));
+	}
+	const Rectangle gameRect(0, 0, (int)w - 1, (int)h - 1);
+
+	TileClassifier tiles;
+	FrameArena arena;
+	PhysicsAnalysis physics(10);
+	NullScreenIO io;
+	BirdAI ai(physics, &io);
+	ai.setOverlay(false);
+
+	size_t failures = 0;
+	auto play = [&](VideoFrame& frame) {
+		arena.reset();
+		tiles.update(frame);
+		const SearchResult<Point> beak = findBeakLocation(tiles, &arena);
+		if (!beak.found()) {
+			++failures;
+			return;
+		}
+		Rectangle bird = findBird(frame, beak.value);
+		Rectangle band = bird;
+		band.expandBy(bird.getHeight() * 3);
+		findBeakLocation(frame, band, &arena);
+		bird.expandBy(5);
+		SearchResult<RectangleList> pipes = findPipesByColumns(frame, &arena);
+		if (!pipes.found()) {
+			++failures;
+			return;
+		}
+		physics.logPosition(bird.getCenter().y);
+		BirdAI::StatusPacket pack(gameRect, bird, std::move(pipes.value));
+		if (ai.iterate(pack, frame) != BirdAI::AE_NONE)
+			++failures;
+	};
+
+	// The AI talks about what it's doing, which doesn't belong in these results
+	fflush(stdout);
+	const int savedStdout = dup(STDOUT_FILENO);
+	const int devNull = open("/dev/null", O_WRONLY);
+	dup2(devNull, STDOUT_FILENO);
+
+	// The first pass grows everything to size (and the AI can't act until it has a velocity)
+	for (auto& f : frames)
+		play(*f);
+
+	failures = 0;
+	const size_t allocsBefore = allocationCount;
+	for (int pass = 0; pass < 3; ++pass) {
+		for (auto& f : frames)
+			play(*f);
+	}
+	const size_t allocations = allocationCount - allocsBefore;
+
+	fflush(stdout);
+	dup2(savedStdout, STDOUT_FILENO);
+	close(savedStdout);
+	close(devNull);
+
+	const bool ok = allocations == 0 && failures == 0;
+	printf("verify steadyState         %zu allocations, %zu failures, arena %zu bytes  %s\n",
+	       allocations, failures, arena.getCapacity(), ok ? "ok" : "FAILED");
+	fflush(stdout);
+	return ok;
+}
+
+/// Checks that the searches and the AI say what went wrong with frames they can't make sense of
+bool verifyFailures()
+{
+	FrameSynthesizer synth(500, 700);
+	SyntheticScene over;
+	over.gameOver = true;
+	auto white = synth.render(over);
+	FrameArena arena;
+
+	const bool searchesOK = findGameWindow(*white).error == SE_NO_SKY &&
+	                        findGameWindowCoarse(*white).error == SE_NO_SKY &&
+	                        findBeakLocation(*white, &arena).error == SE_NO_BEAK &&
+	                        findPipesByColumns(*white, &arena).error == SE_NO_FLOOR;
+
+	// A bird, but no pipes, then a floor that doesn't span the game
+	PhysicsAnalysis physics(10);
+	NullScreenIO io;
+	BirdAI ai(physics, &io);
+	ai.setOverlay(false);
+	const Rectangle gameRect(0, 0, 499, 699);
+	const Rectangle bird(240, 340, 260, 360);
+	physics.logPosition(bird.getCenter().y);
+	BirdAI::StatusPacket first(gameRect, bird, RectangleList());
+	const BirdAI::Error noVelocity = ai.iterate(first, *white);
+	physics.logPosition(bird.getCenter().y + 1);
+	BirdAI::StatusPacket second(gameRect, bird, RectangleList());
+	const BirdAI::Error noObstacles = ai.iterate(second, *white);
+	RectangleList narrow;
+	narrow.emplace_back(0, 600, 200, 620);
+	BirdAI::StatusPacket third(gameRect, bird, std::move(narrow));
+	const BirdAI::Error narrowFloor = ai.iterate(third, *white);
+	const bool aiOK = noVelocity == BirdAI::AE_NO_VELOCITY && noObstacles == BirdAI::AE_NO_OBSTACLES &&
+	                  narrowFloor == BirdAI::AE_FLOOR_TOO_NARROW;
+
+	const bool ok = searchesOK && aiOK;
+	printf("verify failures            searches %s  AI %s  %s\n", searchesOK ? "ok" : "WRONG",
+	       aiOK ? "ok" : "WRONG", ok ? "ok" : "FAILED");
+	fflush(stdout);
+	return ok;
+}
+
+/**
+ * \brief Checks the scheduler does every item exactly once, on a thread it has, however the items divide up,
+ *        and that an exception out of the body comes back out of run() without breaking the next run
+ */
+bool verifyScheduler()
+{
+	struct Case {
+		const char* name;
+		size_t threads;
+		size_t count;
+		size_t chunk;
+	};
+	const Case cases[] = {
+		{ "uneven", 4, 1001, 7 },
+		{ "few items", 8, 3, 1 },
+		{ "no items", 3, 0, 5 },
+		{ "big chunks", 2, 100, 1000 },
+	};
+
+	bool ok = true;
+	for (const Case& c : cases) {
+		WorkStealingScheduler scheduler(c.threads);
+		unique_ptr<atomic<int>[]> done(new atomic<int>[c.count + 1]);
+		for (size_t i = 0; i < c.count; ++i)
+			done[i] = 0;
+		atomic<bool> badThread(false);
+		scheduler.run(c.count, c.chunk, [&](size_t begin, size_t end, size_t thread) {
+			if (thread >= scheduler.getThreadCount() || begin >= end || end > c.count)
+				badThread = true;
+			for (size_t i = begin; i < end && i < c.count; ++i)
+				done[i].fetch_add(1);
+		});
+		size_t wrong = 0;
+		for (size_t i = 0; i < c.count; ++i)
+			wrong += done[i] != 1;
+		const bool caseOK = wrong == 0 && !badThread;
+		printf("verify scheduler/%-10s %zu items wrong  %s\n", c.name, wrong, caseOK ? "ok" : "FAILED");
+		ok = ok && caseOK;
+	}
+
+	WorkStealingScheduler scheduler(4);
+	bool thrown = false;
+	try {
+		scheduler.run(100, 1, [](size_t begin, size_t, size_t) {
+			if (begin == 37)
+				throw Exceptions::ArgumentException("Item 37", __FUNCTION__);
+		});
+	}
+	catch (const Exceptions::ArgumentException& e) {
+		thrown = e.message == "Item 37";
+	}
+	atomic<size_t> after(0);
+	scheduler.run(100, 3, [&](size_t begin, size_t end, size_t) { after += end - begin; });
+	bool rejected = false;
+	try {
+		scheduler.run(10, 0, [](size_t, size_t, size_t) { });
+	}
+	catch (const Exceptions::ArgumentException&) {
+		rejected = true;
+	}
+	const bool throwOK = thrown && after == 100 && rejected;
+	printf("verify scheduler/throws    rethrown %s  next run %s  %s\n", thrown ? "yes" : "NO",
+	       after == 100 ? "whole" : "SHORT", throwOK ? "ok" : "FAILED");
+
+	fflush(stdout);
+	return ok && throwOK;
+}
+
+/// Checks that frames written by FrameRecorder, from packed, aligned and RGBX frames, read back the same
+bool verifyRecording()
+{
+	const size_t w = 500;
+	const size_t h = 700;
+	FrameSynthesizer synth(w, h);
+	const Rectangle whole(0, 0, (int)w - 1, (int)h - 1);
+
+	vector<shared_ptr<VideoFrame>> frames;
+	frames.push_back(synth.render(synth.typicalScene(synth.getPipeSpacing() / 2, (int)h / 2)));
+	size_t pitch;
+	const vector<uint8_t> ximage = makeXImage(*synth.render(synth.typicalScene(10, (int)h / 3)), pitch);
+	frames.push_back(make_shared<VideoFrame>(w, h, 3, false, FL_ALIGNED));
+	xPixelsToRGB(ximage.data(), pitch, whole, *frames.back());
+	frames.push_back(make_shared<VideoFrame>(w, h, 3, false, FL_ALIGNED_RGBX));
+	xPixelsToRGB(ximage.data(), pitch, whole, *frames.back());
+	const auto epoch = chrono::steady_clock::now();
+	for (size_t i = 0; i < frames.size(); ++i) {
+		frames[i]->setFrameID(1000 + i * 7);
+		frames[i]->setCaptureTime(epoch + chrono::milliseconds(16 * i + 1));
+	}
+
+	char path[] = "/tmp/flapperbench-XXXXXX";
+	const int fd = mkstemp(path);
+	if (fd < 0) {
+		printf("verify recording           could not create a file  FAILED\n");
+		return false;
+	}
+	close(fd);
+
+	bool ok;
+	size_t same = 0;
+	try {
+		{
+			FrameRecorder recorder(path, w, h, 2);
+			for (const auto& f : frames)
+				recorder.record(*f, true);
+			recorder.finish();
+			ok = recorder.getRecordedCount() == frames.size() && recorder.getDroppedCount() == 0 &&
+			     !recorder.hasFailed();
+		}
+
+		FrameRecording recording(path);
+		ok = ok && recording.getFrameCount() == frames.size() && recording.getWidth() == w &&
+		     recording.getHeight() == h;
+		VideoFrame read(w, h, 3, false);
+		for (size_t i = 0; ok && i < frames.size(); ++i) {
+			recording.read(i, read);
+			// contentHash skips row padding, but not the unused byte of RGBX pixels
+			VideoFrame packed(w, h, 3, false);
+			packed = *frames[i];
+			same += read.contentHash() == packed.contentHash() && read.getFrameID() == frames[i]->getFrameID() &&
+			        read.getCaptureTime() == frames[i]->getCaptureTime();
+		}
+	}
+	catch (const Exceptions::Exception& e) {
+		printf("verify recording           %s in %s\n", e.message.c_str(), e.callingFunction.c_str());
+		ok = false;
+	}
+	unlink(path);
+
+	ok = ok && same == frames.size();
+	printf("verify recording           %zu of %zu frames read back the same  %s\n", same, frames.size(),
+	       ok ? "ok" : "FAILED");
+	fflush(stdout);
+	return ok;
+}
+
+/// A course of pipes for the planner, as BirdAI would measure it: a 500x700 game with its ground at 600
+struct PlannerCourse {
+	FlapPlanner::Model model;
+	FlapPlanner::Bird bird;
+	vector<FlapPlanner::Gap> gaps;
+	int floorY = 600;
+	int cruiseY = 400;
+
+	PlannerCourse()
+	{
+		// An 80 pixel jump peaking after 0.3 seconds, with the pipes going by at 150 pixels a second
+		model.gravity = 2 * 80 / (0.3f * 0.3f);
+		model.flapVelocity = -2 * 80 / 0.3f;
+		model.scrollSpeed = 150;
+		model.clickDelay = 0;
+		bird = { 300, 0, 100, 150, 18, 18 };
+		// Gaps of 140 pixels, a pipe every 250, going up and down
+		const int gapTops[] = { 150, 330, 120, 380, 200, 300 };
+		for (int i = 0; i < 6; ++i)
+			gaps.push_back({ 300 + i * 250, 380 + i * 250, gapTops[i], gapTops[i] + 140 });
+	}
+};
+
+/**
+ * \brief Checks the planner flies the bird through a course, replanning every step as BirdAI does,
+ *        and that it gives up on impossible courses and when it has no time
+ */
+bool verifyFlapPlanner()
+{
+	PlannerCourse course;
+	FlapPlanner planner(chrono::milliseconds(100));
+	const float dt = planner.getStepSeconds();
+
+	FlapPlanner::Bird bird = course.bird;
+	vector<FlapPlanner::Gap> gaps;
+	int crashedAt = -1;
+	int flaps = 0;
+	bool alwaysPlanned = true;
+	const int steps = 150; // Past all of the pipes
+	for (int step = 0; step < steps && crashedAt < 0; ++step) {
+		const int shift = (int)lround(course.model.scrollSpeed * dt * (float)step);
+		gaps.clear();
+		for (FlapPlanner::Gap g : course.gaps) {
+			g.left -= shift;
+			g.right -= shift;
+			if (g.right >= bird.left)
+				gaps.push_back(g);
+		}
+
+		const FlapPlanner::Plan plan = planner.plan(course.model, bird, gaps, course.floorY, course.cruiseY);
+		alwaysPlanned = alwaysPlanned && plan.outcome == FlapPlanner::PO_PLANNED;
+		if (plan.clickIn >= 0 && plan.clickIn < dt / 2) {
+			bird.velocity = course.model.flapVelocity;
+			++flaps;
+		}
+		else {
+			bird.velocity += course.model.gravity * dt;
+		}
+		bird.y += bird.velocity * dt;
+
+		const float top = bird.y - (float)bird.above;
+		const float bottom = bird.y + (float)bird.below;
+		if (top < 0 || bottom >= (float)course.floorY)
+			crashedAt = step;
+		for (const FlapPlanner::Gap& g : gaps) {
+			const int nextShift = (int)lround(course.model.scrollSpeed * dt * (float)(step + 1)) - shift;
+			if (bird.right >= g.left - nextShift && bird.left <= g.right - nextShift &&
+			    (top < (float)g.top || bottom > (float)g.bottom))
+				crashedAt = step;
+		}
+	}
+	const bool flew = crashedAt < 0 && alwaysPlanned;
+	printf("verify flapPlanner/course  %d flaps, %s  %s\n", flaps,
+	       crashedAt < 0 ? "no crash" : ("crashed at step " + to_string(crashedAt)).c_str(), flew ? "ok" : "FAILED");
+
+	// A gap narrower than the bird can't be flown through
+	PlannerCourse narrow;
+	for (FlapPlanner::Gap& g : narrow.gaps)
+		g.bottom = g.top + 20;
+	const bool doomed = planner.plan(narrow.model, narrow.bird, narrow.gaps, narrow.floorY, narrow.cruiseY).outcome ==
+	                    FlapPlanner::PO_DOOMED;
+
+	FlapPlanner rushed(chrono::nanoseconds(0));
+	const bool timedOut = rushed.plan(course.model, course.bird, course.gaps, course.floorY, course.cruiseY).outcome ==
+	                      FlapPlanner::PO_TIMED_OUT;
+	printf("verify flapPlanner/limits  doomed %s  timed out %s  %s\n", doomed ? "yes" : "no",
+	       timedOut ? "yes" : "no", doomed && timedOut ? "ok" : "FAILED");
+
+	fflush(stdout);
+	return flew && doomed && timedOut;
+}
+
+/**
+ * \brief Checks that the fitter gets back how a bird flaps, from positions rounded to whole pixels at 60 frames
+ *        a second, with clicks landing a while later and coming both while the bird falls and while it rises
+ */
+bool verifyFlapFitter()
+{
+	const float gravity = 1500;
+	const float flapVelocity = -450;
+	const float clickDelay = 0.035f;
+	const double frame = 1.0 / 60;
+
+	ManualTimeSource clock;
+	FlapFitter fitter(clock);
+	double t = 0;
+	double y = 300;
+	double velocity = 0;
+	double flapAt = -1;
+	// Clicks alternate between long and short gaps, so some land on the way down and some on the way up
+	const double clickGaps[] = { 0.55, 0.2 };
+	double nextClick = 0.3;
+	for (int i = 0; i < 600; ++i) {
+		clock.set(TimeSource::TimePoint(chrono::duration_cast<TimeSource::Duration>(chrono::duration<double>(t))));
+		fitter.logPosition((int)lround(y));
+		if (t >= nextClick) {
+			fitter.clicked();
+			flapAt = t + clickDelay;
+			nextClick += clickGaps[i % 2];
+		}
+
+		// Fly to the next frame, flapping on the way if it's time
+		double left = frame;
+		if (flapAt >= 0 && flapAt < t + frame) {
+			const double before = flapAt - t;
+			y += velocity * before + 0.5 * gravity * before * before;
+			velocity = flapVelocity;
+			left -= before;
+			flapAt = -1;
+		}
+		y += velocity * left + 0.5 * gravity * left * left;
+		velocity += gravity * left;
+		t += frame;
+	}
+
+	FlapFitter::Fit fit;
+	const bool fitted = fitter.getFit(fit);
+	const bool ok = fitted && fitter.getFitCount() >= 20 && fabs(fit.gravity - gravity) < gravity * 0.03f &&
+	                fabs(fit.flapVelocity - flapVelocity) < -flapVelocity * 0.03f &&
+	                fabs(fit.clickDelay - clickDelay) < 0.005f;
+	printf("verify flapFitter          %zu jumps: gravity %.0f, flap %.0f, delay %.3f s  %s\n", fitter.getFitCount(),
+	       fitted ? fit.gravity : 0.0f, fitted ? fit.flapVelocity : 0.0f, fitted ? fit.clickDelay : 0.0f,
+	       ok ? "ok" : "FAILED");
+	fflush(stdout);
+	return ok;
+}
+
+void usage(const char* argv0)
+{
+	fprintf(stderr, "Usage: %s [--pixels <per-case pixel budget>] [--filter <kernel name substring>] [--accuracy]"
+	        " [--verify]\n",
+	        argv0);
+	exit(1);
+}
+
+} // end anonymous namespace
+
+int main(int argc, char** argv)
+{
+	Options opts;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--pixels") == 0 && i + 1 < argc)
+			opts.pixelBudget = (size_t)atoll(argv[++i]);
+		else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+			opts.filter = argv[++i];
+		else if (strcmp(argv[i], "--accuracy") == 0)
+			opts.accuracy = true;
+		else if (strcmp(argv[i], "--verify") == 0)
+			opts.verify = true;
+		else
+			usage(argv[0]);
+	}
+
+	// Roughly the shape of the game at half, normal, and double size
+	const vector<pair<size_t, size_t>> gameSizes = { {250, 350}, {500, 700}, {1000, 1400} };
+	const vector<pair<size_t, size_t>> desktopSizes = { {1280, 720}, {1920, 1080}, {3840, 2160} };
+
+	if (opts.verify) {
+		const bool layoutsOK = verifyLayouts();
+		const bool masksOK = verifyBitMask();
+		const bool rectsOK = verifyRectangleSet();
+		const bool steadyOK = verifySteadyState();
+		const bool plannerOK = verifyFlapPlanner();
+		const bool fitterOK = verifyFlapFitter();
+		const bool failuresOK = verifyFailures();
+		const bool schedulerOK = verifyScheduler();
+		const bool recordingOK = verifyRecording();
+		return verifyHSV() && layoutsOK && masksOK && rectsOK && steadyOK && plannerOK && fitterOK && failuresOK &&
+		       schedulerOK && recordingOK ? 0 : 1;
+	}
+
+	if (opts.accuracy) {
+		checkGameWindow(desktopSizes);
+		checkAccuracy(gameSizes);
+		return 0;
+	}
+
+	auto nothing = [] { };
+
+	for (const auto& size : desktopSizes) {
+		const size_t w = size.first;
+		const size_t h = size.second;
+		auto desktop = makeDesktopFrame(w, h);
+
+		run(opts, "findGameWindow", w, h, nothing, [&] { findGameWindow(*desktop); });
+		run(opts, "findGameWindowCoarse", w, h, nothing, [&] { findGameWindowCoarse(*desktop); });
+		const Rectangle gameRect = findGameWindow(*desktop).value;
+		run(opts, "isGameWindowAt", w, h, nothing, [&] { isGameWindowAt(*desktop, gameRect); });
+	}
+
+	for (const auto& size : gameSizes) {
+		const size_t w = size.first;
+		const size_t h = size.second;
+		FrameSynthesizer synth(w, h);
+		const SyntheticScene scene = synth.typicalScene(synth.getPipeSpacing() / 2, (int)h / 2);
+		auto game = synth.render(scene);
+		const Point beak = findBeakLocation(*game).value;
+
+		run(opts, "findBeakLocation", w, h, nothing, [&] { findBeakLocation(*game); });
+		run(opts, "findBird", w, h, nothing, [&] { findBird(*game, beak); });
+		// Around the bird, as the play loop does when it's short on time
+		Rectangle band = findBird(*game, beak);
+		band.expandBy(band.getHeight() * 3);
+		run(opts, "findBeakLocation/roi", w, h, nothing, [&] { findBeakLocation(*game, band); });
+		run(opts, "findPipes", w, h, nothing, [&] { findPipes(*game); });
+		run(opts, "findPipesByColumns", w, h, nothing, [&] { findPipesByColumns(*game); });
+		run(opts, "gameOver", w, h, nothing, [&] { gameOver(*game); });
+
+		SyntheticScene over;
+		over.gameOver = true;
+		auto white = synth.render(over);
+		run(opts, "gameOver/white", w, h, nothing, [&] { gameOver(*white); });
+		// What searches cost when they come up empty, as they do on every frame of a bad stretch
+		run(opts, "findBeakLocation/none", w, h, nothing, [&] { findBeakLocation(*white); });
+		run(opts, "findPipesByColumns/none", w, h, nothing, [&] { findPipesByColumns(*white); });
+
+		// Alternate between two frames a couple of pixels of scrolling apart, as in a game
+		const SyntheticScene nextScene = synth.typicalScene(synth.getPipeSpacing() / 2 + 2, (int)h / 2 + 1);
+		auto nextGame = synth.render(nextScene);
+		const VideoFrame* alternating[] = { game.get(), nextGame.get() };
+		size_t updates = 0;
+		TileClassifier tiles;
+		run(opts, "tiles/static", w, h, nothing, [&] { tiles.update(*game); });
+		run(opts, "tiles/scroll", w, h, nothing, [&] { tiles.update(*alternating[updates++ % 2]); });
+		tiles.update(*game);
+		run(opts, "findBeakLocation/tiles", w, h, nothing, [&] { findBeakLocation(tiles); });
+		run(opts, "findPipes/tiles", w, h, nothing, [&] { findPipes(tiles); });
+		// The same, keeping temporaries in an arena the way the play loop does
+		FrameArena arena;
+		run(opts, "findBeakLocation/arena", w, h, nothing, [&] { arena.reset(); findBeakLocation(tiles, &arena); });
+		run(opts, "findPipes/tiles/arena", w, h, nothing, [&] { arena.reset(); findPipes(tiles, &arena); });
+		run(opts, "findPipesByColumns/arena", w, h, nothing, [&] { arena.reset(); findPipesByColumns(*game, &arena); });
+		RectangleList pieces;
+		tiles.collect(TileClassifier::TC_PIPE, pieces);
+		RectangleSet pieceSet(5);
+		run(opts, "rectangleSet/merge", w, h, nothing, [&] { pieceSet.clear(); pieceSet.add(pieces); pieceSet.merge(); });
+
+		BitMask pipeMask;
+		pipeMask.classify(*game, FlappyColors::isPipeColor);
+		BitMask maskScratch;
+		vector<int> counts;
+		vector<Rectangle> boxes;
+		run(opts, "mask/classify", w, h, nothing, [&] { maskScratch.classify(*game, FlappyColors::isPipeColor); });
+		run(opts, "mask/close", w, h, [&] { maskScratch = pipeMask; }, [&] { maskScratch.close(2); });
+		run(opts, "mask/open", w, h, [&] { maskScratch = pipeMask; }, [&] { maskScratch.open(1); });
+		run(opts, "mask/rowCounts", w, h, nothing, [&] { pipeMask.rowCounts(counts); });
+		run(opts, "mask/columnCounts", w, h, nothing, [&] { pipeMask.columnCounts(counts); });
+		run(opts, "mask/components", w, h, nothing, [&] { pipeMask.components(boxes); });
+		run(opts, "findPipes/mask", w, h, [&] { maskScratch = pipeMask; }, [&] { findPipes(maskScratch); });
+		BitMask beakMask;
+		beakMask.classify(*game, FlappyColors::isBeakColor);
+		run(opts, "findBeakLocation/mask", w, h, nothing, [&] { findBeakLocation(beakMask); });
+
+		VideoFrame scratch(w, h, 3, false);
+		run(opts, "rgb2hsv", w, h, [&] { scratch = *game; }, [&] { scratch.rgb2hsv(); });
+		run(opts, "rgb2hsv/copy", w, h, nothing, [&] { game->rgb2hsv(scratch); });
+		for (HSVKernel k : { HK_REFERENCE, HK_SCALAR, HK_SSSE3, HK_AVX2 }) {
+			HSVRowFunction kernel = getHSVKernel(k);
+			if (kernel == nullptr)
+				continue;
+			const string name = string("rgb2hsv/") + getHSVKernelName(k);
+			run(opts, name.c_str(), w, h, nothing, [&] { kernel(game->getPixels(), scratch.getPixels(), w * h); });
+		}
+
+		size_t pitch;
+		const vector<uint8_t> ximage = makeXImage(*game, pitch);
+		const Rectangle whole(0, 0, (int)w - 1, (int)h - 1);
+		run(opts, "xPixelsToRGB", w, h, nothing, [&] { xPixelsToRGB(ximage.data(), pitch, whole, scratch); });
+		VideoFrame alignedScratch(w, h, 3, false, FL_ALIGNED);
+		run(opts, "xPixelsToRGB/aligned", w, h, nothing,
+		    [&] { xPixelsToRGB(ximage.data(), pitch, whole, alignedScratch); });
+		VideoFrame rgbxScratch(w, h, 3, false, FL_ALIGNED_RGBX);
+		run(opts, "xPixelsToRGB/rgbx", w, h, nothing, [&] { xPixelsToRGB(ximage.data(), pitch, whole, rgbxScratch); });
+
+		run(opts, "contentHash", w, h, nothing, [&] { game->contentHash(); });
+
+		// The same light per-pixel work through each iteration API, to compare their overhead
+		unsigned sum = 0;
+		run(opts, "iterate/foreachPixel", w, h, nothing, [&] {
+			game->foreachPixel([&](const uint8_t* pix, int, int) { sum += pix[1]; return true; });
+		});
+		run(opts, "iterate/foreachRow", w, h, nothing, [&] {
+			game->foreachRow<3>([&](const uint8_t* row, size_t length, size_t) {
+				unsigned rowSum = 0;
+				for (size_t x = 0; x < length; ++x)
+					rowSum += row[x * 3 + 1];
+				sum += rowSum;
+				return true;
+			});
+		});
+		run(opts, "iterate/foreachRow/rgbx", w, h, nothing, [&] {
+			rgbxScratch.foreachRow<4>([&](const uint8_t* row, size_t length, size_t) {
+				unsigned rowSum = 0;
+				for (size_t x = 0; x < length; ++x)
+					rowSum += row[x * 4 + 1];
+				sum += rowSum;
+				return true;
+			});
+		});
+		if (sum == 1)
+			puts(""); // Keep the sums from being optimized away
+		run(opts, "rectangleAt", w, h, nothing, [&] { scratch.rectangleAt(whole, { { 255, 0, 0 } }); });
+
+		run(opts, "synthesize", w, h, nothing, [&] { synth.render(scene, scratch); });
+		SyntheticScene noisy = scene;
+		noisy.noise = 4;
+		run(opts, "synthesize/noise", w, h, nothing, [&] { synth.render(noisy, scratch); });
+	}
+
+	// Not per pixel, but the fps column is how many plans fit in a second
+	PlannerCourse course;
+	FlapPlanner planner;
+	run(opts, "flapPlanner/plan", 500, 700, nothing,
+	    [&] { planner.plan(course.model, course.bird, course.gaps, course.floorY, course.cruiseY); });
+
+	return 0;
+}
@@ -0,0 +1,291 @@
+/**
+ * \file BatchAnalyzer.cpp
+ *
+ * Runs the detectors over every frame of one or more recordings (see FrameRecording.hpp), on every core,
+ * and writes what they found in each frame, plus how long each step took, to a compact binary file
+ * (see BatchOutput.hpp). A summary is printed as well.
+ *
+ * Frames are analyzed on their own, with the full-frame searches, so they can be handed out in any order.
+ * Anything that depends on earlier frames (the tiles, the physics, the AI) is left to the play loop.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BatchOutput.hpp"
+#include "Exceptions.hpp"
+#include "FlappySearches.hpp"
+#include "FrameArena.hpp"
+#include "FrameRecording.hpp"
+#include "LatencyHistogram.hpp"
+#include "VideoFrame.hpp"
+#include "WorkStealingScheduler.hpp"
+
+using namespace std;
+using namespace BatchOutput;
+
+static_assert(SE_COUNT <= failureKinds, "Every SearchError needs a place in the summary");
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+	size_t threads = 0; ///< 0 for one per core
+	size_t chunk = 8; ///< Frames a thread takes at a time
+	const char* output = nullptr; ///< Where to write the results, if anywhere
+	vector<string> recordings;
+};
+
+const char* stageNames[ST_COUNT] = { "read", "gameOver", "findBeakLocation", "findBird", "findPipesByColumns" };
+
+/// What each thread keeps from one frame to the next
+struct Worker {
+	unique_ptr<VideoFrame> frame; ///< Frames are read into this, so reading doesn't allocate
+	FrameArena arena;
+	LatencyHistogram stages[ST_COUNT];
+	uint64_t stageTotals[ST_COUNT] = {};
+	uint64_t bytesRead = 0;
+};
+
+int16_t clamp16(int v)
+{
+	return (int16_t)max(-32768, min(32767, v));
+}
+
+void store(int16_t* out, const Rectangle& r)
+{
+	out[0] = clamp16(r.left);
+	out[1] = clamp16(r.top);
+	out[2] = clamp16(r.right);
+	out[3] = clamp16(r.bottom);
+}
+
+/// Reads a frame and runs each detector over it, stopping at the first that fails
+void analyzeFrame(const FrameRecording& recording, size_t index, Worker& w, FrameResult& result)
+{
+	memset(&result, 0, sizeof(result));
+
+	auto last = Clock::now();
+	auto lap = [&](Stage s) {
+		const auto now = Clock::now();
+		const uint64_t ns = (uint64_t)chrono::duration_cast<chrono::nanoseconds>(now - last).count();
+		result.stageNanoseconds[s] = (uint32_t)min<uint64_t>(ns, UINT32_MAX);
+		w.stages[s].record(ns);
+		w.stageTotals[s] += ns;
+		last = now;
+	};
+
+	VideoFrame& frame = *w.frame;
+	recording.read(index, frame);
+	w.bytesRead += recording.getRecordSize();
+	lap(ST_READ);
+	result.frameID = frame.getFrameID();
+	result.captureTime = chrono::duration_cast<chrono::nanoseconds>(frame.getCaptureTime().time_since_epoch()).count();
+
+	w.arena.reset();
+
+	const bool over = gameOver(frame);
+	lap(ST_GAME_OVER);
+	if (over) {
+		result.found = FR_GAME_OVER;
+		return;
+	}
+
+	const SearchResult<Point> beak = findBeakLocation(frame, &w.arena);
+	lap(ST_BEAK);
+	if (!beak.found()) {
+		result.failure = (uint8_t)beak.error;
+		return;
+	}
+	result.found |= FR_BEAK;
+	result.beak[0] = clamp16(beak.value.x);
+	result.beak[1] = clamp16(beak.value.y);
+
+	const Rectangle bird = findBird(frame, beak.value);
+	lap(ST_BIRD);
+	result.found |= FR_BIRD;
+	store(result.bird, bird);
+
+	const SearchResult<RectangleList> pipes = findPipesByColumns(frame, &w.arena);
+	lap(ST_PIPES);
+	if (!pipes.found()) {
+		result.failure = (uint8_t)pipes.error;
+		return;
+	}
+	result.found |= FR_PIPES;
+	result.pipeCount = (uint8_t)min<size_t>(pipes.value.size(), 255);
+	for (size_t i = 0; i < pipes.value.size() && i < (size_t)maxPipes; ++i)
+		store(result.pipes[i], pipes.value[i]);
+}
+
+bool writeAll(FILE* out, const void* data, size_t size)
+{
+	return fwrite(data, 1, size, out) == size;
+}
+
+void usage(const char* argv0)
+{
+	fprintf(stderr, "Usage: %s [--threads <count, 0 for one per core>] [--chunk <frames>] [--output <file>]"
+	        " <recording>...\n",
+	        argv0);
+	exit(1);
+}
+
+} // end anonymous namespace
+
+int main(int argc, char** argv)
+{
+	Options opts;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			opts.threads = (size_t)atoi(argv[++i]);
+		else if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc)
+			opts.chunk = (size_t)atoi(argv[++i]);
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+			opts.output = argv[++i];
+		else if (argv[i][0] == '-')
+			usage(argv[0]);
+		else
+			opts.recordings.push_back(argv[i]);
+	}
+	if (opts.recordings.empty() || opts.chunk == 0)
+		usage(argv[0]);
+
+	WorkStealingScheduler scheduler(opts.threads);
+	vector<unique_ptr<Worker>> workers;
+	for (size_t t = 0; t < scheduler.getThreadCount(); ++t)
+		workers.emplace_back(new Worker);
+
+	FILE* out = nullptr;
+	bool written = true; // Whether every write to out so far has gone through
+	if (opts.output != nullptr) {
+		out = fopen(opts.output, "wb");
+		if (out == nullptr) {
+			fprintf(stderr, "Could not create %s\n", opts.output);
+			return 1;
+		}
+		FileHeader header;
+		memcpy(header.magic, "FLAPDET1", sizeof(header.magic));
+		header.version = 2;
+		header.recordingCount = (uint32_t)opts.recordings.size();
+		header.maxPipes = maxPipes;
+		header.frameResultSize = sizeof(FrameResult);
+		written = writeAll(out, &header, sizeof(header));
+	}
+
+	Summary summary;
+	memset(&summary, 0, sizeof(summary));
+	summary.threads = (uint32_t)scheduler.getThreadCount();
+
+	vector<FrameResult> results;
+	const auto start = Clock::now();
+	try {
+		for (const string& path : opts.recordings) {
+			FrameRecording recording(path);
+			const size_t frames = recording.getFrameCount();
+			results.resize(frames);
+
+			const auto recordingStart = Clock::now();
+			scheduler.run(frames, opts.chunk, [&](size_t begin, size_t end, size_t thread) {
+				Worker& w = *workers[thread];
+				if (!w.frame || w.frame->getWidth() != recording.getWidth() ||
+				    w.frame->getHeight() != recording.getHeight())
+					w.frame.reset(new VideoFrame(recording.getWidth(), recording.getHeight(), 3, false));
+				for (size_t i = begin; i < end; ++i)
+					analyzeFrame(recording, i, w, results[i]);
+			});
+			const double seconds = chrono::duration<double>(Clock::now() - recordingStart).count();
+			summary.steals += scheduler.getSteals();
+
+			for (const FrameResult& r : results) {
+				++summary.frames;
+				if (r.found & FR_GAME_OVER)
+					++summary.gameOverFrames;
+				else
+					++summary.failures[r.failure];
+			}
+
+			printf("%s: %zu frames at %zux%zu, %.0f frames/second\n", path.c_str(), frames, recording.getWidth(),
+			       recording.getHeight(), seconds > 0 ? (double)frames / seconds : 0.0);
+			fflush(stdout);
+
+			if (out != nullptr) {
+				RecordingHeader header;
+				header.frameCount = frames;
+				header.width = (uint32_t)recording.getWidth();
+				header.height = (uint32_t)recording.getHeight();
+				header.pathLength = (uint32_t)path.size();
+				header.reserved = 0;
+				written = written && writeAll(out, &header, sizeof(header));
+				written = written && writeAll(out, path.data(), path.size());
+				written = written && writeAll(out, results.data(), results.size() * sizeof(FrameResult));
+			}
+		}
+	}
+	catch (const Exceptions::Exception& e) {
+		fprintf(stderr, "%s\nin function %s\n", e.message.c_str(), e.callingFunction.c_str());
+		if (out != nullptr)
+			fclose(out);
+		return 1;
+	}
+	summary.wallNanoseconds = (uint64_t)chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count();
+
+	// Each thread kept its own timings, so add them all up
+	uint64_t stageCounts[ST_COUNT]; // Not every frame gets to every stage
+	for (int s = 0; s < ST_COUNT; ++s) {
+		LatencyHistogram::Snapshot total = workers[0]->stages[s].snapshot();
+		summary.stages[s].totalNanoseconds = workers[0]->stageTotals[s];
+		for (size_t t = 1; t < workers.size(); ++t) {
+			const LatencyHistogram::Snapshot snap = workers[t]->stages[s].snapshot();
+			for (int b = 0; b < LatencyHistogram::bucketCount; ++b)
+				total.counts[b] += snap.counts[b];
+			total.total += snap.total;
+			summary.stages[s].totalNanoseconds += workers[t]->stageTotals[s];
+		}
+		stageCounts[s] = total.total;
+		summary.stages[s].p50 = total.valueAtQuantile(0.5);
+		summary.stages[s].p90 = total.valueAtQuantile(0.9);
+		summary.stages[s].p99 = total.valueAtQuantile(0.99);
+		summary.stages[s].max = total.max();
+	}
+	for (const auto& w : workers)
+		summary.bytesRead += w->bytesRead;
+
+	if (out != nullptr) {
+		written = written && writeAll(out, &summary, sizeof(summary));
+		written = written && !ferror(out);
+		if (fclose(out) != 0 || !written) {
+			fprintf(stderr, "Could not write %s\n", opts.output);
+			return 1;
+		}
+	}
+
+	const double wallSeconds = (double)summary.wallNanoseconds / 1e9;
+	printf("\n%llu frames on %u threads in %.2f s: %.0f frames/second, %.0f MB/second read, %llu steals\n",
+	       (unsigned long long)summary.frames, summary.threads, wallSeconds,
+	       wallSeconds > 0 ? (double)summary.frames / wallSeconds : 0.0,
+	       wallSeconds > 0 ? (double)summary.bytesRead / 1e6 / wallSeconds : 0.0,
+	       (unsigned long long)summary.steals);
+	printf("Game over frames: %llu. Failures: %llu", (unsigned long long)summary.gameOverFrames,
+	       (unsigned long long)(summary.frames - summary.gameOverFrames - summary.failures[SE_NONE]));
+	for (int e = SE_NONE + 1; e < SE_COUNT; ++e) {
+		if (summary.failures[e] > 0)
+			printf(", %s %llu", describe((SearchError)e), (unsigned long long)summary.failures[e]);
+	}
+	printf("\n\n%-20s %10s %10s %10s %10s %10s\n", "stage (us)", "mean", "p50", "p90", "p99", "max");
+	for (int s = 0; s < ST_COUNT; ++s) {
+		const StageSummary& st = summary.stages[s];
+		printf("%-20s %10.1f %10.1f %10.1f %10.1f %10.1f\n", stageNames[s],
+		       stageCounts[s] > 0 ? (double)st.totalNanoseconds / 1e3 / (double)stageCounts[s] : 0.0,
+		       (double)st.p50 / 1e3, (double)st.p90 / 1e3, (double)st.p99 / 1e3, (double)st.max / 1e3);
+	}
+	return 0;
+}
@@ -0,0 +1,96 @@
+#ifndef __BATCH_OUTPUT_HPP__
+#define __BATCH_OUTPUT_HPP__
+
+#include <cstdint>
+
+/**
+ * \file BatchOutput.hpp
+ *
+ * What flapperbatch writes: a FileHeader, then for each recording a RecordingHeader, the recording's path
+ * (pathLength bytes, not terminated), and a FrameResult for each of its frames, in order. A Summary of the
+ * whole run comes last. Every struct is a fixed size with no padding, in the byte order of the machine that
+ * wrote it, so the file can be read back with a single read (or numpy.fromfile) per section.
+ */
+
+namespace BatchOutput {
+
+static const int maxPipes = 8; ///< Obstacles kept per frame (the floor counts as one). Any more are counted but not kept.
+
+static const int failureKinds = 8; ///< Room for every SearchError (see FlappySearches.hpp), and some to spare
+
+/// Flags for what was found in a frame
+enum FoundFlags {
+	FR_GAME_OVER = 1, ///< The frame is the game over flash, so nothing else was looked for
+	FR_BEAK = 2,
+	FR_BIRD = 4,
+	FR_PIPES = 8 ///< findPipesByColumns succeeded (the floor alone counts)
+};
+
+/// The steps each frame goes through, which are each timed
+enum Stage {
+	ST_READ,
+	ST_GAME_OVER,
+	ST_BEAK,
+	ST_BIRD,
+	ST_PIPES,
+	ST_COUNT
+};
+
+struct FileHeader {
+	char magic[8]; ///< "FLAPDET1"
+	uint32_t version;
+	uint32_t recordingCount;
+	uint32_t maxPipes;
+	uint32_t frameResultSize; ///< sizeof(FrameResult), as a check
+};
+
+struct RecordingHeader {
+	uint64_t frameCount;
+	uint32_t width;
+	uint32_t height;
+	uint32_t pathLength;
+	uint32_t reserved;
+};
+
+/// Rectangles are inclusive, in the frame's coordinates
+struct FrameResult {
+	uint64_t frameID;
+	int64_t captureTime; ///< As recorded: nanoseconds on the steady clock of the recording machine
+	uint32_t stageNanoseconds[ST_COUNT]; ///< How long each step took (0 if it didn't run)
+	uint8_t found; ///< FoundFlags
+	uint8_t failure; ///< The SearchError of the search that failed, or SE_NONE
+	uint8_t pipeCount; ///< How many obstacles were found, which can be more than are kept
+	uint8_t reserved;
+	int16_t beak[2]; ///< x, y
+	int16_t bird[4]; ///< left, top, right, bottom
+	int16_t pipes[maxPipes][4];
+	int16_t padding[2];
+};
+
+struct StageSummary {
+	uint64_t totalNanoseconds;
+	uint64_t p50;
+	uint64_t p90;
+	uint64_t p99;
+	uint64_t max;
+};
+
+struct Summary {
+	uint64_t frames;
+	uint64_t gameOverFrames;
+	uint64_t failures[failureKinds]; ///< Frames that failed, by SearchError (failures[SE_NONE] is the ones that didn't, not counting game over)
+	uint64_t bytesRead;
+	uint64_t wallNanoseconds;
+	uint32_t threads;
+	uint32_t reserved;
+	uint64_t steals; ///< Times a thread ran out of frames and took some from another
+	StageSummary stages[ST_COUNT];
+};
+
+static_assert(sizeof(FileHeader) == 24 && sizeof(RecordingHeader) == 24 && sizeof(FrameResult) == 120 &&
+              sizeof(Summary) == 112 + ST_COUNT * sizeof(StageSummary),
+              "Batch output structs must not be padded");
+
+} // end namespace BatchOutput
+
+#endif
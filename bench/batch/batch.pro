@@ -0,0 +1,47 @@
+#-------------------------------------------------
+#
+# Runs the detectors over recorded sessions on every core.
+# Runs headless: no X server or Qt needed.
+#
+#-------------------------------------------------
+
+TARGET = flapperbatch
+TEMPLATE = app
+
+CONFIG += c++11 release console thread
+CONFIG -= qt app_bundle
+
+QMAKE_CXXFLAGS += -Wall -Wextra
+
+INCLUDEPATH += ../..
+
+SOURCES += BatchAnalyzer.cpp \
+../../FrameRecording.cpp \
+../../WorkStealingScheduler.cpp \
+../../VideoFrame.cpp \
+../../FlappySearches.cpp \
+../../PixelConversion.cpp \
+../../HSVConversion.cpp \
+../../TileClassifier.cpp \
+../../BitMask.cpp \
+../../RectangleSet.cpp \
+../../FrameArena.cpp \
+../../Trace.cpp
+
+HEADERS += BatchOutput.hpp \
+../../FrameRecording.hpp \
+../../WorkStealingScheduler.hpp \
+../../VideoFrame.hpp \
+../../FlappySearches.hpp \
+../../PixelConversion.hpp \
+../../HSVConversion.hpp \
+../../TileClassifier.hpp \
+../../BitMask.hpp \
+../../RectangleSet.hpp \
+../../FrameArena.hpp \
+../../LatencyHistogram.hpp \
+../../Trace.hpp \
+../../FlappyColors.hpp \
+../../Rectangle.hpp \
+../../Exceptions.hpp \
+../../MKMath.hpp
@@ -0,0 +1,57 @@
+#-------------------------------------------------
+#
+# Microbenchmarks for the detection and conversion kernels.
+# Runs headless: no X server or Qt needed.
+#
+#-------------------------------------------------
+
+TARGET = flapperbench
+TEMPLATE = app
+
+CONFIG += c++11 release console thread
+CONFIG -= qt app_bundle
+
+QMAKE_CXXFLAGS += -Wall -Wextra
+
+INCLUDEPATH += ..
+
+SOURCES += Benchmarks.cpp \
+../VideoFrame.cpp \
+../FlappySearches.cpp \
+../PixelConversion.cpp \
+../FrameSynthesizer.cpp \
+../HSVConversion.cpp \
+../TileClassifier.cpp \
+../BitMask.cpp \
+../RectangleSet.cpp \
+../FrameArena.cpp \
+../PhysicsAnalysis.cpp \
+../FlapFitter.cpp \
+../FlapPlanner.cpp \
+../BirdAI.cpp \
+../Trace.cpp \
+../FrameRecording.cpp \
+../WorkStealingScheduler.cpp
+
+HEADERS += ../VideoFrame.hpp \
+../FlappySearches.hpp \
+../PixelConversion.hpp \
+../FrameSynthesizer.hpp \
+../HSVConversion.hpp \
+../TileClassifier.hpp \
+../BitMask.hpp \
+../RectangleSet.hpp \
+../FrameArena.hpp \
+../PhysicsAnalysis.hpp \
+../FlapFitter.hpp \
+../FlapPlanner.hpp \
+../BirdAI.hpp \
+../ScreenIO.hpp \
+../Trace.hpp \
+../FrameRecording.hpp \
+../WorkStealingScheduler.hpp \
+../TimeSource.hpp \
+../FlappyColors.hpp \
+../Rectangle.hpp \
+../Exceptions.hpp \
+../MKMath.hpp
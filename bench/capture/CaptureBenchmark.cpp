@@ -0,0 +1,568 @@
+/**
+ * \file CaptureBenchmark.cpp
+ *
+ * Measures capture throughput end to end, against real X servers.
+ * For each screen size and depth, an Xvfb server is started and a window in the middle of it is animated with
+ * synthetic game frames. Each ScreenIO backend then captures the full screen and the game window,
+ * both directly and through a BufferedFrameFetcher, while frame rates, latencies, and the CPU time spent
+ * by us and by the server are measured.
+ *
+ * Results go to stdout, either as a table or (with --json) as one JSON object per line, for regression tracking.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "BufferedFrameFetcher.hpp"
+#include "Exceptions.hpp"
+#include "FrameSynthesizer.hpp"
+#include "LatencyHistogram.hpp"
+#include "ScreenIO.hpp"
+#include "ScreenIOBackends.hpp"
+#include "XCBScreenIO.hpp"
+
+using namespace std;
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+
+/// Options from the command line
+struct Options {
+	double seconds = 3.0; ///< How long to run each case
+	int drawRate = 60; ///< Frames per second drawn into the game window
+	vector<string> backends = { "x11", "xcb" };
+	const char* xvfb = "Xvfb"; ///< The X server to run
+	bool json = false; ///< Print JSON Lines instead of a table
+};
+
+/// A screen configuration to start a server with
+struct ServerConfig {
+	int width, height, depth;
+
+	string name() const
+	{
+		return to_string(width) + "x" + to_string(height) + "x" + to_string(depth);
+	}
+};
+
+/// CPU time used by this process so far, in seconds
+double processCPUSeconds()
+{
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (double)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+	       (double)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+/// CPU time used by the calling thread so far, in seconds
+double threadCPUSeconds()
+{
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/// CPU time used by another process so far, in seconds, or a negative value if it can't be read
+double childCPUSeconds(pid_t pid)
+{
+	const string path = "/proc/" + to_string(pid) + "/stat";
+	FILE* f = fopen(path.c_str(), "r");
+	if (f == nullptr)
+		return -1.0;
+
+	char buf[1024];
+	const size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+	fclose(f);
+	buf[len] = '\0';
+
+	// The command name is in parentheses and can contain spaces, so start counting fields after it.
+	// utime and stime are the 14th and 15th fields, and the closing parenthesis ends the 2nd.
+	const char* p = strrchr(buf, ')');
+	unsigned long utime, stime;
+	if (p == nullptr || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2)
+		return -1.0;
+	return (double)(utime + stime) / (double)sysconf(_SC_CLK_TCK);
+}
+
+/// An Xvfb server that lives as long as the object does
+class XvfbServer {
+
+public:
+
+	/// Starts the server and waits until it accepts connections
+	XvfbServer(const char* executable, const ServerConfig& config)
+	{
+		// -displayfd has the server pick a free display and write its number to the pipe once it's ready
+		int fds[2];
+		if (pipe(fds) != 0)
+			throw Exceptions::IOException("Could not create a pipe for Xvfb", __FUNCTION__);
+
+		const string fd = to_string(fds[1]);
+		const string screen = to_string(config.width) + "x" + to_string(config.height) + "x" +
+		                      to_string(config.depth);
+
+		pid = fork();
+		if (pid < 0) {
+			close(fds[0]);
+			close(fds[1]);
+			throw Exceptions::IOException("Could not fork to run Xvfb", __FUNCTION__);
+		}
+		if (pid == 0) {
+			close(fds[0]);
+			// Keep the server's chatter out of our output
+			const int devNull = open("/dev/null", O_WRONLY);
+			dup2(devNull, STDOUT_FILENO);
+			dup2(devNull, STDERR_FILENO);
+			execlp(executable, executable, "-displayfd", fd.c_str(), "-screen", "0", screen.c_str(),
+			       "-nolisten", "tcp", "+extension", "MIT-SHM", "+extension", "DAMAGE", (char*)nullptr);
+			_exit(127);
+		}
+		close(fds[1]);
+
+		string number;
+		pollfd pfd = { fds[0], POLLIN, 0 };
+		char c;
+		while (poll(&pfd, 1, 10000) > 0 && read(fds[0], &c, 1) == 1 && c != '\n')
+			number += c;
+		close(fds[0]);
+
+		if (number.empty()) {
+			stop();
+			throw Exceptions::IOException(string("Could not start ") + executable + " with screen " + screen,
+			                              __FUNCTION__);
+		}
+		display = ":" + number;
+	}
+
+	~XvfbServer() { stop(); }
+
+	/// The display name to connect to, e.g. ":1"
+	const string& getDisplay() const { return display; }
+
+	pid_t getPID() const { return pid; }
+
+	XvfbServer(const XvfbServer&) = delete;
+	XvfbServer& operator=(const XvfbServer&) = delete;
+
+private:
+
+	void stop()
+	{
+		if (pid <= 0)
+			return;
+		kill(pid, SIGTERM);
+		waitpid(pid, nullptr, 0);
+		pid = -1;
+	}
+
+	pid_t pid = -1;
+	string display;
+};
+
+/**
+ * \brief Plays a synthetic game in a window on its own connection and thread
+ *
+ * The bird bobs up and down and the pipes scroll along, so every drawn frame differs from the last,
+ * like the real game.
+ */
+class Animator {
+
+public:
+
+	/// Opens a window covering the given rectangle of the default display and starts drawing into it
+	Animator(const Rectangle& where, int framesPerSecond) :
+		rect(where), rate(framesPerSecond), synth((size_t)where.getWidth(), (size_t)where.getHeight()),
+		frame((size_t)where.getWidth(), (size_t)where.getHeight(), 3, false)
+	{
+		display = XOpenDisplay(nullptr);
+		if (display == nullptr)
+			throw Exceptions::IOException("Could not open a display to draw on", __FUNCTION__);
+
+		const int screen = DefaultScreen(display);
+		if (DefaultDepth(display, screen) != 24) {
+			XCloseDisplay(display);
+			throw Exceptions::IOException("Can only draw on a 24-bit display", __FUNCTION__);
+		}
+
+		// There's no window manager under Xvfb, but make sure nothing moves the window if there ever is one
+		XSetWindowAttributes attributes;
+		attributes.override_redirect = True;
+		window = XCreateWindow(display, RootWindow(display, screen), rect.left, rect.top,
+		                       (unsigned int)rect.getWidth(), (unsigned int)rect.getHeight(), 0, CopyFromParent,
+		                       InputOutput, CopyFromParent, CWOverrideRedirect, &attributes);
+		XMapWindow(display, window);
+
+		// XDestroyImage frees the pixels along with the image, so they need to come from malloc
+		const size_t pitch = (size_t)rect.getWidth() * 4;
+		char* pixels = (char*)malloc(pitch * (size_t)rect.getHeight());
+		image = XCreateImage(display, DefaultVisual(display, screen), 24, ZPixmap, 0, pixels,
+		                     (unsigned int)rect.getWidth(), (unsigned int)rect.getHeight(), 32, (int)pitch);
+
+		draw(0);
+		XSync(display, False);
+
+		running = true;
+		worker = thread(&Animator::workerProc, this);
+	}
+
+	~Animator()
+	{
+		running = false;
+		worker.join();
+		XDestroyImage(image);
+		XDestroyWindow(display, window);
+		XCloseDisplay(display);
+	}
+
+	/// CPU time the drawing thread has used so far, in seconds, so it can be left out of our own
+	double getCPUSeconds() const { return cpuSeconds; }
+
+	Animator(const Animator&) = delete;
+	Animator& operator=(const Animator&) = delete;
+
+private:
+
+	void workerProc()
+	{
+		const auto period = chrono::duration_cast<Clock::duration>(chrono::duration<double>(1.0 / rate));
+		auto next = Clock::now();
+		for (int i = 1; running; ++i) {
+			draw(i);
+			XSync(display, False);
+			cpuSeconds = threadCPUSeconds();
+
+			next += period;
+			this_thread::sleep_until(next);
+		}
+	}
+
+	void draw(int step)
+	{
+		const int h = rect.getHeight();
+		const int birdY = h / 2 + (int)((double)h / 8 * ((step % 60 < 30) ? step % 30 : 30 - step % 30) / 30.0);
+		synth.render(synth.typicalScene(step * 3, birdY), frame);
+
+		// To the 0x00RRGGBB pixels a 24-bit TrueColor visual expects
+		for (size_t y = 0; y < frame.getHeight(); ++y) {
+			uint32_t* line = (uint32_t*)(image->data + y * (size_t)image->bytes_per_line);
+			const uint8_t* pix = frame.getPixel(0, y);
+			for (size_t x = 0; x < frame.getWidth(); ++x, pix += 3)
+				line[x] = ((uint32_t)pix[0] << 16) | ((uint32_t)pix[1] << 8) | (uint32_t)pix[2];
+		}
+
+		XPutImage(display, window, DefaultGC(display, DefaultScreen(display)), image, 0, 0, 0, 0,
+		          (unsigned int)rect.getWidth(), (unsigned int)rect.getHeight());
+	}
+
+	const Rectangle rect;
+	const int rate;
+	FrameSynthesizer synth;
+	VideoFrame frame;
+
+	Display* display;
+	Window window;
+	XImage* image;
+
+	thread worker;
+	atomic<bool> running;
+	atomic<double> cpuSeconds = { 0.0 };
+};
+
+/// What one case measured
+struct Result {
+	string server;
+	string backend;
+	bool sharedMemory = false;
+	string region; ///< "full" or "game"
+	string mode; ///< "direct", "fetcher/continuous", or "fetcher/damage"
+	int width = 0, height = 0;
+	double seconds = 0; ///< How long the case actually ran
+	size_t frames = 0;
+	size_t uniqueFrames = 0; ///< Frames that weren't tagged as duplicates
+	LatencyHistogram::Snapshot latency; ///< Time spent in each getFrame call
+	double clientCPU = 0; ///< Our CPU use (drawing excluded), as a fraction of one core
+	double serverCPU = 0; ///< The server's CPU use (drawing included), as a fraction of one core
+};
+
+/// Takes CPU readings at the start of a case and works out usage at the end
+class CPUMeter {
+
+public:
+
+	CPUMeter(const Animator& a, pid_t server) : animator(a), serverPID(server), start(Clock::now()),
+		processStart(processCPUSeconds()), animatorStart(a.getCPUSeconds()), serverStart(childCPUSeconds(server))
+	{ }
+
+	void finish(Result& r) const
+	{
+		r.seconds = chrono::duration<double>(Clock::now() - start).count();
+		r.clientCPU = ((processCPUSeconds() - processStart) - (animator.getCPUSeconds() - animatorStart)) / r.seconds;
+		const double serverEnd = childCPUSeconds(serverPID);
+		r.serverCPU = (serverStart < 0 || serverEnd < 0) ? -1.0 : (serverEnd - serverStart) / r.seconds;
+	}
+
+private:
+
+	const Animator& animator;
+	const pid_t serverPID;
+	const Clock::time_point start;
+	const double processStart;
+	const double animatorStart;
+	const double serverStart;
+};
+
+Result measureDirect(const Options& opts, ScreenIO& io, const Animator& animator, pid_t server)
+{
+	LatencyHistogram histogram;
+	Result r;
+	r.mode = "direct";
+
+	// One untimed capture to get any buffers set up
+	io.getFrame();
+
+	CPUMeter meter(animator, server);
+	const auto end = Clock::now() + chrono::duration_cast<Clock::duration>(chrono::duration<double>(opts.seconds));
+	uint64_t lastHash = 0;
+	while (Clock::now() < end) {
+		const auto before = Clock::now();
+		auto frame = io.getFrame();
+		histogram.record((uint64_t)chrono::duration_cast<chrono::nanoseconds>(Clock::now() - before).count());
+
+		const uint64_t hash = frame->contentHash();
+		if (r.frames == 0 || hash != lastHash)
+			++r.uniqueFrames;
+		lastHash = hash;
+		r.width = (int)frame->getWidth();
+		r.height = (int)frame->getHeight();
+		++r.frames;
+	}
+	meter.finish(r);
+	r.latency = histogram.snapshot();
+	return r;
+}
+
+Result measureFetcher(const Options& opts, ScreenIO& io, const Animator& animator, pid_t server,
+                      BufferedFrameFetcher::CaptureMode captureMode)
+{
+	LatencyHistogram histogram;
+	Result r;
+	r.mode = captureMode == BufferedFrameFetcher::CM_CONTINUOUS ? "fetcher/continuous" : "fetcher/damage";
+
+	CPUMeter meter(animator, server);
+	{
+		BufferedFrameFetcher fetcher(&io, captureMode);
+		const auto end = Clock::now() + chrono::duration_cast<Clock::duration>(chrono::duration<double>(opts.seconds));
+		while (Clock::now() < end) {
+			const auto before = Clock::now();
+			auto frame = fetcher.getFrame();
+			histogram.record((uint64_t)chrono::duration_cast<chrono::nanoseconds>(Clock::now() - before).count());
+
+			if (!frame->isDuplicate())
+				++r.uniqueFrames;
+			r.width = (int)frame->getWidth();
+			r.height = (int)frame->getHeight();
+			++r.frames;
+		}
+	}
+	meter.finish(r);
+	r.latency = histogram.snapshot();
+	return r;
+}
+
+void printHeader(const Options& opts)
+{
+	if (opts.json)
+		return;
+	printf("%-16s %-4s %-4s %-18s %9s %9s %9s %10s %10s %7s %7s\n", "server", "io", "shm", "region/mode",
+	       "size", "fps", "unique", "p50 ms", "p99 ms", "cpu %", "X cpu %");
+}
+
+void printResult(const Options& opts, const Result& r)
+{
+	const double p50 = (double)r.latency.valueAtQuantile(0.5) / 1e6;
+	const double p99 = (double)r.latency.valueAtQuantile(0.99) / 1e6;
+	const double maxMs = (double)r.latency.max() / 1e6;
+
+	if (opts.json) {
+		printf("{\"server\":\"%s\",\"backend\":\"%s\",\"shm\":%s,\"region\":\"%s\",\"mode\":\"%s\","
+		       "\"width\":%d,\"height\":%d,\"seconds\":%.3f,\"frames\":%zu,\"unique_frames\":%zu,"
+		       "\"fps\":%.2f,\"unique_fps\":%.2f,\"latency_ms\":{\"p50\":%.3f,\"p99\":%.3f,\"max\":%.3f},"
+		       "\"client_cpu\":%.3f,\"server_cpu\":%.3f}\n",
+		       r.server.c_str(), r.backend.c_str(), r.sharedMemory ? "true" : "false", r.region.c_str(),
+		       r.mode.c_str(), r.width, r.height, r.seconds, r.frames, r.uniqueFrames,
+		       (double)r.frames / r.seconds, (double)r.uniqueFrames / r.seconds, p50, p99, maxMs,
+		       r.clientCPU, r.serverCPU);
+	}
+	else {
+		const string what = r.region + "/" + r.mode;
+		const string size = to_string(r.width) + "x" + to_string(r.height);
+		printf("%-16s %-4s %-4s %-18s %9s %9.1f %9.1f %10.3f %10.3f %7.1f %7.1f\n", r.server.c_str(),
+		       r.backend.c_str(), r.sharedMemory ? "yes" : "no", what.c_str(), size.c_str(),
+		       (double)r.frames / r.seconds, (double)r.uniqueFrames / r.seconds, p50, p99,
+		       r.clientCPU * 100, r.serverCPU * 100);
+	}
+	fflush(stdout);
+}
+
+/// Reports a case (or a whole server) that couldn't be run
+void printError(const Options& opts, const string& server, const string& backend, const string& message)
+{
+	if (opts.json) {
+		string escaped;
+		for (char c : message) {
+			if (c == '"' || c == '\\')
+				escaped += '\\';
+			escaped += c;
+		}
+		printf("{\"server\":\"%s\",\"backend\":\"%s\",\"error\":\"%s\"}\n", server.c_str(), backend.c_str(),
+		       escaped.c_str());
+	}
+	else {
+		printf("%-16s %-4s %s\n", server.c_str(), backend.c_str(), message.c_str());
+	}
+	fflush(stdout);
+}
+
+/// Runs every backend, region, and mode against one server
+void runServer(const Options& opts, const ServerConfig& config)
+{
+	const string serverName = config.name();
+
+	unique_ptr<XvfbServer> server;
+	try {
+		server.reset(new XvfbServer(opts.xvfb, config));
+	}
+	catch (const Exceptions::Exception& ex) {
+		printError(opts, serverName, "-", ex.message);
+		return;
+	}
+	setenv("DISPLAY", server->getDisplay().c_str(), 1);
+
+	// The game window, sized and placed like DisplayWindow would find it on a desktop
+	const int gameHeight = config.height * 2 / 3;
+	const int gameWidth = gameHeight * 5 / 7;
+	const int left = (config.width - gameWidth) / 2;
+	const int top = (config.height - gameHeight) / 2;
+	const Rectangle gameRect(left, top, left + gameWidth - 1, top + gameHeight - 1);
+
+	unique_ptr<Animator> animator;
+	try {
+		animator.reset(new Animator(gameRect, opts.drawRate));
+	}
+	catch (const Exceptions::Exception& ex) {
+		printError(opts, serverName, "-", ex.message);
+		return;
+	}
+
+	for (const string& backend : opts.backends) {
+		unique_ptr<ScreenIO> io;
+		try {
+			io = createScreenIO(backend);
+		}
+		catch (const Exceptions::Exception& ex) {
+			printError(opts, serverName, backend, ex.message);
+			continue;
+		}
+		const XCBScreenIO* xcb = dynamic_cast<const XCBScreenIO*>(io.get());
+		const bool sharedMemory = xcb != nullptr && xcb->usingSharedMemory();
+
+		for (const bool focused : { false, true }) {
+			if (focused)
+				io->focusOn(gameRect);
+			else
+				io->resetFocus();
+
+			vector<Result> results;
+			results.push_back(measureDirect(opts, *io, *animator, server->getPID()));
+			results.push_back(measureFetcher(opts, *io, *animator, server->getPID(),
+			                                 BufferedFrameFetcher::CM_CONTINUOUS));
+			results.push_back(measureFetcher(opts, *io, *animator, server->getPID(),
+			                                 BufferedFrameFetcher::CM_ON_DAMAGE));
+
+			for (Result& r : results) {
+				r.server = serverName;
+				r.backend = backend;
+				r.sharedMemory = sharedMemory;
+				r.region = focused ? "game" : "full";
+				printResult(opts, r);
+			}
+		}
+	}
+}
+
+void usage(const char* argv0)
+{
+	fprintf(stderr, "Usage: %s [--seconds <per case>] [--draw-fps <rate>] [--backends <x11,xcb>] [--xvfb <path>]"
+	        " [--json]\n",
+	        argv0);
+	exit(1);
+}
+
+vector<string> split(const string& s, char delimiter)
+{
+	vector<string> ret;
+	size_t start = 0;
+	for (size_t end; (end = s.find(delimiter, start)) != string::npos; start = end + 1)
+		ret.push_back(s.substr(start, end - start));
+	ret.push_back(s.substr(start));
+	return ret;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char** argv)
+{
+	Options opts;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+			opts.seconds = atof(argv[++i]);
+		else if (strcmp(argv[i], "--draw-fps") == 0 && i + 1 < argc)
+			opts.drawRate = max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--backends") == 0 && i + 1 < argc)
+			opts.backends = split(argv[++i], ',');
+		else if (strcmp(argv[i], "--xvfb") == 0 && i + 1 < argc)
+			opts.xvfb = argv[++i];
+		else if (strcmp(argv[i], "--json") == 0)
+			opts.json = true;
+		else
+			usage(argv[0]);
+	}
+
+	// Several threads here talk to X, as they do in the real program
+	XInitThreads();
+
+	// The backends only support 24-bit displays, but the 16-bit servers are included
+	// so that the results show it (as errors), and will pick it up if that ever changes.
+	const vector<ServerConfig> configs = {
+		{ 1280, 720, 24 }, { 1920, 1080, 24 }, { 3840, 2160, 24 },
+		{ 1280, 720, 16 }, { 1920, 1080, 16 }
+	};
+
+	printHeader(opts);
+	for (const ServerConfig& config : configs)
+		runServer(opts, config);
+
+	return 0;
+}
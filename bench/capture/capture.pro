@@ -0,0 +1,45 @@
+#-------------------------------------------------
+#
+# End-to-end capture benchmark.
+# Starts its own Xvfb servers, so it needs Xvfb installed but no desktop.
+#
+#-------------------------------------------------
+
+TARGET = flappercapturebench
+TEMPLATE = app
+
+CONFIG += c++11 release console thread
+CONFIG -= qt app_bundle
+
+LIBS += -lX11 -lXtst -lXdamage -lxcb -lxcb-shm -lxcb-xtest
+
+QMAKE_CXXFLAGS += -Wall -Wextra
+
+INCLUDEPATH += ../..
+
+SOURCES += CaptureBenchmark.cpp \
+../../X11ScreenIO.cpp \
+../../XCBScreenIO.cpp \
+../../ScreenIOBackends.cpp \
+../../BufferedFrameFetcher.cpp \
+../../VideoFrame.cpp \
+../../HSVConversion.cpp \
+../../PixelConversion.cpp \
+../../FrameSynthesizer.cpp \
+../../Trace.cpp
+
+HEADERS += ../../ScreenIO.hpp \
+../../X11ScreenIO.hpp \
+../../XCBScreenIO.hpp \
+../../ScreenIOBackends.hpp \
+../../BufferedFrameFetcher.hpp \
+../../VideoFrame.hpp \
+../../HSVConversion.hpp \
+../../PixelConversion.hpp \
+../../FrameSynthesizer.hpp \
+../../FPSTracker.hpp \
+../../LatencyHistogram.hpp \
+../../Trace.hpp \
+../../TimeSource.hpp \
+../../Rectangle.hpp \
+../../Exceptions.hpp
@@ -0,0 +1,341 @@
+/**
+ * \file SimulatedGames.cpp
+ *
+ * Plays games of Flappy Bird against SimulatedScreenIO, running each frame through the same detection and AI
+ * steps as the play loop in DisplayWindow, and reports the distribution of scores for each AI configuration.
+ * Every configuration plays the same courses, so their results can be compared game for game.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "BirdAI.hpp"
+#include "FlappySearches.hpp"
+#include "FrameArena.hpp"
+#include "FrameRecording.hpp"
+#include "PhysicsAnalysis.hpp"
+#include "SimulatedScreenIO.hpp"
+#include "TileClassifier.hpp"
+#include "VideoFrame.hpp"
+
+using namespace std;
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+	int games = 20; ///< Games per configuration
+	size_t width = 500;
+	size_t height = 700;
+	uint32_t seed = 1; ///< Game i of each configuration plays the course seeded with seed + i
+	float speed = 0; ///< Multiple of real time to play at (e.g. 1 to follow along with --verbose), or 0 to not wait
+	float maxSeconds = 60; ///< Games still going after this long (in game time) are stopped and count as survived
+	bool verbose = false; ///< Let the AI talk about what it's doing
+	const char* record = nullptr; ///< Where to record the first scored game, if anywhere
+	vector<string> configurations; ///< Which configurations to play, or empty for all of them
+};
+
+/// A way of setting up the AI to compare against others
+struct Configuration {
+	const char* name;
+	bool planning; ///< Use the flap planner, or just the heuristic
+};
+
+const Configuration configurations[] = {
+	{ "heuristic", false },
+	{ "planner", true },
+};
+
+struct GameResult {
+	int score = 0;
+	bool survived = false; ///< Still alive when the game was stopped
+	uint64_t frames = 0;
+	size_t failures = 0; ///< Frames that detection or the AI reported an error on
+};
+
+/// Keeps the AI's running commentary out of the results
+class QuietStdout {
+
+public:
+
+	explicit QuietStdout(bool quiet) : savedStdout(-1)
+	{
+		if (!quiet)
+			return;
+		fflush(stdout);
+		savedStdout = dup(STDOUT_FILENO);
+		const int devNull = open("/dev/null", O_WRONLY);
+		dup2(devNull, STDOUT_FILENO);
+		close(devNull);
+	}
+
+	~QuietStdout()
+	{
+		if (savedStdout < 0)
+			return;
+		fflush(stdout);
+		dup2(savedStdout, STDOUT_FILENO);
+		close(savedStdout);
+	}
+
+	QuietStdout(const QuietStdout&) = delete;
+	QuietStdout& operator=(const QuietStdout&) = delete;
+
+private:
+
+	int savedStdout;
+};
+
+/**
+ * \brief Plays one game the way DisplayWindow does, until the bird dies or time runs out
+ * \param calibration A calibration to start the AI from, or nullptr to have it run the jump tests
+ * \param learned If not nullptr, gets the AI's calibration at the end of the game
+ * \param calibrated If not nullptr, set to whether learned got a whole calibration, jump width included
+ * \param recorder If not nullptr, every frame of the game is recorded to it
+ */
+GameResult playGame(const Options& opts, SimulatedScreenIO& sim, uint32_t seed, const Configuration& config,
+                    const BirdAI::Calibration* calibration, BirdAI::Calibration* learned = nullptr,
+                    bool* calibrated = nullptr, FrameRecorder* recorder = nullptr)
+{
+	sim.newGame(seed);
+
+	// Everything times the game by the game's clock, so it plays the same however fast it runs
+	PhysicsAnalysis physics(10, sim.getClock());
+	BirdAI ai(physics, &sim, sim.getClock());
+	ai.setOverlay(false);
+	ai.setPlanning(config.planning);
+	if (calibration != nullptr)
+		ai.setCalibration(*calibration);
+
+	TileClassifier tiles;
+	FrameArena arena;
+	const Rectangle gameRect = sim.getScreenBounds();
+
+	sim.mouseTo(gameRect.getCenter());
+	sim.click();
+
+	// Stop games that go on too long, and ones where the AI never gets going
+	const uint64_t maxFrames = (uint64_t)(opts.maxSeconds * sim.getRules().frameRate);
+	const auto realStart = Clock::now();
+	const auto virtualStart = sim.now();
+
+	GameResult ret;
+	while (!sim.isOver() && sim.getFramesRendered() < maxFrames) {
+		shared_ptr<VideoFrame> frame = sim.getFrame();
+		if (recorder != nullptr)
+			recorder->record(*frame, true);
+
+		if (opts.speed > 0)
+			this_thread::sleep_until(realStart + chrono::duration_cast<Clock::duration>(
+			                                         (sim.now() - virtualStart) / (double)opts.speed));
+
+		arena.reset();
+		if (gameOver(*frame))
+			break;
+
+		tiles.update(*frame);
+		const SearchResult<Point> beakLocation = findBeakLocation(tiles, &arena);
+		if (!beakLocation.found()) {
+			++ret.failures;
+			continue;
+		}
+		Rectangle bird = findBird(*frame, beakLocation.value);
+		bird.expandBy(5); // Give ourselves some padding
+		SearchResult<RectangleList> pipes = findPipesByColumns(*frame, &arena);
+		if (!pipes.found()) {
+			++ret.failures;
+			continue;
+		}
+
+		physics.logPosition(bird.getCenter().y);
+
+		BirdAI::StatusPacket statusPack(gameRect, bird, std::move(pipes.value));
+		if (ai.iterate(statusPack, *frame) != BirdAI::AE_NONE)
+			++ret.failures;
+	}
+
+	ret.score = sim.getScore();
+	ret.survived = !sim.isOver();
+	ret.frames = sim.getFramesRendered();
+	if (learned != nullptr) {
+		const bool got = ai.getCalibration(*learned);
+		if (calibrated != nullptr)
+			*calibrated = got && learned->jumpWidth > 0;
+	}
+	return ret;
+}
+
+/// The score below which a fraction of the (sorted) scores fall
+int percentile(const vector<int>& sorted, float fraction)
+{
+	const size_t i = min(sorted.size() - 1, (size_t)(fraction * (float)(sorted.size() - 1) + 0.5f));
+	return sorted[i];
+}
+
+void printHeader()
+{
+	printf("%-12s %6s %7s %5s %5s %5s %5s %9s %14s %13s\n", "config", "games", "mean", "p10", "p50", "p90", "max",
+	       "survived", "failures/frame", "games/minute");
+}
+
+void printResults(const Configuration& config, const vector<GameResult>& results, double wallSeconds)
+{
+	vector<int> scores;
+	size_t survived = 0;
+	size_t failures = 0;
+	uint64_t frames = 0;
+	for (const auto& r : results) {
+		scores.push_back(r.score);
+		survived += r.survived ? 1 : 0;
+		failures += r.failures;
+		frames += r.frames;
+	}
+	sort(scores.begin(), scores.end());
+
+	double mean = 0;
+	for (int s : scores)
+		mean += s;
+	mean /= (double)scores.size();
+
+	printf("%-12s %6zu %7.2f %5d %5d %5d %5d %9zu %14.4f %13.1f\n", config.name, results.size(), mean,
+	       percentile(scores, 0.1f), percentile(scores, 0.5f), percentile(scores, 0.9f), scores.back(), survived,
+	       frames > 0 ? (double)failures / (double)frames : 0.0, (double)results.size() * 60 / wallSeconds);
+
+	// How many games scored 0, 1, 2-3, 4-7, and so on
+	printf("%-12s", "");
+	int low = 0;
+	for (int high = 0; low <= scores.back(); low = high + 1, high = high * 2 + 1) {
+		const auto count = upper_bound(scores.begin(), scores.end(), high) - lower_bound(scores.begin(), scores.end(), low);
+		if (low == high)
+			printf(" %d:%d", low, (int)count);
+		else
+			printf(" %d-%d:%d", low, high, (int)count);
+	}
+	printf("\n");
+	fflush(stdout);
+}
+
+void usage(const char* argv0)
+{
+	fprintf(stderr, "Usage: %s [--games <per configuration>] [--size <width>x<height>] [--seed <first course>]"
+	        " [--speed <multiple of real time, 0 for no waiting>] [--max-seconds <per game>]"
+	        " [--config <name>]... [--verbose] [--record <file>]\n",
+	        argv0);
+	fprintf(stderr, "Configurations:");
+	for (const auto& c : configurations)
+		fprintf(stderr, " %s", c.name);
+	fprintf(stderr, "\n");
+	exit(1);
+}
+
+} // end anonymous namespace
+
+int main(int argc, char** argv)
+{
+	Options opts;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--games") == 0 && i + 1 < argc)
+			opts.games = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+			unsigned int w, h;
+			if (sscanf(argv[++i], "%ux%u", &w, &h) != 2)
+				usage(argv[0]);
+			opts.width = w;
+			opts.height = h;
+		}
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			opts.seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc)
+			opts.speed = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--max-seconds") == 0 && i + 1 < argc)
+			opts.maxSeconds = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--config") == 0 && i + 1 < argc)
+			opts.configurations.push_back(argv[++i]);
+		else if (strcmp(argv[i], "--verbose") == 0)
+			opts.verbose = true;
+		else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+			opts.record = argv[++i];
+		else
+			usage(argv[0]);
+	}
+
+	if (opts.games < 1 || opts.speed < 0 || opts.maxSeconds <= 0)
+		usage(argv[0]);
+
+	vector<const Configuration*> chosen;
+	for (const auto& c : configurations) {
+		if (opts.configurations.empty() ||
+		    find(opts.configurations.begin(), opts.configurations.end(), c.name) != opts.configurations.end())
+			chosen.push_back(&c);
+	}
+	if (chosen.empty() || chosen.size() < opts.configurations.size())
+		usage(argv[0]);
+
+	SimulatedScreenIO sim(opts.width, opts.height, opts.seed);
+
+	// Calibrate once, on a course with a long run-up so the jump tests finish before the first pipe,
+	// then start every scored game from that, as the app does with a saved calibration
+	BirdAI::Calibration calibration;
+	bool calibrated = false;
+	{
+		SimulatedScreenIO::Rules rules = sim.getDefaultRules();
+		rules.leadIn = 10;
+		sim.setRules(rules);
+		QuietStdout quiet(!opts.verbose);
+		playGame(opts, sim, opts.seed, *chosen.front(), nullptr, &calibration, &calibrated);
+		sim.setRules(sim.getDefaultRules());
+	}
+	if (!calibrated) {
+		fprintf(stderr, "The AI didn't finish calibrating in a %zux%zu game\n", opts.width, opts.height);
+		return 1;
+	}
+	printf("Calibrated: jump height %d pixels over %.3f s, %d pixels wide\n", calibration.jumpHeight,
+	       calibration.jumpDuration, calibration.jumpWidth);
+
+	// The first scored game can be recorded for flapperbatch
+	unique_ptr<FrameRecorder> recorder;
+	if (opts.record != nullptr) {
+		try {
+			recorder.reset(new FrameRecorder(opts.record, opts.width, opts.height));
+		}
+		catch (const Exceptions::IOException& e) {
+			fprintf(stderr, "%s\n", e.message.c_str());
+			return 1;
+		}
+	}
+
+	printHeader();
+	for (const Configuration* config : chosen) {
+		vector<GameResult> results;
+		const auto start = Clock::now();
+		{
+			QuietStdout quiet(!opts.verbose);
+			for (int i = 0; i < opts.games; ++i) {
+				results.push_back(playGame(opts, sim, opts.seed + (uint32_t)i, *config, &calibration, nullptr,
+				                           nullptr, recorder.get()));
+				if (recorder) {
+					recorder->finish();
+					if (recorder->hasFailed())
+						fprintf(stderr, "Could not write all of %s\n", opts.record);
+					recorder.reset();
+				}
+			}
+		}
+		const double wallSeconds = chrono::duration<double>(Clock::now() - start).count();
+		printResults(*config, results, wallSeconds);
+	}
+
+	return 0;
+}
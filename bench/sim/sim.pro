@@ -0,0 +1,57 @@
+#-------------------------------------------------
+#
+# Plays simulated games with the AI and reports its scores.
+# Runs headless: no X server or Qt needed.
+#
+#-------------------------------------------------
+
+TARGET = flappersim
+TEMPLATE = app
+
+CONFIG += c++11 release console thread
+CONFIG -= qt app_bundle
+
+QMAKE_CXXFLAGS += -Wall -Wextra
+
+INCLUDEPATH += ../..
+
+SOURCES += SimulatedGames.cpp \
+../../SimulatedScreenIO.cpp \
+../../VideoFrame.cpp \
+../../FlappySearches.cpp \
+../../PixelConversion.cpp \
+../../FrameSynthesizer.cpp \
+../../HSVConversion.cpp \
+../../TileClassifier.cpp \
+../../BitMask.cpp \
+../../RectangleSet.cpp \
+../../FrameArena.cpp \
+../../PhysicsAnalysis.cpp \
+../../FlapFitter.cpp \
+../../FlapPlanner.cpp \
+../../BirdAI.cpp \
+../../FrameRecording.cpp \
+../../Trace.cpp
+
+HEADERS += ../../SimulatedScreenIO.hpp \
+../../ScreenIO.hpp \
+../../VideoFrame.hpp \
+../../FlappySearches.hpp \
+../../PixelConversion.hpp \
+../../FrameSynthesizer.hpp \
+../../HSVConversion.hpp \
+../../TileClassifier.hpp \
+../../BitMask.hpp \
+../../RectangleSet.hpp \
+../../FrameArena.hpp \
+../../PhysicsAnalysis.hpp \
+../../FlapFitter.hpp \
+../../FlapPlanner.hpp \
+../../BirdAI.hpp \
+../../FrameRecording.hpp \
+../../Trace.hpp \
+../../TimeSource.hpp \
+../../FlappyColors.hpp \
+../../Rectangle.hpp \
+../../Exceptions.hpp \
+../../MKMath.hpp
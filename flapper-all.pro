@@ -0,0 +1,20 @@
+#-------------------------------------------------
+#
+# Builds the bot and the headless tools under bench/ in one go:
+#     qmake flapper-all.pro && make
+# Each project can still be built on its own from its directory.
+#
+#-------------------------------------------------
+
+TEMPLATE = subdirs
+
+SUBDIRS = app bench sim capture batch
+
+# The bot's project is in this directory too, so it gets a makefile of its own
+app.file = flapper.pro
+app.makefile = Makefile.flapper
+
+bench.file = bench/bench.pro
+sim.file = bench/sim/sim.pro
+capture.file = bench/capture/capture.pro
+batch.file = bench/batch/batch.pro
@@ -14,7 +14,7 @@ TEMPLATE = app
 #CONFIG += c++11 debug
 CONFIG += c++11 release
 
-LIBS += -lX11 -lXtst
+LIBS += -lX11 -lXtst -lXdamage -lxcb -lxcb-shm -lxcb-xtest
 
 QMAKE_CXXFLAGS += -Wall -Wextra
 
@@ -22,23 +22,56 @@ SOURCES += main.cpp \
 DisplayWindow.cpp \
 QGLCanvas.cpp \
 VideoFrame.cpp \
+HSVConversion.cpp \
 X11ScreenIO.cpp \
+XCBScreenIO.cpp \
+ScreenIOBackends.cpp \
+PixelConversion.cpp \
 FlappySearches.cpp \
+TileClassifier.cpp \
+BitMask.cpp \
+RectangleSet.cpp \
+FrameArena.cpp \
 BufferedFrameFetcher.cpp \
 PhysicsAnalysis.cpp \
-BirdAI.cpp
+QualityController.cpp \
+FlapFitter.cpp \
+FlapPlanner.cpp \
+BirdAI.cpp \
+StatsReporter.cpp \
+ConfigFile.cpp \
+FrameRecording.cpp \
+Trace.cpp
 
 HEADERS  += DisplayWindow.hpp \
 QGLCanvas.hpp \
 VideoFrame.hpp \
+HSVConversion.hpp \
 ScreenIO.hpp \
 X11ScreenIO.hpp \
+XCBScreenIO.hpp \
+ScreenIOBackends.hpp \
+PixelConversion.hpp \
 FlappySearches.hpp \
+TileClassifier.hpp \
+BitMask.hpp \
+RectangleSet.hpp \
+FrameArena.hpp \
+FlapFitter.hpp \
+FlapPlanner.hpp \
+FlappyColors.hpp \
 FPSTracker.hpp \
+LatencyHistogram.hpp \
+StatsReporter.hpp \
+ConfigFile.hpp \
+FrameRecording.hpp \
+Trace.hpp \
 PeriodicRunner.hpp \
+TimeSource.hpp \
 Rectangle.hpp \
 BufferedFrameFetcher.hpp \
 PhysicsAnalysis.hpp \
+QualityController.hpp \
 BirdAI.hpp \
 Exceptions.hpp \
 MKMath.hpp
@@ -2,8 +2,15 @@
 
 #include "DisplayWindow.hpp"
 
+// After the Qt headers, since Xlib's macros trample some of Qt's names
+#include <X11/Xlib.h>
+
 int main(int argc, char *argv[])
 {
+	// Capture, input, and the GUI all talk to the X server from their own threads,
+	// so Xlib needs to be told before anything else uses it.
+	XInitThreads();
+
 	QApplication a(argc, argv);
 	DisplayWindow w;
 	w.show();